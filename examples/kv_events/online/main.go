@@ -152,7 +152,7 @@ func setupPythonPath(ctx context.Context) error {
 }
 
 func setupChatTemplatingProcessor() (*preprocessing.ChatTemplatingProcessor, error) {
-	processor := preprocessing.NewChatTemplatingProcessor()
+	processor := preprocessing.NewChatTemplatingProcessor(preprocessing.DefaultConfig())
 	if err := processor.Initialize(); err != nil {
 		return nil, fmt.Errorf("failed to initialize chat-templating processor: %w", err)
 	}
@@ -19,6 +19,7 @@ package kvcache
 import (
 	"context"
 	"fmt"
+	"sync"
 
 	"k8s.io/apimachinery/pkg/util/sets"
 	"k8s.io/klog/v2"
@@ -35,9 +36,12 @@ import (
 type Config struct {
 	PrefixStoreConfig    *prefixstore.Config           `json:"prefixStoreConfig"`
 	TokenProcessorConfig *kvblock.TokenProcessorConfig `json:"tokenProcessorConfig"`
-	KVBlockIndexConfig   *kvblock.IndexConfig          `json:"kvBlockIndexConfig"`
-	KVBlockScorerConfig  *KVBlockScorerConfig          // not exported
-	TokenizersPoolConfig *tokenization.Config          `json:"tokenizersPoolConfig"`
+	// ModelTokenProcessorConfigs overrides the TokenProcessorConfig of the
+	// models whose vLLM deployments use another block size or hash seed.
+	ModelTokenProcessorConfigs map[string]*kvblock.TokenProcessorConfig `json:"modelTokenProcessorConfigs,omitempty"`
+	KVBlockIndexConfig         *kvblock.IndexConfig                     `json:"kvBlockIndexConfig"`
+	KVBlockScorerConfig        *KVBlockScorerConfig                     // not exported
+	TokenizersPoolConfig       *tokenization.Config                     `json:"tokenizersPoolConfig"`
 }
 
 // NewDefaultConfig returns a default configuration for the Indexer module.
@@ -56,11 +60,13 @@ type Indexer struct {
 	config *Config
 
 	tokensIndexer   prefixstore.Indexer    // gets tokens for a prompt
-	tokensProcessor kvblock.TokenProcessor // turns tokens to kv block keys
+	tokensProcessor kvblock.TokenProcessor // turns tokens to kv block keys, per model
 	kvBlockIndex    kvblock.Index          // looks up pods for block keys
 	kvBlockScorer   KVBlockScorer          // scores pods based on block hits
 
 	tokenizersPool *tokenization.Pool
+
+	blockKeysPool sync.Pool // reuses the block key buffers of GetPodScores
 }
 
 // NewKVCacheIndexer creates a KVCacheIndex given a Config.
@@ -70,7 +76,11 @@ func NewKVCacheIndexer(ctx context.Context, config *Config) (*Indexer, error) {
 		return nil, fmt.Errorf("failed to create prefixstore.Indexer: %w", err)
 	}
 
-	tokensProcessor := kvblock.NewChunkedTokenDatabase(config.TokenProcessorConfig)
+	tokensProcessor, err := kvblock.NewModelTokenProcessors(config.TokenProcessorConfig,
+		config.ModelTokenProcessorConfigs)
+	if err != nil {
+		return nil, fmt.Errorf("failed to create token processor: %w", err)
+	}
 
 	kvBlockIndex, err := kvblock.NewIndex(ctx, config.KVBlockIndexConfig)
 	if err != nil {
@@ -122,8 +132,14 @@ func (k *Indexer) GetPodScores(ctx context.Context, prompt, modelName string,
 	// 1. tokenize prompt
 	tokens := k.tokenizersPool.Tokenize(prompt, modelName)
 
-	// 2. get block keys
-	blockKeys := k.tokensProcessor.TokensToKVBlockKeys(tokens, modelName)
+	// 2. get block keys, into a pooled buffer that lookups and scoring do not retain
+	keysBuf, ok := k.blockKeysPool.Get().(*[]kvblock.Key)
+	if !ok {
+		keysBuf = new([]kvblock.Key)
+	}
+	blockKeys := k.tokensProcessor.TokensToKVBlockKeysInto((*keysBuf)[:0], tokens, modelName)
+	*keysBuf = blockKeys
+	defer k.blockKeysPool.Put(keysBuf)
 	if len(blockKeys) == 0 {
 		traceLogger.Info("no block keys found, returning empty scores")
 		//nolint:nilnil // no need to return an error
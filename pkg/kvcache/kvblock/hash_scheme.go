@@ -0,0 +1,175 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package kvblock
+
+import (
+	"crypto/sha256"
+	"encoding/binary"
+	"hash"
+	"math"
+
+	"github.com/cespare/xxhash/v2"
+)
+
+// HashScheme selects how the token processor computes block hashes. Block
+// hashes chain each block of tokens to the hash of its parent block, starting
+// from the hash of the HashSeed. Only SHA256CBORHashScheme matches stock vLLM:
+// the raw schemes skip the CBOR encoding, and require vLLM deployments
+// configured with a matching hash function.
+type HashScheme string
+
+const (
+	// SHA256CBORHashScheme hashes the canonical CBOR encoding of the
+	// [parent, tokens, None] payload with SHA-256, keeping the low 64 bits.
+	// It matches vLLM's sha256_cbor_64bit prefix caching hash.
+	SHA256CBORHashScheme HashScheme = "sha256_cbor"
+	// SHA256RawHashScheme hashes the parent hash as 8 little-endian bytes
+	// followed by the tokens as 4 little-endian bytes each with SHA-256,
+	// keeping the low 64 bits. The seed is hashed as its UTF-8 bytes.
+	SHA256RawHashScheme HashScheme = "sha256_raw"
+	// XXHash64RawHashScheme hashes the bytes of SHA256RawHashScheme with
+	// XXH64 (seed 0), the fastest scheme.
+	XXHash64RawHashScheme HashScheme = "xxhash64_raw"
+)
+
+// blockHasher computes the hashes of the blocks without extra keys of a hash
+// scheme, reusing its buffers across blocks. It is not safe for concurrent
+// use.
+type blockHasher interface {
+	// hash returns the hash of a block of tokens chained to its parent's hash.
+	hash(parent uint64, tokens []uint32) uint64
+	// hashSeed returns the hash of the seed, the parent of the first block.
+	hashSeed(seed string) uint64
+}
+
+// newBlockHasher returns a blockHasher for blocks of blockSize tokens, or nil
+// if the scheme is unknown. The empty scheme is SHA256CBORHashScheme.
+func newBlockHasher(scheme HashScheme, blockSize int) blockHasher {
+	switch scheme {
+	case SHA256CBORHashScheme, "":
+		// Each integer takes up to 9 bytes.
+		return &cborSHA256Hasher{sha: sha256.New(), buf: make([]byte, 0, 1+9+9+9*blockSize+1)}
+	case SHA256RawHashScheme:
+		return &rawSHA256Hasher{sha: sha256.New(), buf: make([]byte, 0, 8+4*blockSize)}
+	case XXHash64RawHashScheme:
+		return &rawXXHash64Hasher{buf: make([]byte, 0, 8+4*blockSize)}
+	default:
+		return nil
+	}
+}
+
+// CBOR major types and simple values written by cborSHA256Hasher.
+const (
+	cborUnsigned byte = 0x00
+	cborText     byte = 0x60
+	cborArray    byte = 0x80
+	cborNull     byte = 0xf6
+)
+
+// cborSHA256Hasher hashes blocks like ChunkedTokenDatabase.hash, writing the
+// canonical CBOR encoding of their fixed [parent, tokens, nil] payload into a
+// reused buffer, and hashing it with a reused SHA-256.
+type cborSHA256Hasher struct {
+	sha hash.Hash
+	buf []byte
+	sum [sha256.Size]byte
+}
+
+func (h *cborSHA256Hasher) hash(parent uint64, tokens []uint32) uint64 {
+	buf := append(h.buf[:0], cborArray|3)
+	buf = appendCBORHead(buf, cborUnsigned, parent)
+	buf = appendCBORHead(buf, cborArray, uint64(len(tokens)))
+	for _, token := range tokens {
+		buf = appendCBORHead(buf, cborUnsigned, uint64(token))
+	}
+	buf = append(buf, cborNull)
+	h.buf = buf
+	return sumSHA256Low64(h.sha, &h.sum, buf)
+}
+
+func (h *cborSHA256Hasher) hashSeed(seed string) uint64 {
+	buf := append(appendCBORHead(h.buf[:0], cborText, uint64(len(seed))), seed...)
+	h.buf = buf
+	return sumSHA256Low64(h.sha, &h.sum, buf)
+}
+
+// appendCBORHead appends the head of a CBOR data item of the given major type
+// and argument, in its shortest form as canonical encoding requires.
+func appendCBORHead(buf []byte, major byte, arg uint64) []byte {
+	switch {
+	case arg < 24:
+		return append(buf, major|byte(arg)) //nolint:gosec // bounded by the case
+	case arg <= math.MaxUint8:
+		return append(buf, major|24, byte(arg)) //nolint:gosec // bounded by the case
+	case arg <= math.MaxUint16:
+		return binary.BigEndian.AppendUint16(append(buf, major|25), uint16(arg)) //nolint:gosec // bounded by the case
+	case arg <= math.MaxUint32:
+		return binary.BigEndian.AppendUint32(append(buf, major|26), uint32(arg)) //nolint:gosec // bounded by the case
+	default:
+		return binary.BigEndian.AppendUint64(append(buf, major|27), arg)
+	}
+}
+
+// rawSHA256Hasher hashes blocks with SHA256RawHashScheme.
+type rawSHA256Hasher struct {
+	sha hash.Hash
+	buf []byte
+	sum [sha256.Size]byte
+}
+
+func (h *rawSHA256Hasher) hash(parent uint64, tokens []uint32) uint64 {
+	h.buf = appendRawBlock(h.buf[:0], parent, tokens)
+	return sumSHA256Low64(h.sha, &h.sum, h.buf)
+}
+
+func (h *rawSHA256Hasher) hashSeed(seed string) uint64 {
+	h.buf = append(h.buf[:0], seed...)
+	return sumSHA256Low64(h.sha, &h.sum, h.buf)
+}
+
+// rawXXHash64Hasher hashes blocks with XXHash64RawHashScheme.
+type rawXXHash64Hasher struct {
+	buf []byte
+}
+
+func (h *rawXXHash64Hasher) hash(parent uint64, tokens []uint32) uint64 {
+	h.buf = appendRawBlock(h.buf[:0], parent, tokens)
+	return xxhash.Sum64(h.buf)
+}
+
+func (h *rawXXHash64Hasher) hashSeed(seed string) uint64 {
+	return xxhash.Sum64String(seed)
+}
+
+// appendRawBlock appends the raw bytes of a block: its parent hash and its
+// tokens, little-endian.
+func appendRawBlock(buf []byte, parent uint64, tokens []uint32) []byte {
+	buf = binary.LittleEndian.AppendUint64(buf, parent)
+	for _, token := range tokens {
+		buf = binary.LittleEndian.AppendUint32(buf, token)
+	}
+	return buf
+}
+
+// sumSHA256Low64 returns the low 64 bits of the SHA-256 of data, reusing sha
+// and sum.
+func sumSHA256Low64(sha hash.Hash, sum *[sha256.Size]byte, data []byte) uint64 {
+	sha.Reset()
+	sha.Write(data)
+	sha.Sum(sum[:0])
+	return binary.BigEndian.Uint64(sum[24:])
+}
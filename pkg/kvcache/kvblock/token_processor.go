@@ -20,17 +20,31 @@ import (
 	"context"
 	"crypto/sha256"
 	"encoding/binary"
+	"errors"
+	"fmt"
+	"slices"
+	"sync"
+	"unicode/utf8"
 
 	"github.com/fxamacker/cbor/v2"
+	lru "github.com/hashicorp/golang-lru/v2"
 	"k8s.io/klog/v2"
 
-	"github.com/llm-d/llm-d-kv-cache-manager/pkg/utils"
+	"github.com/llm-d/llm-d-kv-cache-manager/pkg/kvcache/metrics"
 )
 
 // defaultBlockSize is the default number of tokens per block.
 // 16 is the default value used by vLLM.
 const defaultBlockSize = 16
 
+// defaultHashCacheSize is the default number of block hashes cached, taking
+// about 12 MiB with 16-token blocks.
+const defaultHashCacheSize = 1 << 16
+
+// hashCacheShards is the number of separately locked shards of the block hash
+// cache, so that concurrent requests rarely wait on each other's lookups.
+const hashCacheShards = 16
+
 // TokenProcessorConfig holds the configuration for the token processor.
 type TokenProcessorConfig struct {
 	BlockSize int `json:"blockSize"`
@@ -38,15 +52,23 @@ type TokenProcessorConfig struct {
 	// This should be aligned with vLLM's `PYTHONHASHSEED` environment variable.
 	// The system's deployer is responsible for aligning the vLLM deployments
 	// with the same seed value.
-	HashSeed string  `json:"hashSeed"`
-	initHash *uint64 // cache once
+	HashSeed string `json:"hashSeed"`
+	// HashScheme selects how block hashes are computed, and must match the
+	// vLLM deployments. Defaults to SHA256CBORHashScheme.
+	HashScheme HashScheme `json:"hashScheme"`
+	// HashCacheSize is the number of block hashes cached by their parent hash
+	// and tokens, so that prompts sharing a prefix with earlier ones only hash
+	// their new blocks. Zero disables the cache.
+	HashCacheSize int `json:"hashCacheSize"`
 }
 
 // DefaultTokenProcessorConfig returns the default configuration for the token processor.
 func DefaultTokenProcessorConfig() *TokenProcessorConfig {
 	return &TokenProcessorConfig{
-		BlockSize: defaultBlockSize,
-		HashSeed:  "",
+		BlockSize:     defaultBlockSize,
+		HashSeed:      "",
+		HashScheme:    SHA256CBORHashScheme,
+		HashCacheSize: defaultHashCacheSize,
 	}
 }
 
@@ -55,57 +77,71 @@ func DefaultTokenProcessorConfig() *TokenProcessorConfig {
 type TokenProcessor interface {
 	// TokensToKVBlockKeys converts tokens into kv_block.Keys.
 	TokensToKVBlockKeys(tokens []uint32, modelName string) []Key
+	// TokensToKVBlockKeysInto appends the kv_block.Keys of tokens to dst and
+	// returns the extended slice, like append.
+	TokensToKVBlockKeysInto(dst []Key, tokens []uint32, modelName string) []Key
 }
 
 // ChunkedTokenDatabase is a concrete implementation of TokenDatabase.
 // It mimics the ChunkedTokenDatabase in the Python code.
 type ChunkedTokenDatabase struct {
 	TokenProcessorConfig
+	// initHash is the hash of the HashSeed, the root parent hash.
+	initHash uint64
+	// hashCache caches block hashes, if enabled.
+	hashCache *blockHashCache
+	// hashers pools the blockHashers of the hash scheme, along with their
+	// encoding buffers.
+	hashers sync.Pool
 }
 
 var _ TokenProcessor = &ChunkedTokenDatabase{}
 
-// NewChunkedTokenDatabase creates a new instance with the given config and metadata.
-func NewChunkedTokenDatabase(config *TokenProcessorConfig) TokenProcessor {
+// NewChunkedTokenDatabase creates a new instance with the given config and
+// metadata, validating the config and hashing the seed up front.
+func NewChunkedTokenDatabase(config *TokenProcessorConfig) (TokenProcessor, error) {
 	if config == nil {
 		config = DefaultTokenProcessorConfig()
-	} // TODO: validate?
-
-	return &ChunkedTokenDatabase{
-		TokenProcessorConfig: *config,
 	}
-}
-
-// getInitHash returns the root parent hash.
-func (db *ChunkedTokenDatabase) getInitHash() *uint64 {
-	if db.initHash != nil {
-		return db.initHash
+	if config.BlockSize <= 0 {
+		return nil, fmt.Errorf("blockSize must be positive, got %d", config.BlockSize)
 	}
-
-	encMode, err := cbor.CanonicalEncOptions().EncMode() // deterministic
-	if err != nil {
-		klog.FromContext(context.Background()).Error(err, "failed to create CBOR encoder")
-		return nil
+	hasher := newBlockHasher(config.HashScheme, config.BlockSize)
+	if hasher == nil {
+		return nil, fmt.Errorf("unknown hashScheme %q", config.HashScheme)
 	}
-
-	b, err := encMode.Marshal(db.HashSeed)
-	if err != nil {
-		klog.FromContext(context.Background()).Error(err, "failed to marshal payload to CBOR")
-		return nil
+	if _, isCBOR := hasher.(*cborSHA256Hasher); isCBOR && !utf8.ValidString(config.HashSeed) {
+		return nil, errors.New("hashSeed must be valid UTF-8 to be encoded as a CBOR text string")
 	}
 
-	sum := sha256.Sum256(b)
-	hashVal := binary.BigEndian.Uint64(sum[24:])
-	db.initHash = &hashVal
-	return db.initHash
+	db := &ChunkedTokenDatabase{
+		TokenProcessorConfig: *config,
+		initHash:             hasher.hashSeed(config.HashSeed),
+	}
+	db.hashers.Put(hasher)
+	if config.HashCacheSize > 0 {
+		hashCache, err := newBlockHashCache(config.HashCacheSize)
+		if err != nil {
+			return nil, fmt.Errorf("failed to create block hash cache: %w", err)
+		}
+		db.hashCache = hashCache
+	}
+	return db, nil
 }
 
+// canonicalEncMode returns the deterministic CBOR encoder, created once.
+var canonicalEncMode = sync.OnceValues(func() (cbor.EncMode, error) {
+	return cbor.CanonicalEncOptions().EncMode()
+})
+
 // hash computes a uint64 hash (lower 64 bits of SHA256).
 // The format, serialization and hashing is aligned with that of vLLM.
+// It is the reference encoding of the sha256_cbor blockHasher, which hashes
+// the blocks without extra keys without reflection.
 func (db *ChunkedTokenDatabase) hash(parent uint64, tokens []uint32, extra interface{}) uint64 {
 	payload := []interface{}{parent, tokens, extra}
 
-	encMode, err := cbor.CanonicalEncOptions().EncMode() // deterministic
+	encMode, err := canonicalEncMode() // deterministic
 	if err != nil {
 		klog.FromContext(context.Background()).Error(err, "failed to create CBOR encoder")
 		return 0
@@ -121,45 +157,189 @@ func (db *ChunkedTokenDatabase) hash(parent uint64, tokens []uint32, extra inter
 	return binary.BigEndian.Uint64(sum[24:])
 }
 
-// prefixHashes returns a slice of uint64 hashes.
-func (db *ChunkedTokenDatabase) prefixHashes(parentHash uint64, tokenChunks [][]uint32) []uint64 {
-	prefix := parentHash
-	hashes := make([]uint64, len(tokenChunks))
-	for i, chunk := range tokenChunks {
-		prefix = db.hash(prefix, chunk, nil)
-		hashes[i] = prefix
+var (
+	blockHashCacheHits   = metrics.BlockHashCacheLookups.WithLabelValues("hit")
+	blockHashCacheMisses = metrics.BlockHashCacheLookups.WithLabelValues("miss")
+)
+
+// blockHashKey identifies a block by its parent's hash and a digest of its
+// tokens. Blocks with colliding digests are told apart by their tokens.
+type blockHashKey struct {
+	parent uint64
+	digest uint64
+}
+
+func newBlockHashKey(parent uint64, tokens []uint32) blockHashKey {
+	// FNV-1a over the tokens.
+	digest := uint64(14695981039346656037)
+	for _, token := range tokens {
+		digest = (digest ^ uint64(token)) * 1099511628211
 	}
-	return hashes
+	return blockHashKey{parent: parent, digest: digest}
 }
 
-// chunkTokens splits the input slice of tokens into chunks of size chunkSize.
-func (db *ChunkedTokenDatabase) chunkTokens(tokens []uint32) [][]uint32 {
-	var chunks [][]uint32
-	for i := 0; i < len(tokens); i += db.BlockSize {
-		end := i + db.BlockSize
-		if end > len(tokens) {
-			break // no partial blocks
-		}
+// cachedBlockHash is the hash of a block, with the block's tokens.
+type cachedBlockHash struct {
+	tokens []uint32
+	hash   uint64
+}
 
-		chunks = append(chunks, tokens[i:end])
+// blockHashCache is an LRU cache of block hashes, sharded by block. Each
+// shard has its own lock and recency list.
+type blockHashCache struct {
+	shards []*lru.Cache[blockHashKey, cachedBlockHash]
+}
+
+func newBlockHashCache(size int) (*blockHashCache, error) {
+	shards := make([]*lru.Cache[blockHashKey, cachedBlockHash], min(hashCacheShards, size))
+	for i := range shards {
+		shardSize := size / len(shards)
+		if i < size%len(shards) {
+			shardSize++
+		}
+		shard, err := lru.New[blockHashKey, cachedBlockHash](shardSize)
+		if err != nil {
+			return nil, err
+		}
+		shards[i] = shard
 	}
+	return &blockHashCache{shards: shards}, nil
+}
+
+func (c *blockHashCache) shard(key blockHashKey) *lru.Cache[blockHashKey, cachedBlockHash] {
+	return c.shards[(key.parent^key.digest)%uint64(len(c.shards))]
+}
+
+func (c *blockHashCache) get(key blockHashKey) (cachedBlockHash, bool) {
+	return c.shard(key).Get(key)
+}
+
+func (c *blockHashCache) add(key blockHashKey, value cachedBlockHash) {
+	c.shard(key).Add(key, value)
+}
 
-	return chunks
+// cachedHash returns the cached hash of a block.
+func (db *ChunkedTokenDatabase) cachedHash(parent uint64, tokens []uint32) (uint64, bool) {
+	cached, ok := db.hashCache.get(newBlockHashKey(parent, tokens))
+	if !ok || !slices.Equal(cached.tokens, tokens) {
+		return 0, false
+	}
+	return cached.hash, true
 }
 
 // TokensToKVBlockKeys converts tokens into kv_block.Keys.
 func (db *ChunkedTokenDatabase) TokensToKVBlockKeys(tokens []uint32, modelName string) []Key {
-	parentPtr := db.getInitHash()
-	if parentPtr == nil {
-		return nil
+	return db.TokensToKVBlockKeysInto(nil, tokens, modelName)
+}
+
+// TokensToKVBlockKeysInto appends the kv_block.Keys of tokens to dst and
+// returns the extended slice. Blocks are hashed in place, without copying the
+// tokens, so that callers reusing dst do not allocate. With a hash cache,
+// hashing resumes after the longest prefix of blocks whose hashes are cached.
+func (db *ChunkedTokenDatabase) TokensToKVBlockKeysInto(dst []Key, tokens []uint32, modelName string) []Key {
+	numBlocks := len(tokens) / db.BlockSize // no partial blocks
+	dst = slices.Grow(dst, numBlocks)
+	prefix := db.initHash
+	block := 0
+	if db.hashCache != nil {
+		for ; block < numBlocks; block++ {
+			hashVal, ok := db.cachedHash(prefix, db.blockTokens(tokens, block))
+			if !ok {
+				break
+			}
+			prefix = hashVal
+			dst = append(dst, Key{ModelName: modelName, ChunkHash: prefix})
+		}
+		blockHashCacheHits.Add(float64(block))
+		blockHashCacheMisses.Add(float64(numBlocks - block))
+	}
+	if block == numBlocks {
+		return dst
+	}
+
+	hasher := db.getHasher()
+	defer db.hashers.Put(hasher)
+	for ; block < numBlocks; block++ {
+		blockTokens := db.blockTokens(tokens, block)
+		hashVal := hasher.hash(prefix, blockTokens)
+		if db.hashCache != nil {
+			db.hashCache.add(newBlockHashKey(prefix, blockTokens),
+				cachedBlockHash{tokens: slices.Clone(blockTokens), hash: hashVal})
+		}
+		prefix = hashVal
+		dst = append(dst, Key{ModelName: modelName, ChunkHash: prefix})
+	}
+	return dst
+}
+
+// blockTokens returns the tokens of a block.
+func (db *ChunkedTokenDatabase) blockTokens(tokens []uint32, block int) []uint32 {
+	return tokens[block*db.BlockSize : (block+1)*db.BlockSize]
+}
+
+// getHasher returns a pooled blockHasher of the hash scheme.
+func (db *ChunkedTokenDatabase) getHasher() blockHasher {
+	if hasher, ok := db.hashers.Get().(blockHasher); ok {
+		return hasher
+	}
+	return newBlockHasher(db.HashScheme, db.BlockSize)
+}
+
+// ModelTokenProcessors is a TokenProcessor that converts the tokens of each
+// model with the ChunkedTokenDatabase of its own config, for fleets whose
+// models run with different block sizes, hash seeds or hash schemes. Models
+// without a config of their own use the default one.
+type ModelTokenProcessors struct {
+	defaultProcessor TokenProcessor
+	modelProcessors  map[string]TokenProcessor
+}
+
+var _ TokenProcessor = &ModelTokenProcessors{}
+
+// NewModelTokenProcessors creates a ChunkedTokenDatabase per model config,
+// hashing their seeds up front. Model configs are complete configs: they do
+// not inherit the fields of the default config. Without model configs, the
+// default ChunkedTokenDatabase is returned as is.
+func NewModelTokenProcessors(defaultConfig *TokenProcessorConfig,
+	modelConfigs map[string]*TokenProcessorConfig,
+) (TokenProcessor, error) {
+	defaultProcessor, err := NewChunkedTokenDatabase(defaultConfig)
+	if err != nil {
+		return nil, err
+	}
+	if len(modelConfigs) == 0 {
+		return defaultProcessor, nil
 	}
 
-	chunks := db.chunkTokens(tokens)
-	ph := db.prefixHashes(*parentPtr, chunks)
-	return utils.SliceMap(ph, func(hashVal uint64) Key {
-		return Key{
-			ModelName: modelName,
-			ChunkHash: hashVal,
+	modelProcessors := make(map[string]TokenProcessor, len(modelConfigs))
+	for modelName, config := range modelConfigs {
+		processor, err := NewChunkedTokenDatabase(config)
+		if err != nil {
+			return nil, fmt.Errorf("invalid token processor config of model %s: %w", modelName, err)
 		}
-	})
+		modelProcessors[modelName] = processor
+	}
+	return &ModelTokenProcessors{
+		defaultProcessor: defaultProcessor,
+		modelProcessors:  modelProcessors,
+	}, nil
+}
+
+// processor returns the TokenProcessor of a model.
+func (p *ModelTokenProcessors) processor(modelName string) TokenProcessor {
+	if processor, ok := p.modelProcessors[modelName]; ok {
+		return processor
+	}
+	return p.defaultProcessor
+}
+
+// TokensToKVBlockKeys converts tokens into the kv_block.Keys of a model.
+func (p *ModelTokenProcessors) TokensToKVBlockKeys(tokens []uint32, modelName string) []Key {
+	return p.processor(modelName).TokensToKVBlockKeys(tokens, modelName)
+}
+
+// TokensToKVBlockKeysInto appends the kv_block.Keys of a model's tokens to dst
+// and returns the extended slice.
+func (p *ModelTokenProcessors) TokensToKVBlockKeysInto(dst []Key, tokens []uint32, modelName string) []Key {
+	return p.processor(modelName).TokensToKVBlockKeysInto(dst, tokens, modelName)
 }
@@ -0,0 +1,376 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//nolint:testpackage // tests the unexported block hashing
+package kvblock
+
+import (
+	"fmt"
+	"math"
+	"math/rand"
+	"slices"
+	"sync/atomic"
+	"testing"
+	"time"
+
+	"github.com/stretchr/testify/assert"
+	"github.com/stretchr/testify/require"
+)
+
+// TestBlockHasherVLLMVectors tests block hashes against vLLM's
+// sha256_cbor_64bit, computed with cbor2.dumps(payload, canonical=True).
+func TestBlockHasherVLLMVectors(t *testing.T) {
+	tokensRange := func(start, end uint32) []uint32 {
+		tokens := make([]uint32, 0, end-start)
+		for token := start; token < end; token++ {
+			tokens = append(tokens, token)
+		}
+		return tokens
+	}
+
+	tests := []struct {
+		parent   uint64
+		tokens   []uint32
+		expected uint64
+	}{
+		{0, []uint32{}, 4600569523812126374},
+		{12345678901234567890, tokensRange(0, 16), 16909940667323798706},
+		{1 << 32, []uint32{0, 23, 24, 255, 256, 65535, 65536, math.MaxUint32}, 14226441631018748841},
+		{1, tokensRange(1000, 1300), 11702353212069531041},
+	}
+
+	hasher := newBlockHasher(SHA256CBORHashScheme, defaultBlockSize)
+	db := &ChunkedTokenDatabase{}
+	for _, tt := range tests {
+		assert.Equal(t, tt.expected, hasher.hash(tt.parent, tt.tokens), "parent %d, %d tokens", tt.parent, len(tt.tokens))
+		assert.Equal(t, tt.expected, db.hash(tt.parent, tt.tokens, nil), "parent %d, %d tokens", tt.parent, len(tt.tokens))
+	}
+}
+
+// TestHashSchemeVectors tests the seed and block hashes of each hash scheme
+// against vectors computed in Python, with hashlib and xxhash.
+func TestHashSchemeVectors(t *testing.T) {
+	tokens := []uint32{0, 23, 24, 255, 256, 65535, 65536, math.MaxUint32}
+	tests := []struct {
+		scheme HashScheme
+		seeds  map[string]uint64
+		block  uint64 // of tokens, chained to 1 << 32
+		empty  uint64 // of no tokens, chained to 0
+	}{
+		{
+			scheme: SHA256CBORHashScheme,
+			seeds:  map[string]uint64{"": 780114917913990099, "42": 12056132650316601216},
+			block:  14226441631018748841,
+			empty:  4600569523812126374,
+		},
+		{
+			scheme: SHA256RawHashScheme,
+			seeds:  map[string]uint64{"": 11859553537011923029, "42": 7716878813329260617},
+			block:  11157974584354429583,
+			empty:  16551347165485088252,
+		},
+		{
+			scheme: XXHash64RawHashScheme,
+			seeds:  map[string]uint64{"": 17241709254077376921, "42": 7919287270473417401},
+			block:  3369279676173576829,
+			empty:  3803688792395291579,
+		},
+	}
+
+	for _, tt := range tests {
+		hasher := newBlockHasher(tt.scheme, defaultBlockSize)
+		require.NotNil(t, hasher, tt.scheme)
+		for seed, expected := range tt.seeds {
+			assert.Equal(t, expected, hasher.hashSeed(seed), "%s seed %q", tt.scheme, seed)
+		}
+		assert.Equal(t, tt.block, hasher.hash(1<<32, tokens), tt.scheme)
+		assert.Equal(t, tt.empty, hasher.hash(0, nil), tt.scheme)
+	}
+	assert.Nil(t, newBlockHasher("md5", defaultBlockSize), "Unknown schemes should have no hasher")
+}
+
+// TestBlockHasherMatchesCBOR tests that blockHasher hashes random blocks like
+// the reflective CBOR encoding.
+func TestBlockHasherMatchesCBOR(t *testing.T) {
+	rng := rand.New(rand.NewSource(42)) //nolint:gosec // deterministic test data
+	hasher := newBlockHasher(SHA256CBORHashScheme, defaultBlockSize)
+	db := &ChunkedTokenDatabase{}
+	for i := 0; i < 1000; i++ {
+		tokens := make([]uint32, rng.Intn(64))
+		for j := range tokens {
+			// Spread the tokens over all the CBOR integer sizes.
+			tokens[j] = rng.Uint32() >> rng.Intn(32)
+		}
+		parent := rng.Uint64() >> rng.Intn(64)
+		require.Equal(t, db.hash(parent, tokens, nil), hasher.hash(parent, tokens), "parent %d, tokens %v", parent, tokens)
+	}
+}
+
+// TestTokensToKVBlockKeys tests the chained block keys of each hash scheme,
+// with the empty hash seed.
+func TestTokensToKVBlockKeys(t *testing.T) {
+	tokens := make([]uint32, 70) // with a partial block
+	for i := range tokens {
+		tokens[i] = uint32(i) //nolint:gosec // small
+	}
+
+	for scheme, expected := range map[HashScheme][]uint64{
+		SHA256CBORHashScheme:  {11338012631650408282, 3427227388231036566, 5007108091104464285, 6595430589907650406},
+		SHA256RawHashScheme:   {4666687550489157481, 2012734117780802959, 7469831589061662516, 11622024673840090664},
+		XXHash64RawHashScheme: {1752139416532014167, 8864902414008588125, 17141206182538336112, 17344391818798784678},
+	} {
+		config := DefaultTokenProcessorConfig()
+		config.HashScheme = scheme
+		db, err := NewChunkedTokenDatabase(config)
+		require.NoError(t, err)
+		keys := db.TokensToKVBlockKeys(tokens, "model")
+		require.Len(t, keys, len(expected), scheme)
+		for i, key := range keys {
+			assert.Equal(t, Key{ModelName: "model", ChunkHash: expected[i]}, key, "%s block %d", scheme, i)
+		}
+	}
+}
+
+// TestNewChunkedTokenDatabaseValidation tests that misconfigurations are
+// rejected up front rather than yielding no keys.
+func TestNewChunkedTokenDatabaseValidation(t *testing.T) {
+	for name, tc := range map[string]struct {
+		blockSize int
+		scheme    HashScheme
+		seed      string
+		valid     bool
+	}{
+		"default":                   {blockSize: 16, valid: true},
+		"zero block size":           {blockSize: 0},
+		"negative block size":       {blockSize: -16},
+		"unknown scheme":            {blockSize: 16, scheme: "md5"},
+		"invalid UTF-8 CBOR seed":   {blockSize: 16, seed: "\xff"},
+		"invalid UTF-8 raw seed":    {blockSize: 16, scheme: SHA256RawHashScheme, seed: "\xff", valid: true},
+		"non-ASCII CBOR seed":       {blockSize: 16, seed: "s\u00e9ed", valid: true},
+		"explicit CBOR hash scheme": {blockSize: 16, scheme: SHA256CBORHashScheme, valid: true},
+	} {
+		config := DefaultTokenProcessorConfig()
+		config.BlockSize = tc.blockSize
+		config.HashScheme = tc.scheme
+		config.HashSeed = tc.seed
+		db, err := NewChunkedTokenDatabase(config)
+		if tc.valid {
+			assert.NoError(t, err, name)
+			assert.NotNil(t, db, name)
+		} else {
+			assert.Error(t, err, name)
+			assert.Nil(t, db, name)
+		}
+	}
+}
+
+// TestModelTokenProcessors tests that each model's block keys are computed
+// with its own config, and other models' with the default one.
+func TestModelTokenProcessors(t *testing.T) {
+	tokens := make([]uint32, 64)
+	for i := range tokens {
+		tokens[i] = uint32(i) //nolint:gosec // small
+	}
+
+	defaultConfig := DefaultTokenProcessorConfig()
+	modelConfig := DefaultTokenProcessorConfig()
+	modelConfig.BlockSize = 32
+	modelConfig.HashSeed = "12345"
+	processors, err := NewModelTokenProcessors(defaultConfig, map[string]*TokenProcessorConfig{"model-32": modelConfig})
+	require.NoError(t, err)
+
+	for modelName, config := range map[string]*TokenProcessorConfig{
+		"model-32": modelConfig,
+		"model-16": defaultConfig,
+	} {
+		db, err := NewChunkedTokenDatabase(config)
+		require.NoError(t, err)
+		expected := db.TokensToKVBlockKeys(tokens, modelName)
+		require.Len(t, expected, len(tokens)/config.BlockSize, modelName)
+		assert.Equal(t, expected, processors.TokensToKVBlockKeys(tokens, modelName), modelName)
+		assert.Equal(t, expected, processors.TokensToKVBlockKeysInto(nil, tokens, modelName), modelName)
+	}
+
+	invalidConfig := DefaultTokenProcessorConfig()
+	invalidConfig.BlockSize = 0
+	_, err = NewModelTokenProcessors(defaultConfig, map[string]*TokenProcessorConfig{"model-0": invalidConfig})
+	assert.Error(t, err, "Invalid model configs should be rejected")
+}
+
+// TestTokensToKVBlockKeysHashCache tests that block keys resumed from cached
+// prefixes match block keys computed without the cache, including with fewer
+// entries than shards, evicting most blocks.
+func TestTokensToKVBlockKeysHashCache(t *testing.T) {
+	config := DefaultTokenProcessorConfig()
+	config.BlockSize = 4
+	cachedDB, err := NewChunkedTokenDatabase(config)
+	require.NoError(t, err)
+	config.HashCacheSize = 3
+	smallCachedDB, err := NewChunkedTokenDatabase(config)
+	require.NoError(t, err)
+	config.HashCacheSize = 0
+	db, err := NewChunkedTokenDatabase(config)
+	require.NoError(t, err)
+
+	prompt := make([]uint32, 64)
+	for i := range prompt {
+		prompt[i] = uint32(i) //nolint:gosec // small
+	}
+	prompts := [][]uint32{
+		prompt,
+		prompt[:32], // cached prefix
+		append(slices.Clone(prompt[:30]), 7, 7, 7, 7), // diverging within a block
+		append(slices.Clone(prompt), 64, 65, 66, 67),  // extending
+		prompt,
+	}
+	for i, tokens := range prompts {
+		expected := db.TokensToKVBlockKeys(tokens, "model")
+		assert.Equal(t, expected, cachedDB.TokensToKVBlockKeys(tokens, "model"), "Prompt %d", i)
+		assert.Equal(t, expected, smallCachedDB.TokensToKVBlockKeys(tokens, "model"), "Prompt %d", i)
+	}
+}
+
+// TestCachedHashCollision tests that a cached block hash is not returned for
+// another block whose tokens have the same digest.
+func TestCachedHashCollision(t *testing.T) {
+	config := DefaultTokenProcessorConfig()
+	processor, err := NewChunkedTokenDatabase(config)
+	require.NoError(t, err)
+	db, ok := processor.(*ChunkedTokenDatabase)
+	require.True(t, ok)
+
+	tokens := []uint32{1, 2, 3, 4}
+	db.hashCache.add(newBlockHashKey(0, tokens), cachedBlockHash{tokens: []uint32{4, 3, 2, 1}, hash: 42})
+	_, ok = db.cachedHash(0, tokens)
+	assert.False(t, ok, "Hash of other tokens should not be returned")
+
+	db.hashCache.add(newBlockHashKey(0, tokens), cachedBlockHash{tokens: tokens, hash: 42})
+	hashVal, ok := db.cachedHash(0, tokens)
+	assert.True(t, ok)
+	assert.Equal(t, uint64(42), hashVal)
+}
+
+// TestTokensToKVBlockKeysInto tests that block keys appended to a reused
+// buffer match freshly allocated ones.
+func TestTokensToKVBlockKeysInto(t *testing.T) {
+	config := DefaultTokenProcessorConfig()
+	config.HashCacheSize = 0
+	db, err := NewChunkedTokenDatabase(config)
+	require.NoError(t, err)
+
+	tokens := make([]uint32, 1030) // with a partial block
+	for i := range tokens {
+		tokens[i] = uint32(i) //nolint:gosec // small
+	}
+	expected := db.TokensToKVBlockKeys(tokens, "model")
+	require.Len(t, expected, len(tokens)/config.BlockSize)
+
+	prefix := []Key{{ModelName: "other", ChunkHash: 1}}
+	keys := db.TokensToKVBlockKeysInto(slices.Clone(prefix), tokens, "model")
+	assert.Equal(t, append(slices.Clone(prefix), expected...), keys)
+
+	keys = make([]Key, 0, len(expected))
+	for i := 0; i < 2; i++ {
+		keys = db.TokensToKVBlockKeysInto(keys[:0], tokens, "model")
+		assert.Equal(t, expected, keys)
+	}
+}
+
+// BenchmarkPrefixHashes compares hashing the blocks of a 32K-token prompt
+// with the reflective CBOR encoding, with the blockHasher of each scheme, and
+// looking them up in the hash cache. Appending to a reused key buffer should
+// report 0 allocs/op for the blockHasher and hashCache cases.
+func BenchmarkPrefixHashes(b *testing.B) {
+	db := &ChunkedTokenDatabase{TokenProcessorConfig: *DefaultTokenProcessorConfig()}
+	tokens := make([]uint32, 32<<10)
+	for i := range tokens {
+		tokens[i] = uint32(i * 7919 % 150000) //nolint:gosec // small
+	}
+	keys := make([]Key, 0, len(tokens)/db.BlockSize)
+
+	b.Run("reflective", func(b *testing.B) {
+		b.ReportAllocs()
+		for i := 0; i < b.N; i++ {
+			prefix := uint64(0)
+			for block := 0; block < len(tokens)/db.BlockSize; block++ {
+				prefix = db.hash(prefix, db.blockTokens(tokens, block), nil)
+			}
+		}
+	})
+	for _, scheme := range []HashScheme{SHA256CBORHashScheme, SHA256RawHashScheme, XXHash64RawHashScheme} {
+		schemeDB := &ChunkedTokenDatabase{TokenProcessorConfig: db.TokenProcessorConfig}
+		schemeDB.HashScheme = scheme
+		b.Run("blockHasher/"+string(scheme), func(b *testing.B) {
+			b.ReportAllocs()
+			for i := 0; i < b.N; i++ {
+				keys = schemeDB.TokensToKVBlockKeysInto(keys[:0], tokens, "model")
+			}
+		})
+	}
+	b.Run("hashCache", func(b *testing.B) {
+		cachedDB, err := NewChunkedTokenDatabase(DefaultTokenProcessorConfig())
+		require.NoError(b, err)
+		cachedDB.TokensToKVBlockKeysInto(keys[:0], tokens, "model")
+		b.ReportAllocs()
+		b.ResetTimer()
+		for i := 0; i < b.N; i++ {
+			keys = cachedDB.TokensToKVBlockKeysInto(keys[:0], tokens, "model")
+		}
+	})
+}
+
+// BenchmarkPrefixHashesParallel measures the aggregate block hashing
+// throughput of concurrent requests, with and without the hash cache, for
+// requests with distinct prompts (all misses) and for requests sharing all
+// but their last block (mostly hits), where cache lock contention shows up.
+func BenchmarkPrefixHashesParallel(b *testing.B) {
+	tokens := make([]uint32, 8<<10)
+	for i := range tokens {
+		tokens[i] = uint32(i * 7919 % 150000) //nolint:gosec // small
+	}
+
+	for _, hashCacheSize := range []int{0, defaultHashCacheSize} {
+		for _, sharedPrefix := range []bool{false, true} {
+			name := fmt.Sprintf("hashCacheSize=%d/sharedPrefix=%t", hashCacheSize, sharedPrefix)
+			b.Run(name, func(b *testing.B) {
+				config := DefaultTokenProcessorConfig()
+				config.HashCacheSize = hashCacheSize
+				db, err := NewChunkedTokenDatabase(config)
+				require.NoError(b, err)
+				numBlocks := len(tokens) / config.BlockSize
+				// Requests differ in their first or last block.
+				variedToken := 0
+				if sharedPrefix {
+					variedToken = len(tokens) - 1
+				}
+
+				b.ReportAllocs()
+				b.ResetTimer()
+				start := time.Now()
+				var requests atomic.Uint64
+				b.RunParallel(func(pb *testing.PB) {
+					prompt := slices.Clone(tokens)
+					keys := make([]Key, 0, numBlocks)
+					for pb.Next() {
+						prompt[variedToken] = uint32(requests.Add(1)) //nolint:gosec // small
+						keys = db.TokensToKVBlockKeysInto(keys[:0], prompt, "model")
+					}
+				})
+				b.ReportMetric(float64(b.N*numBlocks)/time.Since(start).Seconds(), "blocks/s")
+			})
+		}
+	}
+}
@@ -51,6 +51,46 @@ var (
 		Help:    "Latency of Lookup calls in seconds",
 		Buckets: prometheus.DefBuckets,
 	})
+
+	// RenderQueueDepth tracks in-flight chat template renders per Python interpreter.
+	RenderQueueDepth = prometheus.NewGaugeVec(prometheus.GaugeOpts{
+		Namespace: "kvcache", Subsystem: "chat_template", Name: "interpreter_queue_depth",
+		Help: "Number of in-flight chat template renders per Python interpreter",
+	}, []string{"interpreter"})
+	// RenderedChats counts chat template renders by the renderer that served
+	// them: the native Go engine or Python.
+	RenderedChats = prometheus.NewCounterVec(prometheus.CounterOpts{
+		Namespace: "kvcache", Subsystem: "chat_template", Name: "renders_total",
+		Help: "Number of chat template renders per renderer",
+	}, []string{"renderer"})
+	// ChatTemplateCacheLookups counts Python renders by whether the chat
+	// template was found in the renderer's compiled-template cache.
+	ChatTemplateCacheLookups = prometheus.NewCounterVec(prometheus.CounterOpts{
+		Namespace: "kvcache", Subsystem: "chat_template", Name: "cache_lookups_total",
+		Help: "Number of chat template cache lookups by Python renders, per result (hit or miss)",
+	}, []string{"result"})
+	// RenderPrefixCacheLookups counts memoized renders by result: an exact
+	// hit, a render of the new messages after a cached prefix, a miss, or a
+	// template found not to be prefix-stable.
+	RenderPrefixCacheLookups = prometheus.NewCounterVec(prometheus.CounterOpts{
+		Namespace: "kvcache", Subsystem: "chat_template", Name: "prefix_cache_lookups_total",
+		Help: "Number of rendered prefix cache lookups, per result (exact, prefix, miss or unstable)",
+	}, []string{"result"})
+	// PythonCallPhaseLatency breaks the latency of C bridge calls into Python
+	// down by phase: waiting for the GIL, building the arguments, the Python
+	// call and converting its result. A gil_wait phase dominating the others
+	// means renders are bottlenecked on the GIL.
+	PythonCallPhaseLatency = prometheus.NewHistogramVec(prometheus.HistogramOpts{
+		Namespace: "kvcache", Subsystem: "chat_template", Name: "python_call_phase_seconds",
+		Help:    "Latency of the phases of C bridge calls into Python in seconds, per function and phase",
+		Buckets: prometheus.ExponentialBuckets(1e-6, 4, 12),
+	}, []string{"function", "phase"})
+	// BlockHashCacheLookups counts the blocks whose key was looked up in the
+	// token processor's block hash cache, by whether it was found.
+	BlockHashCacheLookups = prometheus.NewCounterVec(prometheus.CounterOpts{
+		Namespace: "kvcache", Subsystem: "token_processor", Name: "block_hash_cache_lookups_total",
+		Help: "Number of block hash cache lookups, per result (hit or miss)",
+	}, []string{"result"})
 )
 
 // Collectors returns a slice of all registered Prometheus collectors.
@@ -58,6 +98,8 @@ func Collectors() []prometheus.Collector {
 	return []prometheus.Collector{
 		Admissions, Evictions,
 		LookupRequests, LookupHits, LookupLatency,
+		RenderQueueDepth, RenderedChats, ChatTemplateCacheLookups, RenderPrefixCacheLookups,
+		PythonCallPhaseLatency, BlockHashCacheLookups,
 	}
 }
 
@@ -0,0 +1,48 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package preprocessing
+
+/*
+#include "cgo_functions.h"
+*/
+import "C"
+
+import (
+	"k8s.io/klog/v2"
+
+	"github.com/llm-d/llm-d-kv-cache-manager/pkg/utils/logging"
+)
+
+// goBridgeLog is the Py_LogHandler of the C bridge: it routes the bridge's
+// rate-limited diagnostics to klog. Errors and warnings are always logged,
+// info and debug messages at the DEBUG and TRACE verbosities.
+//
+//export goBridgeLog
+func goBridgeLog(level C.int, site, message *C.char) {
+	logger := klog.Background().WithName("pythonBridge")
+	msg := C.GoString(message)
+	switch level {
+	case C.PY_LOG_ERROR:
+		logger.Error(nil, msg, "site", C.GoString(site))
+	case C.PY_LOG_WARNING:
+		logger.Info(msg, "site", C.GoString(site))
+	case C.PY_LOG_INFO:
+		logger.V(logging.DEBUG).Info(msg, "site", C.GoString(site))
+	default:
+		logger.V(logging.TRACE).Info(msg, "site", C.GoString(site))
+	}
+}
@@ -14,55 +14,344 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h> // for getpid() and usleep()
 
 #include "cgo_functions.h"
 
-// Global variables for caching
-PyObject* g_chat_template_module = NULL;
-PyObject* g_render_jinja_template_func = NULL;
-PyObject* g_get_model_chat_template_func = NULL;
-int g_initialized = 0;
-int g_python_initialized = 0;
+// Cached objects of the wrapper module in one interpreter of the render pool.
+// A state is published atomically in its interpreter's slot and reference
+// counted: every call holds a reference for as long as it uses the state's
+// functions, so replacing the state (Py_ReinitializeGo) or dropping it
+// (Py_CleanupChatTemplateModule) never releases a function under a running
+// call. References are only taken and dropped holding the interpreter's GIL,
+// and the Python objects are released with the last one.
+typedef struct {
+    atomic_int refs;
+    PyObject* module;
+    PyObject* render_func;
+    PyObject* render_batch_func;
+    PyObject* render_tokenize_func;
+    PyObject* get_model_chat_template_func;
+    PyObject* clear_caches_func;
+} ModuleState;
 
-// Process-level global initialization tracking
+// Render interpreter pool. Slot 0 is the main interpreter; slots
+// 1..g_num_interpreters-1 are sub-interpreters with their own GIL. A slot
+// without a published state does not serve calls.
+typedef struct {
+    PyInterpreterState* interp;
+    PyThreadState* home_tstate;
+    _Atomic(ModuleState*) state;
+} InterpreterSlot;
+
+static InterpreterSlot g_interpreters[PY_MAX_INTERPRETERS];
+static atomic_int g_num_interpreters = 1;
+
+// Process-level initialization tracking, guarded by g_init_mutex
+static int g_python_initialized = 0;
 static int g_process_initialized = 0;
-static int g_finalized = 0; 
+static int g_finalized = 0;
 static pid_t g_init_pid = 0;
 
-// Thread safety for initialization
-static PyThread_type_lock g_init_lock = NULL;
-static PyThread_type_lock g_python_init_lock = NULL;
+// Serializes initialization, reinitialization and cleanup. Calls never take
+// it: they only load the published module states. It is always taken before,
+// never while holding, a GIL.
+static pthread_mutex_t g_init_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Thread state held while running on one of the pool's interpreters
+typedef struct {
+    PyGILState_STATE gil_state;
+    PyThreadState* tstate;
+} InterpreterGuard;
+
+// Attach the calling thread to interpreter `index` and take its GIL.
+// Sub-interpreters get a fresh thread state per call, since any OS thread may
+// enter them.
+static void interpreter_enter(int index, InterpreterGuard* guard) {
+    if (index == 0) {
+        guard->tstate = NULL;
+        guard->gil_state = PyGILState_Ensure();
+        return;
+    }
+
+    guard->tstate = PyThreadState_New(g_interpreters[index].interp);
+    PyEval_AcquireThread(guard->tstate);
+}
+
+// Release the GIL taken by interpreter_enter and detach the calling thread.
+static void interpreter_exit(InterpreterGuard* guard) {
+    if (guard->tstate == NULL) {
+        PyGILState_Release(guard->gil_state);
+        return;
+    }
+
+    PyThreadState_Clear(guard->tstate);
+    PyThreadState_DeleteCurrent();
+    guard->tstate = NULL;
+}
+
+// === CALL TIMINGS ===
+
+// Current CLOCK_MONOTONIC time in nanoseconds
+static long long monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Add the time elapsed since `*since` to `*phase` and restart the clock.
+static void timings_lap(long long* phase, long long* since) {
+    long long now = monotonic_ns();
+    *phase += now - *since;
+    *since = now;
+}
+
+// === LOGGING ===
+
+// Rate limit state of one BRIDGE_LOG call site: the messages logged in the
+// current one-second window, and those suppressed since the last one logged.
+typedef struct {
+    atomic_llong window_start_ns;
+    atomic_int logged;
+    atomic_int suppressed;
+} LogSite;
+
+// Number of entry points a call site in a shared helper rate limits apart;
+// further ones share the last slot.
+#define LOG_SITE_CALLERS 16
+
+// The LogSite of one entry point at a call site in a shared helper.
+typedef struct {
+    _Atomic(const char*) caller;
+    LogSite site;
+} LogSiteSlot;
+
+static _Atomic(Py_LogHandler) g_log_handler = NULL;
+
+// Log a message from a call site, see Py_LogHandler. The site is declared by
+// the macro, so each call site is rate limited on its own.
+#define BRIDGE_LOG_SITE(level, with_python_error, ...)                                       \
+    do {                                                                                     \
+        static LogSite log_site_;                                                            \
+        bridge_log(&log_site_, __func__, (level), (with_python_error), __VA_ARGS__);         \
+    } while (0)
+#define BRIDGE_LOG(level, ...) BRIDGE_LOG_SITE(level, 0, __VA_ARGS__)
+// Log a message with the pending Python exception, which is cleared. The
+// caller must hold the GIL.
+#define BRIDGE_LOG_PYERR(level, ...) BRIDGE_LOG_SITE(level, 1, __VA_ARGS__)
+// Log a message from a call site in a helper shared by several entry points,
+// on behalf of the entry point `caller`. Each entry point is rate limited on
+// its own at each call site, so that an error storm in renders does not
+// suppress the errors of fetches.
+#define BRIDGE_LOG_AT(caller, level, with_python_error, ...)                                 \
+    do {                                                                                     \
+        static LogSiteSlot log_sites_[LOG_SITE_CALLERS];                                     \
+        bridge_log(log_site_for(log_sites_, (caller)), (caller), (level), (with_python_error), \
+                   __VA_ARGS__);                                                             \
+    } while (0)
+
+// The LogSite of `caller` in a call site's slots, claiming a free slot the
+// first time the caller logs there.
+static LogSite* log_site_for(LogSiteSlot* slots, const char* caller) {
+    for (int i = 0; i < LOG_SITE_CALLERS; i++) {
+        const char* owner = atomic_load_explicit(&slots[i].caller, memory_order_acquire);
+        if (owner == NULL &&
+            atomic_compare_exchange_strong_explicit(&slots[i].caller, &owner, caller, memory_order_acq_rel,
+                                                    memory_order_acquire)) {
+            return &slots[i].site;
+        }
+        if (owner == caller || strcmp(owner, caller) == 0) {
+            return &slots[i].site;
+        }
+    }
+    return &slots[LOG_SITE_CALLERS - 1].site;
+}
+
+void Py_SetLogHandler(Py_LogHandler handler) {
+    atomic_store(&g_log_handler, handler);
+}
+
+// Whether a message from `site` is within its rate limit. Messages over the
+// limit are counted as suppressed.
+static int log_site_allow(LogSite* site) {
+    long long now = monotonic_ns();
+    long long start = atomic_load_explicit(&site->window_start_ns, memory_order_relaxed);
+    if (now - start >= 1000000000LL &&
+        atomic_compare_exchange_strong_explicit(&site->window_start_ns, &start, now, memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        atomic_store_explicit(&site->logged, 0, memory_order_relaxed);
+    }
+    if (atomic_fetch_add_explicit(&site->logged, 1, memory_order_relaxed) < PY_LOG_SITE_RATE) {
+        return 1;
+    }
+    atomic_fetch_add_explicit(&site->suppressed, 1, memory_order_relaxed);
+    return 0;
+}
+
+// Clear the pending Python exception, appending its "<type>: <message>" to
+// `buf` unless it is NULL. The caller must hold the GIL.
+static void take_python_error(char* buf, size_t size) {
+    if (!PyErr_Occurred()) {
+        return;
+    }
+#if PY_VERSION_HEX >= 0x030C0000
+    PyObject* exc = PyErr_GetRaisedException();
+#else
+    PyObject *type, *exc, *traceback;
+    PyErr_Fetch(&type, &exc, &traceback);
+    PyErr_NormalizeException(&type, &exc, &traceback);
+    Py_XDECREF(type);
+    Py_XDECREF(traceback);
+#endif
+    if (buf && exc) {
+        size_t len = strlen(buf);
+        PyObject* text = PyObject_Str(exc);
+        const char* message = text ? PyUnicode_AsUTF8(text) : NULL;
+        snprintf(buf + len, size - len, ": %s: %s", Py_TYPE(exc)->tp_name, message ? message : "<unprintable>");
+        Py_XDECREF(text);
+        // Errors raised while formatting the exception are not reported.
+        PyErr_Clear();
+    }
+    Py_XDECREF(exc);
+}
+
+// Format a message and pass it to the log handler, or to stderr without one,
+// unless its call site is over its rate limit. The Python exception of
+// `with_python_error` messages is cleared either way.
+static void bridge_log(LogSite* site, const char* site_name, int level, int with_python_error,
+                       const char* format, ...) {
+    if (!log_site_allow(site)) {
+        if (with_python_error) {
+            take_python_error(NULL, 0);
+        }
+        return;
+    }
+
+    char message[1024];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    if (with_python_error) {
+        take_python_error(message, sizeof(message));
+    }
+    int suppressed = atomic_exchange_explicit(&site->suppressed, 0, memory_order_relaxed);
+    if (suppressed > 0) {
+        size_t len = strlen(message);
+        snprintf(message + len, sizeof(message) - len, " (%d similar messages suppressed)", suppressed);
+    }
+
+    Py_LogHandler handler = atomic_load(&g_log_handler);
+    if (handler) {
+        handler(level, (char*)site_name, message);
+    } else {
+        static const char* level_names[] = {"ERROR", "WARNING", "INFO", "DEBUG"};
+        fprintf(stderr, "[C] %s %s - %s\n", site_name, level_names[level], message);
+    }
+}
+
+// === MODULE STATE ===
+
+static int is_callable(PyObject* obj) {
+    return obj && PyCallable_Check(obj);
+}
+
+// Drop a reference to a module state, releasing its objects with the last
+// one. The caller must hold the GIL of the state's interpreter.
+static void module_state_release(ModuleState* state) {
+    if (!state || atomic_fetch_sub_explicit(&state->refs, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
+    Py_XDECREF(state->render_func);
+    Py_XDECREF(state->render_batch_func);
+    Py_XDECREF(state->render_tokenize_func);
+    Py_XDECREF(state->get_model_chat_template_func);
+    Py_XDECREF(state->clear_caches_func);
+    Py_XDECREF(state->module);
+    free(state);
+}
+
+// Import the wrapper module into the current interpreter, reloading it if
+// `reload` is set, and return its state holding one reference, or NULL with
+// the error printed. The caller must hold the interpreter's GIL.
+static ModuleState* module_state_load(int reload, const char* caller) {
+    ModuleState* state = calloc(1, sizeof(*state));
+    if (!state) {
+        BRIDGE_LOG_AT(caller, PY_LOG_ERROR, 0, "Failed to allocate module state");
+        return NULL;
+    }
+    atomic_init(&state->refs, 1);
+
+    PyObject* module = PyImport_ImportModule("render_jinja_template_wrapper");
+    if (module && reload) {
+        PyObject* reloaded = PyImport_ReloadModule(module);
+        Py_DECREF(module);
+        module = reloaded;
+    }
+    state->module = module;
+    if (module) {
+        state->render_func = PyObject_GetAttrString(module, "render_jinja_template_raw");
+        state->render_batch_func = PyObject_GetAttrString(module, "render_jinja_template_batch_raw");
+        state->render_tokenize_func = PyObject_GetAttrString(module, "render_and_tokenize_raw");
+        state->get_model_chat_template_func = PyObject_GetAttrString(module, "get_model_chat_template");
+        state->clear_caches_func = PyObject_GetAttrString(module, "clear_caches");
+    }
+
+    if (!is_callable(state->render_func) || !is_callable(state->render_batch_func) ||
+        !is_callable(state->render_tokenize_func) ||
+        !is_callable(state->get_model_chat_template_func) || !is_callable(state->clear_caches_func)) {
+        BRIDGE_LOG_AT(caller, PY_LOG_ERROR, 1, "Failed to load render_jinja_template_wrapper");
+        module_state_release(state);
+        return NULL;
+    }
+    return state;
+}
+
+// Take a reference to the module state of interpreter `index`, or return
+// NULL if it has none. The caller must hold the interpreter's GIL.
+static ModuleState* module_state_acquire(int index) {
+    ModuleState* state = atomic_load_explicit(&g_interpreters[index].state, memory_order_acquire);
+    if (state) {
+        atomic_fetch_add_explicit(&state->refs, 1, memory_order_relaxed);
+    }
+    return state;
+}
+
+// Publish `state`, or NULL, as the module state of interpreter `index` and
+// drop the slot's reference to the previous one. The caller must hold
+// g_init_mutex and the interpreter's GIL.
+static void module_state_publish(int index, ModuleState* state) {
+    module_state_release(atomic_exchange_explicit(&g_interpreters[index].state, state, memory_order_acq_rel));
+}
+
+// Whether interpreter `index` has a module state. This is the only check
+// calls make before taking the GIL: a single atomic load.
+static int module_state_published(int index) {
+    return atomic_load_explicit(&g_interpreters[index].state, memory_order_acquire) != NULL;
+}
 
 // === ORIGINAL FUNCTION IMPLEMENTATIONS ===
 
-// Initialize Python interpreter
-int Py_InitializeGo() {
+// Initialize Python interpreter. The caller must hold g_init_mutex.
+static int initialize_python(void) {
     // Process-level initialization check
     if (g_process_initialized) {
         if (g_init_pid != getpid()) {
-            printf("[C] Py_InitializeGo WARNING - Different PID trying to initialize (init_pid: %d, current_pid: %d)\n", g_init_pid, getpid());
+            BRIDGE_LOG(PY_LOG_WARNING, "Different PID trying to initialize (init_pid: %d, current_pid: %d)",
+                       g_init_pid, getpid());
         } else {
-            printf("[C] Py_InitializeGo - Already initialized in this process (PID: %d)\n", getpid());
+            BRIDGE_LOG(PY_LOG_DEBUG, "Already initialized in this process (PID: %d)", getpid());
         }
         return 0;
     }
 
-    // Thread-safe initialization check
-    if (g_python_init_lock == NULL) {
-        g_python_init_lock = PyThread_allocate_lock();
-        if (g_python_init_lock == NULL) {
-            printf("[C] Py_InitializeGo ERROR - Failed to allocate Python init lock\n");
-            return -1;
-        }
-    }
-
-    PyThread_acquire_lock(g_python_init_lock, NOWAIT_LOCK);
-
-    // Double-check after acquiring lock
     if (g_python_initialized) {
-        printf("[C] Py_InitializeGo - Python already initialized globally\n");
-        PyThread_release_lock(g_python_init_lock);
+        BRIDGE_LOG(PY_LOG_DEBUG, "Python already initialized globally");
         return 0;
     }
 
@@ -80,41 +369,41 @@ int Py_InitializeGo() {
     g_python_initialized = 1;
     g_process_initialized = 1;
     g_init_pid = getpid();
-    PyThread_release_lock(g_python_init_lock);
-
     return 0;
 }
 
+// Initialize Python interpreter
+int Py_InitializeGo() {
+    pthread_mutex_lock(&g_init_mutex);
+    int rc = initialize_python();
+    pthread_mutex_unlock(&g_init_mutex);
+    return rc;
+}
+
 // Finalize Python interpreter
 void Py_FinalizeGo() {
+    pthread_mutex_lock(&g_init_mutex);
     // Prevent multiple finalizations
     if (g_finalized) {
-        printf("[C] Py_FinalizeGo - Already finalized, skipping\n");
+        BRIDGE_LOG(PY_LOG_DEBUG, "Already finalized, skipping");
+        pthread_mutex_unlock(&g_init_mutex);
         return;
     }
-    
-    // Mark as finalized first to prevent race conditions
     g_finalized = 1;
-    
-    // Clean up module references safely
-    if (g_render_jinja_template_func) {
-        Py_DECREF(g_render_jinja_template_func);
-        g_render_jinja_template_func = NULL;
-    }
-    if (g_get_model_chat_template_func) {
-        Py_DECREF(g_get_model_chat_template_func);
-        g_get_model_chat_template_func = NULL;
-    }
-    if (g_chat_template_module) {
-        Py_DECREF(g_chat_template_module);
-        g_chat_template_module = NULL;
+
+    // Drop the main interpreter's module state; calls in flight keep it
+    // alive until they return.
+    if (Py_IsInitialized() && module_state_published(0)) {
+        PyGILState_STATE gil_state = PyGILState_Ensure();
+        module_state_publish(0, NULL);
+        PyGILState_Release(gil_state);
     }
-    
+
     // Reset state without finalizing Python
     // Python will be cleaned up when the process exits
     g_python_initialized = 0;
     g_process_initialized = 0;
-    g_initialized = 0;
+    pthread_mutex_unlock(&g_init_mutex);
 }
 
 // CGo cannot call C macros, so we wrap PyRun_SimpleString in a function
@@ -144,347 +433,975 @@ const char* PyUnicode_AsGoString(PyObject* obj) {
 
 // === NEW CACHING FUNCTION IMPLEMENTATIONS ===
 
-// Initialize the cached module and functions (call once at startup)
-int Py_InitChatTemplateModule() {
-    
-    // Thread-safe initialization check
-    if (g_init_lock == NULL) {
-        g_init_lock = PyThread_allocate_lock();
-        if (g_init_lock == NULL) {
-            printf("[C] Py_InitChatTemplateModule ERROR - Failed to allocate module init lock\n");
-            return -1;
-        }
-    }
-    
-    PyThread_acquire_lock(g_init_lock, NOWAIT_LOCK);
-    
-    // Check if already initialized
-    if (g_initialized) {
-        printf("[C] Py_InitChatTemplateModule - Already initialized globally, returning\n");
-        PyThread_release_lock(g_init_lock);
+// Load the main interpreter's module state, reloading the module if `reload`
+// is set, and publish it. The caller must hold g_init_mutex.
+static int init_chat_template_module(int reload) {
+    if (!reload && module_state_published(0)) {
+        BRIDGE_LOG(PY_LOG_DEBUG, "Already initialized globally, returning");
         return 0;
     }
-    
+
     // Ensure Python is initialized
     if (!g_python_initialized) {
-        printf("[C] Py_InitChatTemplateModule ERROR - Python not initialized\n");
-        PyThread_release_lock(g_init_lock);
+        BRIDGE_LOG(PY_LOG_ERROR, "Python not initialized");
         return -1;
     }
-    
-    // Acquire GIL for module initialization
+
     PyGILState_STATE gil_state = PyGILState_Ensure();
-    
-
-    
-    // Import the chat template wrapper module AFTER setting up the path
-    g_chat_template_module = PyImport_ImportModule("render_jinja_template_wrapper");
-    if (!g_chat_template_module) {
-        printf("[C] Py_InitChatTemplateModule ERROR - Failed to import render_jinja_template_wrapper module\n");
-        PyErr_Print();
-        PyGILState_Release(gil_state);
-        PyThread_release_lock(g_init_lock);
-        return -1;
+    ModuleState* state = module_state_load(reload, "Py_InitChatTemplateModule");
+    if (state) {
+        module_state_publish(0, state);
     }
-    
-    // Get the module dictionary
-    PyObject* module_dict = PyModule_GetDict(g_chat_template_module);
-    if (!module_dict) {
-        printf("[C] Py_InitChatTemplateModule ERROR - Failed to get module dictionary\n");
-        PyGILState_Release(gil_state);
-        PyThread_release_lock(g_init_lock);
-        return -1;
+    PyGILState_Release(gil_state);
+    return state ? 0 : -1;
+}
+
+// Initialize the cached module and functions (call once at startup)
+int Py_InitChatTemplateModule() {
+    pthread_mutex_lock(&g_init_mutex);
+    int rc = init_chat_template_module(0);
+    pthread_mutex_unlock(&g_init_mutex);
+    return rc;
+}
+
+// Release the Python object pinned by a result buffer and reset the buffer
+void Py_ReleaseResultBuffer(Py_ResultBuffer* buf) {
+    if (!buf || !buf->owner) {
+        return;
     }
-    
-    // Get the render_jinja_template function
-    g_render_jinja_template_func = PyDict_GetItemString(module_dict, "render_jinja_template");
-    if (!g_render_jinja_template_func || !PyCallable_Check(g_render_jinja_template_func)) {
-        printf("[C] Py_InitChatTemplateModule ERROR - render_jinja_template function not found or not callable\n");
+
+    if (Py_IsInitialized()) {
+        PyGILState_STATE gil_state = PyGILState_Ensure();
+        Py_DECREF(buf->owner);
         PyGILState_Release(gil_state);
-        PyThread_release_lock(g_init_lock);
-        return -1;
     }
-    Py_INCREF(g_render_jinja_template_func); // Keep a reference
-    
-    // Get the get_model_chat_template function
-    g_get_model_chat_template_func = PyDict_GetItemString(module_dict, "get_model_chat_template");
-    if (!g_get_model_chat_template_func || !PyCallable_Check(g_get_model_chat_template_func)) {
-        printf("[C] Py_InitChatTemplateModule ERROR - get_model_chat_template function not found or not callable\n");
-        PyGILState_Release(gil_state);
-        PyThread_release_lock(g_init_lock);
+
+    buf->owner = NULL;
+    buf->data = NULL;
+    buf->len = 0;
+}
+
+// Free the arrays of a render result without touching its owner
+static void free_render_arrays(Py_RenderResult* result) {
+    free((void*)result->chats);
+    free(result->chat_lens);
+    free(result->span_counts);
+    free(result->spans);
+    result->chats = NULL;
+    result->chat_lens = NULL;
+    result->span_counts = NULL;
+    result->spans = NULL;
+    result->num_chats = 0;
+}
+
+// Release the Python object pinned by a render result and free its arrays
+void Py_ReleaseRenderResult(Py_RenderResult* result) {
+    Py_ReleaseRenderResults(result, 1);
+}
+
+// Release the render results of a batch call, entering their interpreter once
+void Py_ReleaseRenderResults(Py_RenderResult* results, Py_ssize_t count) {
+    if (!results || count <= 0) {
+        return;
+    }
+
+    // The arrays are plain C memory and can be freed without the GIL.
+    int pinned = 0;
+    for (Py_ssize_t i = 0; i < count; i++) {
+        free_render_arrays(&results[i]);
+        pinned |= results[i].owner != NULL;
+    }
+
+    // The owners belong to the interpreter that rendered them.
+    if (pinned && Py_IsInitialized()) {
+        InterpreterGuard guard;
+        interpreter_enter(results[0].interp, &guard);
+        for (Py_ssize_t i = 0; i < count; i++) {
+            Py_XDECREF(results[i].owner);
+        }
+        interpreter_exit(&guard);
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        results[i].owner = NULL;
+        results[i].error_message = NULL;
+        results[i].error_len = 0;
+    }
+}
+
+void Py_ReleaseTokenizeResult(Py_TokenizeResult* result) {
+    if (!result) {
+        return;
+    }
+    // Plain C memory, freed without the GIL.
+    free(result->token_ids);
+    free(result->offsets);
+    result->token_ids = NULL;
+    result->offsets = NULL;
+    result->num_tokens = 0;
+}
+
+// Reader over a binary wire format request.
+typedef struct {
+    const char* pos;
+    const char* end;
+} WireReader;
+
+// Copy the next `size` bytes of the request into `dst`. Returns -1 with
+// ValueError set if the request is truncated.
+static int wire_read(WireReader* r, void* dst, Py_ssize_t size) {
+    if (r->end - r->pos < size) {
+        PyErr_SetString(PyExc_ValueError, "truncated wire format request");
         return -1;
     }
-    Py_INCREF(g_get_model_chat_template_func); // Keep a reference
-    
-    // Release GIL
-    PyGILState_Release(gil_state);
-    
-    g_initialized = 1;
-    PyThread_release_lock(g_init_lock);
+    memcpy(dst, r->pos, size);
+    r->pos += size;
     return 0;
 }
 
+// Decode the next value of a binary wire format request into a new Python
+// object, or return NULL with the error set.
+static PyObject* wire_decode_value(WireReader* r, int depth) {
+    unsigned char tag;
+    if (wire_read(r, &tag, 1) < 0) {
+        return NULL;
+    }
 
+    switch (tag) {
+    case PY_WIRE_NONE:
+        Py_RETURN_NONE;
+    case PY_WIRE_FALSE:
+        Py_RETURN_FALSE;
+    case PY_WIRE_TRUE:
+        Py_RETURN_TRUE;
+    case PY_WIRE_INT: {
+        int64_t value;
+        if (wire_read(r, &value, sizeof(value)) < 0) {
+            return NULL;
+        }
+        return PyLong_FromLongLong(value);
+    }
+    case PY_WIRE_FLOAT: {
+        double value;
+        if (wire_read(r, &value, sizeof(value)) < 0) {
+            return NULL;
+        }
+        return PyFloat_FromDouble(value);
+    }
+    case PY_WIRE_STR: {
+        uint32_t len;
+        if (wire_read(r, &len, sizeof(len)) < 0) {
+            return NULL;
+        }
+        if (r->end - r->pos < (Py_ssize_t)len) {
+            PyErr_SetString(PyExc_ValueError, "truncated wire format request");
+            return NULL;
+        }
+        PyObject* str = PyUnicode_DecodeUTF8(r->pos, len, "strict");
+        r->pos += len;
+        return str;
+    }
+    case PY_WIRE_LIST:
+    case PY_WIRE_DICT: {
+        uint32_t count;
+        if (wire_read(r, &count, sizeof(count)) < 0) {
+            return NULL;
+        }
+        if (depth >= PY_WIRE_MAX_DEPTH) {
+            PyErr_SetString(PyExc_ValueError, "wire format request nested too deeply");
+            return NULL;
+        }
+        // Every item takes at least a tag byte: do not trust larger counts.
+        if (r->end - r->pos < (Py_ssize_t)count) {
+            PyErr_SetString(PyExc_ValueError, "truncated wire format request");
+            return NULL;
+        }
 
-// Call the cached render_jinja_template function
-char* Py_CallRenderJinjaTemplate(const char* json_request) {
-    // Try direct call first (fast path)
-    char* result = Py_CallRenderJinjaTemplateInternal(json_request);
-    if (result != NULL) {
-        return result;  // Success on first try
-    }
-    
-    // If failed, just return NULL (no retry, no reload)
+        if (tag == PY_WIRE_LIST) {
+            PyObject* list = PyList_New(count);
+            if (!list) {
+                return NULL;
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                PyObject* item = wire_decode_value(r, depth + 1);
+                if (!item) {
+                    Py_DECREF(list);
+                    return NULL;
+                }
+                PyList_SET_ITEM(list, i, item);
+            }
+            return list;
+        }
+
+        PyObject* dict = PyDict_New();
+        if (!dict) {
+            return NULL;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            PyObject* key = wire_decode_value(r, depth + 1);
+            PyObject* value = key ? wire_decode_value(r, depth + 1) : NULL;
+            int rc = value ? PyDict_SetItem(dict, key, value) : -1;
+            Py_XDECREF(key);
+            Py_XDECREF(value);
+            if (rc < 0) {
+                Py_DECREF(dict);
+                return NULL;
+            }
+        }
+        return dict;
+    }
+    default:
+        PyErr_Format(PyExc_ValueError, "unknown wire format tag %d", tag);
         return NULL;
+    }
 }
 
-// Internal function that does the actual work
-char* Py_CallRenderJinjaTemplateInternal(const char* json_request) {    
-    // Check if Python interpreter is still valid
-    if (!Py_IsInitialized()) {
-        printf("[C] Py_CallRenderJinjaTemplateInternal ERROR - Python interpreter not initialized\n");
-        return NULL;
+// Decode a request into the argument of a wrapper function: a dict or list
+// for the binary wire format (see PY_WIRE_MAGIC), a str for JSON.
+static PyObject* decode_request(const char* request, Py_ssize_t len) {
+    if (len == 0 || (unsigned char)request[0] != PY_WIRE_MAGIC) {
+        return PyUnicode_FromStringAndSize(request, len);
     }
-    
-    // Simple validation
-    if (!json_request) {
-        printf("[C] Py_CallRenderJinjaTemplateInternal ERROR - Input is NULL\n");
+
+    WireReader r = {request + 1, request + len};
+    PyObject* value = wire_decode_value(&r, 0);
+    if (value && r.pos != r.end) {
+        Py_DECREF(value);
+        PyErr_SetString(PyExc_ValueError, "trailing bytes after wire format request");
         return NULL;
     }
-    
-    // Acquire GIL for Python operations
-    PyGILState_STATE gil_state = PyGILState_Ensure();    
-    // Create Python string from JSON request
-    PyObject* py_json = PyUnicode_FromString(json_request);
-    if (!py_json) {
-        printf("[C] Py_CallRenderJinjaTemplateInternal ERROR - Failed to create Python string\n");
-        PyGILState_Release(gil_state);
+    return value;
+}
+
+// Call a cached wrapper function with a single request argument, JSON or in
+// the binary wire format, adding the time spent building the argument and in
+// the call to `timings`. Returns a new reference, or NULL with the error
+// printed. The caller must hold the GIL.
+static PyObject* call_cached_function(PyObject* func, const char* caller, const char* json_request,
+                                      Py_ssize_t json_len, Py_CallTimings* timings) {
+    long long start = monotonic_ns();
+    PyObject* py_request = decode_request(json_request, json_len);
+    if (!py_request) {
+        BRIDGE_LOG_AT(caller, PY_LOG_ERROR, 1, "Failed to decode request");
         return NULL;
     }
 
     // Create arguments tuple
-    PyObject* args = PyTuple_Pack(1, py_json);
+    PyObject* args = PyTuple_Pack(1, py_request);
+    Py_DECREF(py_request);
     if (!args) {
-        printf("[C] Py_CallRenderJinjaTemplateInternal ERROR - Failed to create args tuple\n");
-        Py_DECREF(py_json);
-        PyGILState_Release(gil_state);
+        BRIDGE_LOG_AT(caller, PY_LOG_ERROR, 1, "Failed to create args tuple");
         return NULL;
-    }    
+    }
+
+    timings_lap(&timings->args_ns, &start);
 
     // Call the cached function
-    PyObject* py_result = PyObject_CallObject(g_render_jinja_template_func, args);
-    
-    // Clean up args
+    PyObject* py_result = PyObject_CallObject(func, args);
     Py_DECREF(args);
-    Py_DECREF(py_json);
-    
-    char* cresult = NULL;
-    if (py_result) {
-        // Convert to C string
-        const char* s = PyUnicode_AsUTF8(py_result);
-        if (s) {
-            cresult = strdup(s);
+    timings_lap(&timings->call_ns, &start);
+    if (!py_result) {
+        BRIDGE_LOG_AT(caller, PY_LOG_ERROR, 1, "Python function returned NULL");
+        return NULL;
+    }
+
+    return py_result;
+}
+
+// Pin a string result into a result buffer. Steals the reference to py_result.
+// The caller must hold the GIL.
+static int fill_result_buffer(PyObject* py_result, const char* caller, Py_ResultBuffer* out) {
+    // Borrow the UTF-8 representation; it lives as long as py_result does.
+    Py_ssize_t len = 0;
+    const char* data = PyUnicode_AsUTF8AndSize(py_result, &len);
+    if (!data) {
+        BRIDGE_LOG_AT(caller, PY_LOG_ERROR, 1, "Failed to convert result to C string");
+        Py_DECREF(py_result);
+        return -1;
+    }
+
+    // Hand the reference over to the buffer; released by Py_ReleaseResultBuffer.
+    out->owner = py_result;
+    out->data = data;
+    out->len = len;
+    return 0;
+}
+
+// Flatten the generation indices of one chat into out->spans starting at `offset`.
+// Returns the number of pairs written, or -1 on error. The caller must hold the GIL.
+static Py_ssize_t fill_chat_spans(PyObject* chat_indices, Py_RenderResult* out, Py_ssize_t offset) {
+    PyObject* pairs = PySequence_Fast(chat_indices, "generation indices must be a sequence");
+    if (!pairs) {
+        return -1;
+    }
+
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(pairs);
+    for (Py_ssize_t j = 0; j < count; j++) {
+        PyObject* pair = PySequence_Fast(PySequence_Fast_GET_ITEM(pairs, j), "generation index must be a pair");
+        if (!pair) {
+            Py_DECREF(pairs);
+            return -1;
+        }
+        if (PySequence_Fast_GET_SIZE(pair) != 2) {
+            PyErr_SetString(PyExc_ValueError, "generation index must be a (start, end) pair");
+            Py_DECREF(pair);
+            Py_DECREF(pairs);
+            return -1;
+        }
+        if (out->spans) {
+            out->spans[2 * (offset + j)] = PyLong_AsLongLong(PySequence_Fast_GET_ITEM(pair, 0));
+            out->spans[2 * (offset + j) + 1] = PyLong_AsLongLong(PySequence_Fast_GET_ITEM(pair, 1));
+        }
+        Py_DECREF(pair);
+        if (PyErr_Occurred()) {
+            Py_DECREF(pairs);
+            return -1;
+        }
+    }
+
+    Py_DECREF(pairs);
+    return count;
+}
+
+// Expose a (rendered_chats, generation_indices) tuple through a render result.
+// Steals the reference to py_result. The caller must hold the GIL.
+static int fill_render_result(PyObject* py_result, Py_RenderResult* out) {
+    PyObject* chats = NULL;
+    PyObject* indices = NULL;
+
+    if (!PyTuple_Check(py_result) || PyTuple_GET_SIZE(py_result) != 2) {
+        BRIDGE_LOG(PY_LOG_ERROR, "Expected a (rendered_chats, generation_indices) tuple");
+        goto error;
+    }
+
+    chats = PySequence_Fast(PyTuple_GET_ITEM(py_result, 0), "rendered_chats must be a sequence");
+    indices = PySequence_Fast(PyTuple_GET_ITEM(py_result, 1), "generation_indices must be a sequence");
+    if (!chats || !indices) {
+        BRIDGE_LOG_PYERR(PY_LOG_ERROR, "Invalid result sequences");
+        goto error;
+    }
+
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(chats);
+    Py_ssize_t n_indices = PySequence_Fast_GET_SIZE(indices);
+    out->num_chats = n;
+    out->chats = calloc(n > 0 ? n : 1, sizeof(char*));
+    out->chat_lens = calloc(n > 0 ? n : 1, sizeof(Py_ssize_t));
+    out->span_counts = calloc(n > 0 ? n : 1, sizeof(Py_ssize_t));
+    if (!out->chats || !out->chat_lens || !out->span_counts) {
+        BRIDGE_LOG(PY_LOG_ERROR, "Out of memory");
+        goto error;
+    }
+
+    // First pass: borrow the rendered strings and count the generation spans.
+    Py_ssize_t total_spans = 0;
+    for (Py_ssize_t i = 0; i < n; i++) {
+        Py_ssize_t len = 0;
+        const char* data = PyUnicode_AsUTF8AndSize(PySequence_Fast_GET_ITEM(chats, i), &len);
+        if (!data) {
+            BRIDGE_LOG_PYERR(PY_LOG_ERROR, "Failed to convert rendered chat to C string");
+            goto error;
+        }
+        out->chats[i] = data;
+        out->chat_lens[i] = len;
+
+        if (i < n_indices) {
+            Py_ssize_t count = fill_chat_spans(PySequence_Fast_GET_ITEM(indices, i), out, 0);
+            if (count < 0) {
+                BRIDGE_LOG_PYERR(PY_LOG_ERROR, "Invalid generation indices");
+                goto error;
+            }
+            out->span_counts[i] = count;
+            total_spans += count;
+        }
+    }
+
+    // Second pass: flatten the generation spans.
+    if (total_spans > 0) {
+        out->spans = malloc(2 * total_spans * sizeof(long long));
+        if (!out->spans) {
+            BRIDGE_LOG(PY_LOG_ERROR, "Out of memory");
+            goto error;
+        }
+        Py_ssize_t offset = 0;
+        for (Py_ssize_t i = 0; i < n && i < n_indices; i++) {
+            if (fill_chat_spans(PySequence_Fast_GET_ITEM(indices, i), out, offset) < 0) {
+                BRIDGE_LOG_PYERR(PY_LOG_ERROR, "Invalid generation indices");
+                goto error;
+            }
+            offset += out->span_counts[i];
+        }
+    }
+
+    Py_DECREF(chats);
+    Py_DECREF(indices);
+    // Hand the reference over to the result; released by Py_ReleaseRenderResult.
+    out->owner = py_result;
+    return 0;
+
+error:
+    Py_XDECREF(chats);
+    Py_XDECREF(indices);
+    Py_DECREF(py_result);
+    free_render_arrays(out);
+    return -1;
+}
+
+// Expose the per-request results of a batch call through `out`. Items are
+// (rendered_chats, generation_indices) tuples, None for requests whose chat
+// template is not cached, or error messages. The caller keeps its reference to
+// py_results and must hold the GIL.
+static int fill_batch_results(PyObject* py_results, Py_ssize_t count, Py_RenderResult* out) {
+    PyObject* items = PySequence_Fast(py_results, "batch results must be a sequence");
+    if (!items) {
+        BRIDGE_LOG_PYERR(PY_LOG_ERROR, "Invalid batch results");
+        return -1;
+    }
+    if (PySequence_Fast_GET_SIZE(items) != count) {
+        BRIDGE_LOG(PY_LOG_ERROR, "Expected %zd results, got %zd", count, PySequence_Fast_GET_SIZE(items));
+        Py_DECREF(items);
+        return -1;
+    }
+
+    for (Py_ssize_t i = 0; i < count; i++) {
+        PyObject* item = PySequence_Fast_GET_ITEM(items, i);
+        if (item == Py_None) {
+            out[i].status = PY_RENDER_TEMPLATE_NOT_CACHED;
+        } else if (PyUnicode_Check(item)) {
+            // Pin the message like rendered chats are pinned.
+            Py_INCREF(item);
+            out[i].owner = item;
+            out[i].error_message = PyUnicode_AsUTF8AndSize(item, &out[i].error_len);
+            if (!out[i].error_message) {
+                PyErr_Clear();
+            }
+            out[i].status = -1;
         } else {
-            printf("[C] Py_CallRenderJinjaTemplateInternal ERROR - Failed to convert result to C string\n");
+            // fill_render_result steals the reference.
+            Py_INCREF(item);
+            out[i].status = fill_render_result(item, &out[i]) == 0 ? 0 : -1;
         }
-        Py_DECREF(py_result);
+    }
+
+    Py_DECREF(items);
+    return 0;
+}
+
+// Byte length of the UTF-8 sequence starting with `lead`
+static Py_ssize_t utf8_sequence_length(unsigned char lead) {
+    return lead < 0x80 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+}
+
+// Copy a (rendered_chat, token_ids, offsets) tuple into a tokenize result,
+// converting the character offsets of the tokens to byte offsets in the UTF-8
+// rendered chat. Offsets are mostly increasing, so they are converted in a
+// single forward scan, restarted for the rare offset behind it. Steals the
+// reference to py_result. The caller must hold the GIL.
+static int fill_tokenize_result(PyObject* py_result, Py_TokenizeResult* out) {
+    PyObject* ids = NULL;
+    PyObject* offsets = NULL;
+    int rc = -1;
+
+    if (!PyTuple_Check(py_result) || PyTuple_GET_SIZE(py_result) != 3 ||
+        !PyUnicode_Check(PyTuple_GET_ITEM(py_result, 0))) {
+        BRIDGE_LOG(PY_LOG_ERROR, "Expected a (rendered_chat, token_ids, offsets) tuple");
+        goto done;
+    }
+    PyObject* rendered = PyTuple_GET_ITEM(py_result, 0);
+    Py_ssize_t rendered_len = 0;
+    const char* data = PyUnicode_AsUTF8AndSize(rendered, &rendered_len);
+    ids = PySequence_Fast(PyTuple_GET_ITEM(py_result, 1), "token_ids must be a sequence");
+    offsets = PySequence_Fast(PyTuple_GET_ITEM(py_result, 2), "offsets must be a sequence");
+    if (!data || !ids || !offsets) {
+        BRIDGE_LOG_PYERR(PY_LOG_ERROR, "Invalid tokenize result");
+        goto done;
+    }
+
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(ids);
+    if (PySequence_Fast_GET_SIZE(offsets) != n) {
+        BRIDGE_LOG(PY_LOG_ERROR, "Expected %zd offsets, got %zd", n, PySequence_Fast_GET_SIZE(offsets));
+        goto done;
+    }
+    out->token_ids = malloc((n > 0 ? n : 1) * sizeof(unsigned int));
+    out->offsets = malloc((n > 0 ? 2 * n : 1) * sizeof(Py_ssize_t));
+    if (!out->token_ids || !out->offsets) {
+        BRIDGE_LOG(PY_LOG_ERROR, "Out of memory");
+        goto done;
+    }
+
+    int ascii = PyUnicode_IS_ASCII(rendered);
+    Py_ssize_t num_chars = PyUnicode_GET_LENGTH(rendered);
+    Py_ssize_t char_pos = 0;
+    Py_ssize_t byte_pos = 0;
+    for (Py_ssize_t i = 0; i < n; i++) {
+        out->token_ids[i] = (unsigned int)PyLong_AsUnsignedLong(PySequence_Fast_GET_ITEM(ids, i));
+        PyObject* pair = PySequence_Fast_GET_ITEM(offsets, i);
+        if (!PyTuple_Check(pair) || PyTuple_GET_SIZE(pair) != 2) {
+            PyErr_SetString(PyExc_ValueError, "offset must be a (start, end) tuple");
+        }
+        for (int j = 0; j < 2 && !PyErr_Occurred(); j++) {
+            Py_ssize_t target = PyLong_AsSsize_t(PyTuple_GET_ITEM(pair, j));
+            if (target < 0 || target > num_chars) {
+                if (!PyErr_Occurred()) {
+                    PyErr_SetString(PyExc_ValueError, "offset out of range");
+                }
+                break;
+            }
+            if (ascii) {
+                out->offsets[2 * i + j] = target;
+                continue;
+            }
+            if (target < char_pos) {
+                char_pos = 0;
+                byte_pos = 0;
+            }
+            for (; char_pos < target; char_pos++) {
+                byte_pos += utf8_sequence_length((unsigned char)data[byte_pos]);
+            }
+            out->offsets[2 * i + j] = byte_pos;
+        }
+        if (PyErr_Occurred()) {
+            BRIDGE_LOG_PYERR(PY_LOG_ERROR, "Invalid token %zd", i);
+            goto done;
+        }
+    }
+    out->num_tokens = n;
+    rc = 0;
+
+done:
+    if (rc != 0) {
+        Py_ReleaseTokenizeResult(out);
+    }
+    Py_XDECREF(ids);
+    Py_XDECREF(offsets);
+    Py_DECREF(py_result);
+    return rc;
+}
+
+// === INTERPRETER POOL ===
+
+#if PY_VERSION_HEX >= 0x030C0000
+// Load the wrapper module into sub-interpreter `index` and publish its state.
+// The caller must hold g_init_mutex and the sub-interpreter's GIL.
+static int load_sub_interpreter_module(int index) {
+    ModuleState* state = module_state_load(0, "load_sub_interpreter_module");
+    if (!state) {
+        return -1;
+    }
+
+    // Import transformers now: extension modules that do not support
+    // per-interpreter GILs fail here rather than on the first request.
+    PyObject* available = PyObject_CallMethod(state->module, "_ensure_transformers_available", NULL);
+    int ok = available && PyObject_IsTrue(available) == 1;
+    Py_XDECREF(available);
+    if (!ok) {
+        BRIDGE_LOG(PY_LOG_ERROR, "transformers is not importable in a sub-interpreter");
+        PyErr_Clear();
+        module_state_release(state);
+        return -1;
+    }
+
+    module_state_publish(index, state);
+    return 0;
+}
+
+// Bring up the sub-interpreter of slot `index`, creating it with its own GIL unless
+// a parked one can be reused. The caller must hold g_init_mutex and the main
+// interpreter's GIL through `main_tstate`, which is current again when this returns.
+static int start_sub_interpreter(PyThreadState* main_tstate, int index) {
+    InterpreterSlot* slot = &g_interpreters[index];
+    if (slot->interp) {
+        // Reuse an interpreter parked by cleanup_interpreter_pool. It is
+        // entered through a fresh thread state: restoring the home thread
+        // state would bind it to this OS thread for PyGILState_Ensure.
+        InterpreterGuard guard;
+        PyEval_SaveThread();
+        interpreter_enter(index, &guard);
+        int rc = load_sub_interpreter_module(index);
+        interpreter_exit(&guard);
+        PyEval_RestoreThread(main_tstate);
+        return rc;
+    }
+
+    PyInterpreterConfig config = {
+        .use_main_obmalloc = 0,
+        .allow_fork = 0,
+        .allow_exec = 0,
+        .allow_threads = 1,
+        .allow_daemon_threads = 0,
+        .check_multi_interp_extensions = 1,
+        .gil = PyInterpreterConfig_OWN_GIL,
+    };
+
+    PyThreadState* sub_tstate = NULL;
+    PyStatus status = Py_NewInterpreterFromConfig(&sub_tstate, &config);
+    if (PyStatus_Exception(status) || !sub_tstate) {
+        // On failure the previous thread state is restored by CPython.
+        BRIDGE_LOG(PY_LOG_ERROR, "Failed to create sub-interpreter: %s",
+                   status.err_msg ? status.err_msg : "unknown error");
+        return -1;
+    }
+
+    // The new interpreter is current and its GIL is held.
+    if (load_sub_interpreter_module(index) != 0) {
+        // Still on the creating thread, so the interpreter can be ended cleanly.
+        Py_EndInterpreter(sub_tstate);
+        PyEval_RestoreThread(main_tstate);
+        return -1;
+    }
+
+    // Park the setup thread state (releasing the sub-interpreter's GIL) and
+    // return to the main interpreter. It stays alive for the lifetime of the
+    // interpreter: CPython cannot reuse an interpreter's initial thread state
+    // once it is deleted, and the interpreter's threading module treats it as
+    // the main thread.
+    slot->interp = PyThreadState_GetInterpreter(sub_tstate);
+    slot->home_tstate = PyEval_SaveThread();
+    PyEval_RestoreThread(main_tstate);
+    return 0;
+}
+
+// Drop the module state of a sub-interpreter and park it. Interpreters are
+// not ended, like the main interpreter is never finalized (see Py_FinalizeGo):
+// Py_EndInterpreter waits for the interpreter's main thread, which is the OS
+// thread that created it and may not be the calling one.
+// The caller must hold g_init_mutex and no GIL.
+static void park_sub_interpreter(int index) {
+    InterpreterGuard guard;
+    interpreter_enter(index, &guard);
+    module_state_publish(index, NULL);
+    interpreter_exit(&guard);
+}
+#endif
+
+// Grow the render pool to `size` interpreters
+int Py_InitInterpreterPool(int size) {
+    pthread_mutex_lock(&g_init_mutex);
+    if (!module_state_published(0)) {
+        BRIDGE_LOG(PY_LOG_ERROR, "Module not initialized");
+        pthread_mutex_unlock(&g_init_mutex);
+        return -1;
+    }
+    if (size > PY_MAX_INTERPRETERS) {
+        BRIDGE_LOG(PY_LOG_WARNING, "Pool size %d capped to %d", size, PY_MAX_INTERPRETERS);
+        size = PY_MAX_INTERPRETERS;
+    }
+
+    int num_interpreters = atomic_load(&g_num_interpreters);
+    if (size > num_interpreters) {
+#if PY_VERSION_HEX >= 0x030C0000
+        PyGILState_STATE gil_state = PyGILState_Ensure();
+        PyThreadState* main_tstate = PyThreadState_Get();
+        while (num_interpreters < size) {
+            if (start_sub_interpreter(main_tstate, num_interpreters) != 0) {
+                BRIDGE_LOG(PY_LOG_WARNING, "Stopping at %d interpreters", num_interpreters);
+                break;
+            }
+            atomic_store(&g_num_interpreters, ++num_interpreters);
+        }
+        PyGILState_Release(gil_state);
+#else
+        BRIDGE_LOG(PY_LOG_WARNING, "Sub-interpreters with their own GIL require Python 3.12+");
+#endif
+    }
+
+    pthread_mutex_unlock(&g_init_mutex);
+    return num_interpreters;
+}
+
+// Number of interpreters in the render pool
+int Py_InterpreterPoolSize(void) {
+    return atomic_load(&g_num_interpreters);
+}
+
+// Shrink the render pool back to the main interpreter. The caller must hold
+// g_init_mutex and no GIL.
+static void cleanup_interpreter_pool(void) {
+#if PY_VERSION_HEX >= 0x030C0000
+    for (int i = atomic_load(&g_num_interpreters) - 1; i > 0; i--) {
+        atomic_store(&g_num_interpreters, i);
+        park_sub_interpreter(i);
+    }
+#endif
+    atomic_store(&g_num_interpreters, 1);
+}
+
+// Check the interpreter a call targets. Interpreters outside the pool, or
+// whose module was dropped, have no module state.
+static int check_interpreter(int interp, const char* caller) {
+    if (interp < 0 || interp >= PY_MAX_INTERPRETERS) {
+        BRIDGE_LOG_AT(caller, PY_LOG_ERROR, 0, "Invalid input");
+        return -1;
+    }
+    if (!module_state_published(interp)) {
+        BRIDGE_LOG_AT(caller, PY_LOG_ERROR, 0, "Module not initialized on interpreter %d", interp);
+        return -1;
+    }
+    return 0;
+}
+
+// Call the cached render_jinja_template function
+int Py_CallRenderJinjaTemplate(int interp, const char* json_request, Py_ssize_t json_len, Py_RenderResult* out,
+                               Py_CallTimings* timings) {
+    // Simple validation
+    if (!json_request || json_len < 0 || !out || !timings) {
+        BRIDGE_LOG(PY_LOG_ERROR, "Invalid input");
+        return -1;
+    }
+    memset(out, 0, sizeof(*out));
+    memset(timings, 0, sizeof(*timings));
+    out->interp = interp;
+    if (check_interpreter(interp, "Py_CallRenderJinjaTemplate") != 0) {
+        return -1;
+    }
+
+    // Acquire GIL only for the Python call and for pinning its result. The
+    // result is handed to Go as raw pointers, so neither json.dumps nor the
+    // Go-side decoding runs under the GIL.
+    long long start = monotonic_ns();
+    InterpreterGuard guard;
+    interpreter_enter(interp, &guard);
+    timings_lap(&timings->gil_wait_ns, &start);
+    int rc = -1;
+    ModuleState* state = module_state_acquire(interp);
+    if (!state) {
+        // Dropped since it was checked.
+        BRIDGE_LOG(PY_LOG_ERROR, "Module not initialized on interpreter %d", interp);
     } else {
-        printf("[C] Py_CallRenderJinjaTemplateInternal ERROR - Python function returned NULL\n");
-        PyErr_Print();
-        fflush(stderr);
+        PyObject* py_result = call_cached_function(state->render_func, "Py_CallRenderJinjaTemplate", json_request,
+                                                   json_len, timings);
+        start = monotonic_ns();
+        if (py_result == Py_None) {
+            // The wrapper does not hold the chat template the request refers to.
+            Py_DECREF(py_result);
+            rc = PY_RENDER_TEMPLATE_NOT_CACHED;
+        } else if (py_result) {
+            rc = fill_render_result(py_result, out);
+        }
+        timings_lap(&timings->convert_ns, &start);
+        module_state_release(state);
     }
-    
     // Release GIL
-    PyGILState_Release(gil_state);
-    
-    return cresult;
+    interpreter_exit(&guard);
+
+    return rc;
 }
 
-// Call the cached get_model_chat_template function
-char* Py_CallGetModelChatTemplate(const char* json_request) {    
-    // Try direct call first (fast path)
-    char* result = Py_CallGetModelChatTemplateInternal(json_request);
-    if (result != NULL) {
-        return result;  // Success on first try
+// Call the cached render_jinja_template_batch function
+int Py_CallRenderJinjaTemplateBatch(int interp, const char* json_request, Py_ssize_t json_len,
+                                    Py_ssize_t count, Py_RenderResult* out, Py_CallTimings* timings) {
+    if (!out || count <= 0 || !timings) {
+        BRIDGE_LOG(PY_LOG_ERROR, "Invalid input");
+        return -1;
+    }
+    memset(out, 0, count * sizeof(*out));
+    memset(timings, 0, sizeof(*timings));
+    for (Py_ssize_t i = 0; i < count; i++) {
+        out[i].interp = interp;
+        out[i].status = -1;
+    }
+
+    // Simple validation
+    if (!json_request || json_len < 0) {
+        BRIDGE_LOG(PY_LOG_ERROR, "Invalid input");
+        return -1;
+    }
+    if (check_interpreter(interp, "Py_CallRenderJinjaTemplateBatch") != 0) {
+        return -1;
     }
-    
-    // If failed, just return NULL (no retry, no reload)
-    return NULL;
+
+    // One GIL acquisition for the whole batch, see Py_CallRenderJinjaTemplate.
+    long long start = monotonic_ns();
+    InterpreterGuard guard;
+    interpreter_enter(interp, &guard);
+    timings_lap(&timings->gil_wait_ns, &start);
+    int rc = -1;
+    ModuleState* state = module_state_acquire(interp);
+    if (!state) {
+        BRIDGE_LOG(PY_LOG_ERROR, "Module not initialized on interpreter %d", interp);
+    } else {
+        PyObject* py_results = call_cached_function(state->render_batch_func, "Py_CallRenderJinjaTemplateBatch",
+                                                    json_request, json_len, timings);
+        start = monotonic_ns();
+        if (py_results) {
+            rc = fill_batch_results(py_results, count, out);
+            // The results pin the items they expose.
+            Py_DECREF(py_results);
+        }
+        timings_lap(&timings->convert_ns, &start);
+        module_state_release(state);
+    }
+    // Release GIL
+    interpreter_exit(&guard);
+
+    return rc;
 }
 
-// Internal function that does the actual work
-char* Py_CallGetModelChatTemplateInternal(const char* json_request) {    
-    // Check if Python is initialized
-    if (!g_python_initialized) {
-        printf("[C] Py_CallGetModelChatTemplateInternal ERROR - Python not initialized\n");
-        fflush(stdout);
-        return NULL;
+// Call the cached render_and_tokenize function
+int Py_CallRenderAndTokenize(int interp, const char* request, Py_ssize_t request_len, Py_TokenizeResult* out,
+                             Py_CallTimings* timings) {
+    // Simple validation
+    if (!request || request_len < 0 || !out || !timings) {
+        BRIDGE_LOG(PY_LOG_ERROR, "Invalid input");
+        return -1;
     }
-    
-    // Validate cached function
-    if (!g_get_model_chat_template_func) {
-        printf("[C] Py_CallGetModelChatTemplateInternal ERROR - Cached function is NULL\n");
-        fflush(stdout);
-        return NULL;
+    memset(out, 0, sizeof(*out));
+    memset(timings, 0, sizeof(*timings));
+    if (check_interpreter(interp, "Py_CallRenderAndTokenize") != 0) {
+        return -1;
     }
-    
-    // Validate that the cached function is still a valid Python object
-    fflush(stdout);
-    if (!PyCallable_Check(g_get_model_chat_template_func)) {
-        printf("[C] Py_CallGetModelChatTemplateInternal ERROR - Cached function is not callable (corrupted?)\n");
-        fflush(stdout);
-        return NULL;
+
+    // The tokens are copied out under the GIL, so the result needs no
+    // interpreter to be released.
+    long long start = monotonic_ns();
+    InterpreterGuard guard;
+    interpreter_enter(interp, &guard);
+    timings_lap(&timings->gil_wait_ns, &start);
+    int rc = -1;
+    ModuleState* state = module_state_acquire(interp);
+    if (!state) {
+        BRIDGE_LOG(PY_LOG_ERROR, "Module not initialized on interpreter %d", interp);
+    } else {
+        PyObject* py_result = call_cached_function(state->render_tokenize_func, "Py_CallRenderAndTokenize", request,
+                                                   request_len, timings);
+        start = monotonic_ns();
+        if (py_result == Py_None) {
+            Py_DECREF(py_result);
+            rc = PY_RENDER_TEMPLATE_NOT_CACHED;
+        } else if (py_result) {
+            rc = fill_tokenize_result(py_result, out);
+        }
+        timings_lap(&timings->convert_ns, &start);
+        module_state_release(state);
     }
-    
+    // Release GIL
+    interpreter_exit(&guard);
+
+    return rc;
+}
+
+// Call the cached get_model_chat_template function
+int Py_CallGetModelChatTemplate(const char* json_request, Py_ssize_t json_len, Py_ResultBuffer* out,
+                                Py_CallTimings* timings) {
     // Validate input
-    if (!json_request) {
-        printf("[C] Py_CallGetModelChatTemplateInternal ERROR - Input is NULL\n");
-        fflush(stdout);
-        return NULL;
+    if (!json_request || json_len < 0 || !out || !timings) {
+        BRIDGE_LOG(PY_LOG_ERROR, "Invalid input");
+        return -1;
+    }
+    out->data = NULL;
+    out->len = 0;
+    out->owner = NULL;
+    memset(timings, 0, sizeof(*timings));
+    if (check_interpreter(0, "Py_CallGetModelChatTemplate") != 0) {
+        return -1;
     }
-    
+
     // Acquire GIL for Python operations
+    long long start = monotonic_ns();
     PyGILState_STATE gil_state = PyGILState_Ensure();
-    
-    // Create Python string from JSON request
-    PyObject* py_json = PyUnicode_FromString(json_request);
-    if (!py_json) {
-        printf("[C] Py_CallGetModelChatTemplateInternal ERROR - Failed to create Python string\n");
-        fflush(stdout);
-        PyGILState_Release(gil_state);
-        return NULL;
-    }
-    
-    // Create arguments tuple
-    PyObject* args = PyTuple_Pack(1, py_json);
-    if (!args) {
-        printf("[C] Py_CallGetModelChatTemplateInternal ERROR - Failed to create args tuple\n");
-        fflush(stdout);
-        Py_DECREF(py_json);
-        PyGILState_Release(gil_state);
-        return NULL;
-    }
-    
-    // Call the cached function
-    PyObject* py_result = PyObject_CallObject(g_get_model_chat_template_func, args);
-    
-    // Clean up args
-    Py_DECREF(args);
-    Py_DECREF(py_json);
-    
-    char* cresult = NULL;
-    if (py_result) {
-        // Convert to C string
-        const char* s = PyUnicode_AsUTF8(py_result);
-        if (s) {
-            cresult = strdup(s);
-        } else {
-            printf("[C] Py_CallGetModelChatTemplateInternal ERROR - Failed to convert result to C string\n");
-            fflush(stdout);
-        }
-        Py_DECREF(py_result);
+    timings_lap(&timings->gil_wait_ns, &start);
+    int rc = -1;
+    ModuleState* state = module_state_acquire(0);
+    if (!state) {
+        BRIDGE_LOG(PY_LOG_ERROR, "Module not initialized");
     } else {
-        printf("[C] Py_CallGetModelChatTemplateInternal ERROR - Python function returned NULL\n");
-        fflush(stdout);
-        PyErr_Print();
-        fflush(stderr);
+        PyObject* py_result = call_cached_function(state->get_model_chat_template_func,
+                                                   "Py_CallGetModelChatTemplate", json_request, json_len, timings);
+        start = monotonic_ns();
+        if (py_result) {
+            rc = fill_result_buffer(py_result, "Py_CallGetModelChatTemplate", out);
+        }
+        timings_lap(&timings->convert_ns, &start);
+        module_state_release(state);
     }
-    
     // Release GIL
     PyGILState_Release(gil_state);
-    
-    return cresult;
+
+    return rc;
 }
 
 // Clear all caches for testing purposes
 char* Py_ClearCaches() {
-    if (!g_initialized) {
-        printf("[C] Py_ClearCaches ERROR - Module not initialized\n");
+    if (check_interpreter(0, "Py_ClearCaches") != 0) {
         return NULL;
     }
-    
+
     PyGILState_STATE gil_state = PyGILState_Ensure();
-    
-    // Call the clear_caches function
-    PyObject* clear_caches_func = PyDict_GetItemString(PyModule_GetDict(g_chat_template_module), "clear_caches");
-    if (!clear_caches_func || !PyCallable_Check(clear_caches_func)) {
-        printf("[C] Py_ClearCaches ERROR - clear_caches function not found or not callable\n");
+    ModuleState* state = module_state_acquire(0);
+    if (!state) {
+        BRIDGE_LOG(PY_LOG_ERROR, "Module not initialized");
         PyGILState_Release(gil_state);
         return NULL;
     }
-    
-    PyObject* result = PyObject_CallObject(clear_caches_func, NULL);
+
+    // Call the clear_caches function
+    PyObject* result = PyObject_CallObject(state->clear_caches_func, NULL);
+    module_state_release(state);
     if (!result) {
-        printf("[C] Py_ClearCaches ERROR - Failed to call clear_caches function\n");
-        PyErr_Print();
+        BRIDGE_LOG_PYERR(PY_LOG_ERROR, "Failed to call clear_caches function");
         PyGILState_Release(gil_state);
         return NULL;
     }
-    
+
     // Convert result to C string
     const char* result_str = PyUnicode_AsUTF8(result);
     if (!result_str) {
-        printf("[C] Py_ClearCaches ERROR - Failed to convert result to string\n");
+        BRIDGE_LOG_PYERR(PY_LOG_ERROR, "Failed to convert result to string");
         Py_DECREF(result);
         PyGILState_Release(gil_state);
         return NULL;
     }
-    
+
     char* c_result = strdup(result_str);
     Py_DECREF(result);
     PyGILState_Release(gil_state);
-    
+
     return c_result;
 }
 
 // Clean up cached objects
 void Py_CleanupChatTemplateModule() {
-    if (g_initialized && Py_IsInitialized()) {
+    pthread_mutex_lock(&g_init_mutex);
+    if (module_state_published(0) && Py_IsInitialized()) {
+        cleanup_interpreter_pool();
         PyGILState_STATE state = PyGILState_Ensure();
-        Py_XDECREF(g_render_jinja_template_func);
-        Py_XDECREF(g_get_model_chat_template_func);
-        Py_XDECREF(g_chat_template_module);
-        g_render_jinja_template_func = NULL;
-        g_get_model_chat_template_func = NULL;
-        g_chat_template_module = NULL;
-        g_initialized = 0;
+        module_state_publish(0, NULL);
         PyGILState_Release(state);
     }
-} 
+    pthread_mutex_unlock(&g_init_mutex);
+}
 
-// Re-initialize Python interpreter state
-int Py_ReinitializeGo() {    
-    // Reset global flags
-    g_initialized = 0;
-    g_python_initialized = 0;
-    g_process_initialized = 0;
-    
-    // Clean up cached objects
-    if (g_render_jinja_template_func) {
-        Py_DECREF(g_render_jinja_template_func);
-        g_render_jinja_template_func = NULL;
-    }
-    if (g_get_model_chat_template_func) {
-        Py_DECREF(g_get_model_chat_template_func);
-        g_get_model_chat_template_func = NULL;
-    }
-    if (g_chat_template_module) {
-        Py_DECREF(g_chat_template_module);
-        g_chat_template_module = NULL;
-    }
-        
-    // Re-initialize
-    int result = Py_InitializeGo();
+// Reload the wrapper module in every interpreter of the render pool
+int Py_ReinitializeGo() {
+    pthread_mutex_lock(&g_init_mutex);
+    int result = initialize_python();
     if (result != 0) {
-        printf("[C] Py_ReinitializeGo ERROR - Failed to re-initialize Python\n");
+        BRIDGE_LOG(PY_LOG_ERROR, "Failed to re-initialize Python");
+        pthread_mutex_unlock(&g_init_mutex);
         return result;
     }
-    
-    result = Py_InitChatTemplateModule();
+
+    result = init_chat_template_module(1);
     if (result != 0) {
-        printf("[C] Py_ReinitializeGo ERROR - Failed to re-initialize chat template module\n");
+        BRIDGE_LOG(PY_LOG_ERROR, "Failed to re-initialize chat template module");
+        pthread_mutex_unlock(&g_init_mutex);
         return result;
     }
-    
-    return 0;
+
+#if PY_VERSION_HEX >= 0x030C0000
+    for (int i = 1; i < atomic_load(&g_num_interpreters); i++) {
+        InterpreterGuard guard;
+        interpreter_enter(i, &guard);
+        ModuleState* state = module_state_load(1, "Py_ReinitializeGo");
+        if (state) {
+            module_state_publish(i, state);
+        } else {
+            // The interpreter keeps serving calls with its previous module.
+            BRIDGE_LOG(PY_LOG_WARNING, "Failed to reload module on interpreter %d", i);
+            result = -1;
+        }
+        interpreter_exit(&guard);
+    }
+#endif
+
+    pthread_mutex_unlock(&g_init_mutex);
+    return result;
 }
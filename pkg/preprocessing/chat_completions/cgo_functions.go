@@ -20,7 +20,14 @@ package preprocessing
 import (
 	"context"
 	"encoding/json"
+	"errors"
 	"fmt"
+	"maps"
+	"runtime"
+	"strconv"
+	"sync"
+	"sync/atomic"
+	"time"
 	"unsafe"
 
 	/*
@@ -28,11 +35,89 @@ import (
 	*/
 	"C"
 
+	"github.com/prometheus/client_golang/prometheus"
 	"k8s.io/klog/v2"
 
+	"github.com/llm-d/llm-d-kv-cache-manager/pkg/kvcache/metrics"
 	"github.com/llm-d/llm-d-kv-cache-manager/pkg/utils/logging"
 )
 
+// defaultInterpreterPoolSize is the default number of Python interpreters
+// rendering chat templates.
+const defaultInterpreterPoolSize = 1
+
+// RenderMode selects where chat templates are rendered.
+type RenderMode string
+
+const (
+	// EmbeddedRenderMode renders chat templates in Python interpreters
+	// embedded in the process through cgo.
+	EmbeddedRenderMode RenderMode = "embedded"
+	// ProcessRenderMode renders chat templates in Python worker processes,
+	// exchanging requests and responses over shared memory. The embedded
+	// interpreter is not initialized in this mode. It is only supported on
+	// amd64, see processRenderModeArch.
+	ProcessRenderMode RenderMode = "process"
+)
+
+// Config holds the configuration for the ChatTemplatingProcessor.
+type Config struct {
+	// Mode selects between embedded interpreters and worker processes.
+	Mode RenderMode `json:"mode"`
+	// InterpreterPoolSize is the number of Python interpreters rendering chat
+	// templates in parallel. Interpreters beyond the main one are
+	// sub-interpreters with their own GIL (PEP 684), which requires Python
+	// 3.12+ and extension modules that support them. The pool is shrunk to the
+	// number of interpreters that could be created.
+	// Only used in EmbeddedRenderMode.
+	InterpreterPoolSize int `json:"interpreterPoolSize"`
+	// WorkerPoolConfig configures the worker processes of ProcessRenderMode.
+	WorkerPoolConfig *WorkerPoolConfig `json:"workerPoolConfig,omitempty"`
+	// NativeTemplates enables rendering chat templates with the Go Jinja
+	// engine, falling back to Python for templates or requests it does not
+	// support.
+	NativeTemplates bool `json:"nativeTemplates"`
+	// BatchWindow is how long a Python render waits for concurrent renders
+	// to join its batch, rendered by a single Python call (see
+	// RenderChatTemplatesBatch). Zero disables batching.
+	// Only used in EmbeddedRenderMode.
+	BatchWindow time.Duration `json:"batchWindow"`
+	// MaxBatchSize is the maximum number of renders in a batch. A full batch
+	// is rendered without waiting for the rest of the window.
+	MaxBatchSize int `json:"maxBatchSize"`
+	// WireFormat selects how render requests are passed to the embedded
+	// interpreters. Only used in EmbeddedRenderMode.
+	WireFormat WireFormat `json:"wireFormat"`
+	// TemplateCacheDir is a directory persisting the chat templates fetched
+	// by FetchChatTemplate, loaded by Initialize so that a restarted
+	// processor serves them without Python. If empty, fetched templates are
+	// cached in memory only.
+	TemplateCacheDir string `json:"templateCacheDir,omitempty"`
+	// PrefixCacheSize is the number of rendered conversations memoized by
+	// RenderChatTemplate, so that a conversation extending one of them only
+	// renders its new messages. Zero disables the cache.
+	PrefixCacheSize int `json:"prefixCacheSize"`
+	// WarmUp makes Initialize render a dummy chat on every interpreter or
+	// worker process before returning, so that the first requests do not pay
+	// for importing transformers. See Ready.
+	WarmUp bool `json:"warmUp"`
+	// WarmUpModels are the models whose chat templates are fetched and
+	// compiled on every interpreter or worker process when warming up.
+	WarmUpModels []FetchChatTemplateRequest `json:"warmUpModels,omitempty"`
+}
+
+// DefaultConfig returns a default configuration for the ChatTemplatingProcessor.
+func DefaultConfig() *Config {
+	return &Config{
+		Mode:                EmbeddedRenderMode,
+		InterpreterPoolSize: defaultInterpreterPoolSize,
+		WorkerPoolConfig:    DefaultWorkerPoolConfig(),
+		NativeTemplates:     true,
+		MaxBatchSize:        defaultMaxBatchSize,
+		WireFormat:          BinaryWireFormat,
+	}
+}
+
 // ChatMessage represents a single message in a conversation.
 type ChatMessage struct {
 	Role    string `json:"role"`
@@ -51,6 +136,11 @@ type RenderJinjaTemplateRequest struct {
 	ContinueFinalMessage      bool                   `json:"continue_final_message,omitempty"`
 	AddGenerationPrompt       bool                   `json:"add_generation_prompt,omitempty"`
 	ChatTemplateKWArgs        map[string]interface{} `json:"chat_template_kwargs,omitempty"`
+	// ToolsHash and DocumentsHash optionally identify Tools and Documents by a
+	// content hash, such as the one HashPayload computes. Python then interns
+	// the parsed payloads, and repeat requests only send the hashes.
+	ToolsHash     string `json:"-"`
+	DocumentsHash string `json:"-"`
 }
 
 // RenderJinjaTemplateResponse represents the response from rendering a chat template.
@@ -78,20 +168,164 @@ type FetchChatTemplateResponse struct {
 	ChatTemplateKWArgs map[string]interface{} `json:"chat_template_kwargs,omitempty"`
 }
 
+// TokenizeOptions selects the tokenizer RenderAndTokenize encodes a rendered
+// chat with: the fast tokenizer of a Hugging Face model.
+type TokenizeOptions struct {
+	Model    string `json:"model"`
+	Revision string `json:"revision,omitempty"`
+	Token    string `json:"token,omitempty"`
+	// AddSpecialTokens adds the tokenizer's special tokens, e.g. BOS, which
+	// chat templates usually render themselves.
+	AddSpecialTokens bool `json:"add_special_tokens,omitempty"`
+}
+
+// RenderAndTokenizeResponse holds the tokens of a rendered chat: their IDs,
+// and their (start, end) byte offsets in the rendered chat, in the layout of
+// tokenizers.Offset.
+type RenderAndTokenizeResponse struct {
+	TokenIDs []uint32
+	Offsets  [][2]uint
+}
+
 // ChatTemplatingProcessor is a processor that handles chat template rendering
 // using a cached Python function. Once the Python interpreter is initialized,
 // it caches the `transformers` function `render_jinja_template` for rendering
 // chat templates. It also provides a method to fetch chat templates from the
 // tokenizer or HuggingFace if the tokenizer is not present.
-type ChatTemplatingProcessor struct{}
+//
+// Render calls are dispatched across a pool of Python interpreters, or of
+// worker processes in ProcessRenderMode, picking the one with the fewest
+// in-flight renders. Chat templates are sent to Python once, then referred to
+// by hash. With a BatchWindow, concurrent renders are coalesced into batches
+// rendered by a single Python call. With NativeTemplates, templates the Go Jinja engine
+// supports are rendered without entering Python.
+type ChatTemplatingProcessor struct {
+	config *Config
+
+	// native renders supported templates in Go, if enabled.
+	native *nativeRenderer
+
+	// templateHashes holds the hashes of the chat templates sent to Python.
+	templateHashes *templateHashes
+	// payloadHashes holds the hashes of the tools and documents sent to Python.
+	payloadHashes *payloadHashes
+
+	// fetchedTemplates caches the chat templates fetched per model revision.
+	fetchedTemplates *templateStore
+
+	// batcher coalesces concurrent Python renders, if enabled.
+	batcher *renderBatcher
+
+	// prefixes memoizes rendered conversations, if enabled.
+	prefixes *prefixCache
+
+	// workers hold the render worker processes in ProcessRenderMode.
+	workers []*workerSlot
+
+	// queueDepths holds the number of in-flight renders per interpreter.
+	queueDepths []atomic.Int64
+	queueGauges []prometheus.Gauge
+
+	// ready is set once Initialize, including its warm-up, completed.
+	ready atomic.Bool
+}
 
 // NewChatTemplatingProcessor creates a new instance of ChatTemplatingProcessor.
-func NewChatTemplatingProcessor() *ChatTemplatingProcessor {
-	return &ChatTemplatingProcessor{}
+func NewChatTemplatingProcessor(config *Config) *ChatTemplatingProcessor {
+	if config == nil {
+		config = DefaultConfig()
+	}
+	if config.Mode == "" {
+		config.Mode = EmbeddedRenderMode
+	}
+	if config.WorkerPoolConfig == nil {
+		config.WorkerPoolConfig = DefaultWorkerPoolConfig()
+	}
+	if config.MaxBatchSize == 0 {
+		config.MaxBatchSize = defaultMaxBatchSize
+	}
+	if config.WireFormat == "" {
+		config.WireFormat = BinaryWireFormat
+	}
+
+	return &ChatTemplatingProcessor{
+		config: config,
+	}
 }
 
-// Initialize initializes the Python interpreter and caches the module.
+// Initialize initializes the Python interpreter and caches the module, or
+// starts the render worker processes in ProcessRenderMode. With WarmUp, it
+// then warms up the interpreters or workers.
 func (w *ChatTemplatingProcessor) Initialize() error {
+	if err := w.initialize(); err != nil {
+		return err
+	}
+	if w.config.WarmUp {
+		if err := w.warmUp(context.Background()); err != nil {
+			return err
+		}
+	}
+	w.ready.Store(true)
+	return nil
+}
+
+// Ready reports whether Initialize completed, including its warm-up, for
+// readiness probes of processes initializing in the background.
+func (w *ChatTemplatingProcessor) Ready() bool {
+	return w.ready.Load()
+}
+
+func (w *ChatTemplatingProcessor) initialize() error {
+	if w.config.NativeTemplates {
+		native, err := newNativeRenderer()
+		if err != nil {
+			return err
+		}
+		w.native = native
+	}
+
+	templateHashes, err := newTemplateHashes()
+	if err != nil {
+		return err
+	}
+	w.templateHashes = templateHashes
+	payloadHashes, err := newPayloadHashes()
+	if err != nil {
+		return err
+	}
+	w.payloadHashes = payloadHashes
+
+	fetchedTemplates, err := newTemplateStore(w.config.TemplateCacheDir)
+	if err != nil {
+		return err
+	}
+	w.fetchedTemplates = fetchedTemplates
+
+	if w.config.PrefixCacheSize > 0 {
+		prefixes, err := newPrefixCache(w.config.PrefixCacheSize)
+		if err != nil {
+			return err
+		}
+		w.prefixes = prefixes
+	}
+
+	switch w.config.WireFormat {
+	case BinaryWireFormat, JSONWireFormat:
+	default:
+		return fmt.Errorf("unknown wire format %q", w.config.WireFormat)
+	}
+
+	switch w.config.Mode {
+	case EmbeddedRenderMode:
+	case ProcessRenderMode:
+		return w.initializeWorkers()
+	default:
+		return fmt.Errorf("unknown render mode %q", w.config.Mode)
+	}
+
+	// Route the bridge's diagnostics to klog before it logs anything.
+	C.Py_SetLogHandler(C.Py_LogHandler(C.goBridgeLog))
+
 	// Initialize Python interpreter - C handles process-level tracking
 	C.Py_InitializeGo()
 
@@ -101,11 +335,133 @@ func (w *ChatTemplatingProcessor) Initialize() error {
 		return fmt.Errorf("failed to initialize chat template module")
 	}
 
+	// Initialize the render interpreter pool - C may create fewer
+	// interpreters than requested
+	poolSize := int(C.Py_InitInterpreterPool(C.int(w.config.InterpreterPoolSize)))
+	if poolSize < 1 {
+		return fmt.Errorf("failed to initialize interpreter pool")
+	}
+
+	w.initializeQueues(poolSize)
+
+	if w.config.BatchWindow > 0 {
+		if w.config.MaxBatchSize < 1 {
+			return fmt.Errorf("maxBatchSize must be positive, got %d", w.config.MaxBatchSize)
+		}
+		w.batcher = newRenderBatcher(w.config.BatchWindow, w.config.MaxBatchSize, w.renderPythonBatch)
+	}
+	return nil
+}
+
+// processRenderModeArch is the only architecture ProcessRenderMode runs on.
+// The Python side of the shared memory rings writes frames and publishes the
+// ring positions with plain stores, which are only seen in order by the Go
+// side under x86's total store order. Weakly ordered CPUs such as arm64 could
+// read a published frame before its bytes.
+const processRenderModeArch = "amd64"
+
+// initializeWorkers starts the render worker processes.
+func (w *ChatTemplatingProcessor) initializeWorkers() error {
+	if runtime.GOARCH != processRenderModeArch {
+		return fmt.Errorf("render mode %q is only supported on %s, not %s",
+			ProcessRenderMode, processRenderModeArch, runtime.GOARCH)
+	}
+
+	config := w.config.WorkerPoolConfig
+	if config.WorkersCount < 1 {
+		return fmt.Errorf("workersCount must be positive, got %d", config.WorkersCount)
+	}
+
+	workers := make([]*workerSlot, 0, config.WorkersCount)
+	for i := 0; i < config.WorkersCount; i++ {
+		worker, err := startRenderWorker(config)
+		if err != nil {
+			for _, started := range workers {
+				started.close()
+			}
+			return fmt.Errorf("failed to start render worker %d: %w", i, err)
+		}
+		workers = append(workers, newWorkerSlot(config, worker))
+	}
+
+	w.workers = workers
+	w.initializeQueues(len(workers))
 	return nil
 }
 
-// Finalize finalizes the Python interpreter and cleans up the module.
+// initializeQueues sets up the in-flight accounting of `size` interpreters or
+// workers.
+func (w *ChatTemplatingProcessor) initializeQueues(size int) {
+	w.queueDepths = make([]atomic.Int64, size)
+	w.queueGauges = make([]prometheus.Gauge, size)
+	for i := range w.queueGauges {
+		w.queueGauges[i] = metrics.RenderQueueDepth.WithLabelValues(strconv.Itoa(i))
+	}
+}
+
+// QueueDepths returns the number of in-flight renders per interpreter, or per
+// worker process in ProcessRenderMode.
+func (w *ChatTemplatingProcessor) QueueDepths() []int64 {
+	depths := make([]int64, len(w.queueDepths))
+	for i := range w.queueDepths {
+		depths[i] = w.queueDepths[i].Load()
+	}
+	return depths
+}
+
+// WorkerPIDs returns the process ids of the render workers in
+// ProcessRenderMode.
+func (w *ChatTemplatingProcessor) WorkerPIDs() []int {
+	pids := make([]int, len(w.workers))
+	for i, slot := range w.workers {
+		pids[i] = slot.get().cmd.Process.Pid
+	}
+	return pids
+}
+
+// acquireInterpreter picks the interpreter with the fewest in-flight renders
+// and accounts the caller's render to it. In ProcessRenderMode, workers that
+// exited and are being restarted are skipped, unless all of them are.
+func (w *ChatTemplatingProcessor) acquireInterpreter() int {
+	best := -1
+	var bestDepth int64
+	for i := range w.queueDepths {
+		if w.workers != nil && !w.workers[i].alive() {
+			continue
+		}
+		if depth := w.queueDepths[i].Load(); best < 0 || depth < bestDepth {
+			best, bestDepth = i, depth
+		}
+	}
+	if best < 0 {
+		best = 0 // fails fast until a worker is restarted
+	}
+
+	w.queueDepths[best].Add(1)
+	w.queueGauges[best].Inc()
+	return best
+}
+
+// releaseInterpreter ends the accounting started by acquireInterpreter.
+func (w *ChatTemplatingProcessor) releaseInterpreter(interp int) {
+	w.queueDepths[interp].Add(-1)
+	w.queueGauges[interp].Dec()
+}
+
+// Finalize finalizes the Python interpreter and cleans up the module, or
+// stops the render worker processes in ProcessRenderMode.
 func (w *ChatTemplatingProcessor) Finalize() {
+	w.ready.Store(false)
+	if w.config.Mode == ProcessRenderMode {
+		for _, slot := range w.workers {
+			slot.close()
+		}
+		w.workers = nil
+		w.queueDepths = nil
+		w.queueGauges = nil
+		return
+	}
+
 	// Clean up the module first
 	C.Py_CleanupChatTemplateModule()
 
@@ -113,8 +469,11 @@ func (w *ChatTemplatingProcessor) Finalize() {
 	C.Py_FinalizeGo()
 }
 
-// RenderChatTemplate renders a chat template using the cached Python function.
-// It calls the Python `transformers` function `render_jinja_template` with the provided request.
+// RenderChatTemplate renders a chat template natively if enabled and supported,
+// otherwise using the cached Python function. It calls the Python
+// `transformers` function `render_jinja_template` with the provided request.
+// With a PrefixCacheSize, a conversation extending a previously rendered one
+// only renders its new messages when its template is prefix-stable.
 //
 //nolint:gocritic // hugeParam: req is passed by value intentionally for immutability, but can consider using pointer.
 func (w *ChatTemplatingProcessor) RenderChatTemplate(ctx context.Context,
@@ -125,33 +484,390 @@ func (w *ChatTemplatingProcessor) RenderChatTemplate(ctx context.Context,
 		traceLogger.Error(nil, "Received nil request")
 		return nil, fmt.Errorf("received nil request")
 	}
+	if len(w.queueDepths) == 0 {
+		return nil, fmt.Errorf("chat templating processor is not initialized")
+	}
+	if w.prefixes == nil {
+		return w.renderFull(ctx, req)
+	}
 
-	// Convert request to JSON
-	reqJSON, err := json.Marshal(req)
+	found := w.prefixes.lookup(req)
+	if found == nil {
+		return w.renderFull(ctx, req)
+	}
+	if response, ok := w.renderFromPrefix(ctx, found); ok {
+		return response, nil
+	}
+	response, err := w.renderFull(ctx, req)
+	if err == nil {
+		w.prefixes.add(found, response)
+	}
+	return response, err
+}
+
+// renderFull renders all messages of a request, natively if possible.
+func (w *ChatTemplatingProcessor) renderFull(ctx context.Context,
+	req *RenderJinjaTemplateRequest,
+) (*RenderJinjaTemplateResponse, error) {
+	if response, ok := w.renderNative(ctx, req); ok {
+		return response, nil
+	}
+	metrics.RenderedChats.WithLabelValues("python").Inc()
+
+	if w.batcher != nil {
+		return w.batcher.render(ctx, req)
+	}
+
+	response, err := w.renderOnPython(ctx, req)
+	if err != nil {
+		klog.FromContext(ctx).V(logging.TRACE).WithName("RenderChatTemplate").Error(err, "Python render failed")
+		return nil, err
+	}
+	return response, nil
+}
+
+// RenderChatTemplatesBatch renders several requests, each like
+// RenderChatTemplate. The requests the native renderer does not serve are
+// rendered by a single Python call, under one GIL acquisition; in
+// ProcessRenderMode they are pipelined through the worker processes instead.
+//
+// Requests fail independently: the response of a failed request is nil, and
+// the returned error joins the errors of all failed requests.
+func (w *ChatTemplatingProcessor) RenderChatTemplatesBatch(ctx context.Context,
+	reqs []*RenderJinjaTemplateRequest,
+) ([]*RenderJinjaTemplateResponse, error) {
+	traceLogger := klog.FromContext(ctx).V(logging.TRACE).WithName("RenderChatTemplatesBatch")
+	if len(w.queueDepths) == 0 {
+		return nil, fmt.Errorf("chat templating processor is not initialized")
+	}
+
+	responses := make([]*RenderJinjaTemplateResponse, len(reqs))
+	errs := make([]error, len(reqs))
+	var pyReqs []*RenderJinjaTemplateRequest
+	var pyIndices []int
+	for i, req := range reqs {
+		if req == nil {
+			errs[i] = fmt.Errorf("received nil request")
+			continue
+		}
+		if response, ok := w.renderNative(ctx, req); ok {
+			responses[i] = response
+			continue
+		}
+		pyReqs = append(pyReqs, req)
+		pyIndices = append(pyIndices, i)
+	}
+
+	if len(pyReqs) > 0 {
+		metrics.RenderedChats.WithLabelValues("python").Add(float64(len(pyReqs)))
+		pyResponses, pyErrs := w.renderPythonBatch(ctx, pyReqs)
+		for j, i := range pyIndices {
+			responses[i], errs[i] = pyResponses[j], pyErrs[j]
+		}
+	}
+
+	var failed []error
+	for i, err := range errs {
+		if err != nil {
+			failed = append(failed, fmt.Errorf("request %d: %w", i, err))
+		}
+	}
+	if len(failed) > 0 {
+		traceLogger.Error(errors.Join(failed...), "Batch renders failed", "failed", len(failed), "total", len(reqs))
+	}
+	return responses, errors.Join(failed...)
+}
+
+// newRenderRequest prepares a request for Python. Once a chat template has
+// been sent to Python, only its hash is, and likewise for hashed tools and
+// documents.
+func (w *ChatTemplatingProcessor) newRenderRequest(req *RenderJinjaTemplateRequest) *renderRequest {
+	pyReq := &renderRequest{RenderJinjaTemplateRequest: req, ChatTemplate: req.ChatTemplate}
+	if req.ChatTemplate != "" {
+		hash, sent := w.templateHashes.get(req.ChatTemplate)
+		pyReq.ChatTemplateHash = hash
+		if sent {
+			pyReq.ChatTemplate = ""
+		}
+	}
+	pyReq.Tools, pyReq.ToolsHash = w.payloadHashes.intern(req.Tools, req.ToolsHash)
+	pyReq.Documents, pyReq.DocumentsHash = w.payloadHashes.intern(req.Documents, req.DocumentsHash)
+	return pyReq
+}
+
+// countTemplateLookup accounts a rendered request to the template cache hits
+// if Python found its template by hash.
+func countTemplateLookup(pyReq *renderRequest) {
+	switch {
+	case pyReq.ChatTemplateHash == "":
+	case pyReq.ChatTemplate == "":
+		metrics.ChatTemplateCacheLookups.WithLabelValues("hit").Inc()
+	default:
+		metrics.ChatTemplateCacheLookups.WithLabelValues("miss").Inc()
+	}
+}
+
+// renderOnPython renders a request on the least loaded Python interpreter or
+// worker process.
+func (w *ChatTemplatingProcessor) renderOnPython(ctx context.Context,
+	req *RenderJinjaTemplateRequest,
+) (*RenderJinjaTemplateResponse, error) {
+	interp := w.acquireInterpreter()
+	defer w.releaseInterpreter(interp)
+	return w.renderOnInterpreter(ctx, interp, req)
+}
+
+// renderOnInterpreter renders a request on Python interpreter or worker
+// process `interp`.
+func (w *ChatTemplatingProcessor) renderOnInterpreter(ctx context.Context, interp int,
+	req *RenderJinjaTemplateRequest,
+) (*RenderJinjaTemplateResponse, error) {
+	pyReq := w.newRenderRequest(req)
+	response, err := w.renderPython(ctx, interp, pyReq)
+	if errors.Is(err, errTemplateNotCached) {
+		// The interpreter has not seen the template or payloads yet, or evicted them.
+		pyReq.restorePayloads()
+		response, err = w.renderPython(ctx, interp, pyReq)
+	}
+	countTemplateLookup(pyReq)
+
+	if err != nil {
+		return nil, fmt.Errorf("python render_jinja_template failed: %w", err)
+	}
+	return response, nil
+}
+
+// renderPython renders a request on Python interpreter or worker process
+// `interp`.
+func (w *ChatTemplatingProcessor) renderPython(ctx context.Context, interp int,
+	req *renderRequest,
+) (*RenderJinjaTemplateResponse, error) {
+	if w.workers != nil {
+		// Workers parse requests with json.loads, the fastest decoder
+		// available to them, and answer in the binary result layout.
+		reqJSON, err := json.Marshal(req)
+		if err != nil {
+			return nil, fmt.Errorf("failed to marshal request: %w", err)
+		}
+		payload, err := w.workers[interp].get().call(ctx, frameRender, reqJSON)
+		if err != nil {
+			return nil, err
+		}
+		return decodeWireRenderResult(payload)
+	}
+
+	reqData, err := w.encodeRenderRequest(req)
 	if err != nil {
-		traceLogger.Error(err, "Failed to marshal request")
 		return nil, fmt.Errorf("failed to marshal request: %w", err)
 	}
-	// Call the cached Python function
-	cResult := C.Py_CallRenderJinjaTemplate(C.CString(string(reqJSON)))
-	if cResult == nil {
-		traceLogger.Error(nil, "C function returned nil")
-		return nil, fmt.Errorf("python render_jinja_template failed")
+
+	// Call the cached Python function. The result is decoded after the C
+	// bridge has released the GIL.
+	var result C.Py_RenderResult
+	var timings C.Py_CallTimings
+	// reqData holds no Go pointers and is only read for the duration of the call.
+	rc := C.Py_CallRenderJinjaTemplate(C.int(interp), (*C.char)(unsafe.Pointer(&reqData[0])),
+		C.Py_ssize_t(len(reqData)), &result, &timings)
+	renderCallPhases.observe(&timings)
+	switch rc {
+	case 0:
+	case C.PY_RENDER_TEMPLATE_NOT_CACHED:
+		return nil, errTemplateNotCached
+	default:
+		return nil, fmt.Errorf("C function returned an error")
 	}
-	defer C.free(unsafe.Pointer(cResult))
-	resultJSON := C.GoString(cResult)
+	defer C.Py_ReleaseRenderResult(&result)
+
+	return decodeRenderResult(&result), nil
+}
+
+// renderPythonBatch renders requests with Python, returning the response or
+// the error of each.
+func (w *ChatTemplatingProcessor) renderPythonBatch(ctx context.Context,
+	reqs []*RenderJinjaTemplateRequest,
+) ([]*RenderJinjaTemplateResponse, []error) {
+	responses := make([]*RenderJinjaTemplateResponse, len(reqs))
+	errs := make([]error, len(reqs))
+
+	if w.workers != nil {
+		// The worker rings already queue concurrent requests.
+		var wg sync.WaitGroup
+		for i, req := range reqs {
+			wg.Add(1)
+			go func(i int, req *RenderJinjaTemplateRequest) {
+				defer wg.Done()
+				responses[i], errs[i] = w.renderOnPython(ctx, req)
+			}(i, req)
+		}
+		wg.Wait()
+		return responses, errs
+	}
+
+	interp := w.acquireInterpreter()
+	defer w.releaseInterpreter(interp)
+
+	pyReqs := make([]*renderRequest, len(reqs))
+	pending := make([]int, len(reqs))
+	for i, req := range reqs {
+		pyReqs[i] = w.newRenderRequest(req)
+		pending[i] = i
+	}
+
+	// A second round resends, with their template and payloads, the requests
+	// whose template or payloads the interpreter has not seen yet or evicted.
+	for round := 0; round < 2 && len(pending) > 0; round++ {
+		batch := make([]*renderRequest, len(pending))
+		for j, i := range pending {
+			batch[j] = pyReqs[i]
+		}
+
+		batchResponses, batchErrs, err := w.callRenderBatch(interp, batch)
+		var notCached []int
+		for j, i := range pending {
+			switch {
+			case err != nil:
+				errs[i] = err
+			case round == 0 && errors.Is(batchErrs[j], errTemplateNotCached):
+				pyReqs[i].restorePayloads()
+				notCached = append(notCached, i)
+			default:
+				responses[i], errs[i] = batchResponses[j], batchErrs[j]
+			}
+		}
+		pending = notCached
+	}
+
+	for i, pyReq := range pyReqs {
+		countTemplateLookup(pyReq)
+		if errs[i] != nil {
+			errs[i] = fmt.Errorf("python render_jinja_template failed: %w", errs[i])
+		}
+	}
+	return responses, errs
+}
+
+// callRenderBatch renders requests with a single call to Python interpreter
+// `interp`. It fails only if the batch could not be rendered at all.
+func (w *ChatTemplatingProcessor) callRenderBatch(interp int, reqs []*renderRequest,
+) ([]*RenderJinjaTemplateResponse, []error, error) {
+	reqData, err := w.encodeRenderBatch(reqs)
+	if err != nil {
+		return nil, nil, fmt.Errorf("failed to marshal requests: %w", err)
+	}
+
+	results := make([]C.Py_RenderResult, len(reqs))
+	var timings C.Py_CallTimings
+	// Neither reqData nor results hold Go pointers; the bridge only fills
+	// results with pointers to C and Python memory.
+	rc := C.Py_CallRenderJinjaTemplateBatch(C.int(interp), (*C.char)(unsafe.Pointer(&reqData[0])),
+		C.Py_ssize_t(len(reqData)), C.Py_ssize_t(len(results)), &results[0], &timings)
+	defer C.Py_ReleaseRenderResults(&results[0], C.Py_ssize_t(len(results)))
+	renderBatchCallPhases.observe(&timings)
+	if rc != 0 {
+		return nil, nil, fmt.Errorf("C function returned an error")
+	}
+
+	responses := make([]*RenderJinjaTemplateResponse, len(results))
+	errs := make([]error, len(results))
+	for i := range results {
+		result := &results[i]
+		switch result.status {
+		case 0:
+			responses[i] = decodeRenderResult(result)
+		case C.PY_RENDER_TEMPLATE_NOT_CACHED:
+			errs[i] = errTemplateNotCached
+		default:
+			if result.error_message == nil {
+				errs[i] = fmt.Errorf("C function returned an error")
+			} else {
+				errs[i] = errors.New(C.GoStringN(result.error_message, C.int(result.error_len)))
+			}
+		}
+	}
+	return responses, errs, nil
+}
+
+// RenderAndTokenize renders a request with a single conversation in Python
+// and tokenizes the rendered chat with the model's fast tokenizer in the same
+// call, returning the tokens without copying the rendered chat to Go. It is
+// only available in EmbeddedRenderMode.
+func (w *ChatTemplatingProcessor) RenderAndTokenize(ctx context.Context, req *RenderJinjaTemplateRequest,
+	opts *TokenizeOptions,
+) (*RenderAndTokenizeResponse, error) {
+	traceLogger := klog.FromContext(ctx).V(logging.TRACE).WithName("RenderAndTokenize")
+	if req == nil || opts == nil || opts.Model == "" {
+		return nil, fmt.Errorf("a request and a tokenizer model are required")
+	}
+	if len(w.queueDepths) == 0 {
+		return nil, fmt.Errorf("chat templating processor is not initialized")
+	}
+	if w.workers != nil {
+		return nil, fmt.Errorf("render and tokenize is not supported in %s render mode", w.config.Mode)
+	}
+	metrics.RenderedChats.WithLabelValues("python").Inc()
+
+	interp := w.acquireInterpreter()
+	defer w.releaseInterpreter(interp)
+
+	pyReq := w.newRenderRequest(req)
+	pyReq.Tokenize = opts
+	response, err := w.renderAndTokenize(interp, pyReq)
+	if errors.Is(err, errTemplateNotCached) {
+		// The interpreter has not seen the template or payloads yet, or evicted them.
+		pyReq.restorePayloads()
+		response, err = w.renderAndTokenize(interp, pyReq)
+	}
+	countTemplateLookup(pyReq)
+
+	if err != nil {
+		traceLogger.Error(err, "Python render and tokenize failed")
+		return nil, fmt.Errorf("python render_and_tokenize failed: %w", err)
+	}
+	return response, nil
+}
 
-	// Parse the response
-	var response RenderJinjaTemplateResponse
-	if err := json.Unmarshal([]byte(resultJSON), &response); err != nil {
-		traceLogger.Error(err, "Failed to unmarshal response")
-		return nil, fmt.Errorf("failed to unmarshal response: %w", err)
+// renderAndTokenize renders and tokenizes a request on Python interpreter
+// `interp`.
+func (w *ChatTemplatingProcessor) renderAndTokenize(interp int,
+	req *renderRequest,
+) (*RenderAndTokenizeResponse, error) {
+	reqData, err := w.encodeRenderRequest(req)
+	if err != nil {
+		return nil, fmt.Errorf("failed to marshal request: %w", err)
+	}
+
+	var result C.Py_TokenizeResult
+	var timings C.Py_CallTimings
+	// reqData holds no Go pointers and is only read for the duration of the call.
+	rc := C.Py_CallRenderAndTokenize(C.int(interp), (*C.char)(unsafe.Pointer(&reqData[0])),
+		C.Py_ssize_t(len(reqData)), &result, &timings)
+	renderTokenizeCallPhases.observe(&timings)
+	switch rc {
+	case 0:
+	case C.PY_RENDER_TEMPLATE_NOT_CACHED:
+		return nil, errTemplateNotCached
+	default:
+		return nil, fmt.Errorf("C function returned an error")
 	}
+	defer C.Py_ReleaseTokenizeResult(&result)
 
-	return &response, nil
+	numTokens := int(result.num_tokens)
+	ids := unsafe.Slice(result.token_ids, numTokens)
+	offsets := unsafe.Slice(result.offsets, 2*numTokens)
+	response := &RenderAndTokenizeResponse{
+		TokenIDs: make([]uint32, numTokens),
+		Offsets:  make([][2]uint, numTokens),
+	}
+	for i := range response.TokenIDs {
+		response.TokenIDs[i] = uint32(ids[i])
+		response.Offsets[i] = [2]uint{uint(offsets[2*i]), uint(offsets[2*i+1])}
+	}
+	return response, nil
 }
 
 // FetchChatTemplate fetches the model chat template using the cached Python function.
+// Fetched templates are cached per model revision, and persisted to the
+// TemplateCacheDir if configured.
 //
 //nolint:gocritic // hugeParam: req is passed by value intentionally for immutability, but can consider using pointer.
 func (w *ChatTemplatingProcessor) FetchChatTemplate(
@@ -159,6 +875,12 @@ func (w *ChatTemplatingProcessor) FetchChatTemplate(
 	req FetchChatTemplateRequest,
 ) (string, map[string]interface{}, error) {
 	traceLogger := klog.FromContext(ctx).V(logging.TRACE).WithName("FetchChatTemplate")
+	if w.fetchedTemplates == nil {
+		return "", nil, fmt.Errorf("chat templating processor is not initialized")
+	}
+	if template, kwargs, ok := w.fetchedTemplates.get(&req); ok {
+		return template, kwargs, nil
+	}
 
 	// Convert request to JSON
 	reqJSON, err := json.Marshal(req)
@@ -166,23 +888,172 @@ func (w *ChatTemplatingProcessor) FetchChatTemplate(
 		traceLogger.Error(err, "Failed to marshal request")
 		return "", nil, fmt.Errorf("failed to marshal request: %w", err)
 	}
-	// Call the cached Python function
-	cResult := C.Py_CallGetModelChatTemplate(C.CString(string(reqJSON)))
-	if cResult == nil {
-		traceLogger.Error(nil, "C function returned nil")
-		return "", nil, fmt.Errorf("python get_model_chat_template failed")
-	}
-	defer C.free(unsafe.Pointer(cResult))
-	resultJSON := C.GoString(cResult)
 
-	// Parse the response
 	var response FetchChatTemplateResponse
-	if err := json.Unmarshal([]byte(resultJSON), &response); err != nil {
-		traceLogger.Error(err, "Failed to unmarshal response")
-		return "", nil, fmt.Errorf("failed to unmarshal response: %w", err)
+	if w.workers != nil {
+		worker := w.acquireInterpreter()
+		defer w.releaseInterpreter(worker)
+		if err := w.callWorker(ctx, worker, frameFetch, reqJSON, &response); err != nil {
+			traceLogger.Error(err, "Render worker returned an error", "worker", worker)
+			return "", nil, fmt.Errorf("python get_model_chat_template failed: %w", err)
+		}
+		w.fetchedTemplates.put(ctx, &req, &response)
+		return response.ChatTemplate, maps.Clone(response.ChatTemplateKWArgs), nil
+	}
+
+	// Call the cached Python function and parse the response in place
+	if err := callWithResultBuffer(reqJSON, getModelChatTemplate, &response); err != nil {
+		traceLogger.Error(err, "Failed to fetch chat template")
+		return "", nil, fmt.Errorf("python get_model_chat_template failed: %w", err)
+	}
+
+	w.fetchedTemplates.put(ctx, &req, &response)
+	return response.ChatTemplate, maps.Clone(response.ChatTemplateKWArgs), nil
+}
+
+// callWorker sends a JSON request to a render worker and unmarshals its JSON
+// response.
+func (w *ChatTemplatingProcessor) callWorker(ctx context.Context, worker int, kind uint32,
+	reqJSON []byte, response interface{},
+) error {
+	result, err := w.workers[worker].get().call(ctx, kind, reqJSON)
+	if err != nil {
+		return err
+	}
+
+	if err := json.Unmarshal(result, response); err != nil {
+		return fmt.Errorf("failed to unmarshal response: %w", err)
+	}
+	return nil
+}
+
+// bridgeFunc is a C bridge entrypoint that takes a length-prefixed JSON
+// request and fills a result buffer pinned by the Python interpreter.
+type bridgeFunc func(req *C.char, reqLen C.Py_ssize_t, out *C.Py_ResultBuffer) C.int
+
+func getModelChatTemplate(req *C.char, reqLen C.Py_ssize_t, out *C.Py_ResultBuffer) C.int {
+	var timings C.Py_CallTimings
+	rc := C.Py_CallGetModelChatTemplate(req, reqLen, out, &timings)
+	fetchCallPhases.observe(&timings)
+	return rc
+}
+
+// pythonCallPhases observes the phase timings of the calls to a C bridge
+// entrypoint (see Py_CallTimings).
+type pythonCallPhases struct {
+	gilWait, args, call, convert prometheus.Observer
+}
+
+var (
+	renderCallPhases         = newPythonCallPhases("render_jinja_template")
+	renderBatchCallPhases    = newPythonCallPhases("render_jinja_template_batch")
+	renderTokenizeCallPhases = newPythonCallPhases("render_and_tokenize")
+	fetchCallPhases          = newPythonCallPhases("get_model_chat_template")
+)
+
+func newPythonCallPhases(function string) *pythonCallPhases {
+	return &pythonCallPhases{
+		gilWait: metrics.PythonCallPhaseLatency.WithLabelValues(function, "gil_wait"),
+		args:    metrics.PythonCallPhaseLatency.WithLabelValues(function, "args"),
+		call:    metrics.PythonCallPhaseLatency.WithLabelValues(function, "call"),
+		convert: metrics.PythonCallPhaseLatency.WithLabelValues(function, "convert"),
+	}
+}
+
+// observe records the timings of a call, skipping the phases it did not reach.
+func (p *pythonCallPhases) observe(timings *C.Py_CallTimings) {
+	for _, phase := range []struct {
+		observer prometheus.Observer
+		nanos    C.longlong
+	}{
+		{p.gilWait, timings.gil_wait_ns},
+		{p.args, timings.args_ns},
+		{p.call, timings.call_ns},
+		{p.convert, timings.convert_ns},
+	} {
+		if phase.nanos > 0 {
+			phase.observer.Observe(time.Duration(phase.nanos).Seconds())
+		}
+	}
+}
+
+// callWithResultBuffer passes reqJSON to the C bridge without copying it into
+// a C string, then unmarshals the result straight out of the buffer owned by
+// the Python result object. The only copy of the rendered bytes is the one
+// json.Unmarshal makes into the Go response.
+func callWithResultBuffer(reqJSON []byte, fn bridgeFunc, response interface{}) error {
+	if len(reqJSON) == 0 {
+		return fmt.Errorf("empty request")
 	}
 
-	return response.ChatTemplate, response.ChatTemplateKWArgs, nil
+	var buf C.Py_ResultBuffer
+	// reqJSON holds no Go pointers and is only read for the duration of the call.
+	if fn((*C.char)(unsafe.Pointer(&reqJSON[0])), C.Py_ssize_t(len(reqJSON)), &buf) != 0 {
+		return fmt.Errorf("C function returned an error")
+	}
+	defer C.Py_ReleaseResultBuffer(&buf)
+
+	result := unsafe.Slice((*byte)(unsafe.Pointer(buf.data)), int(buf.len))
+	if err := json.Unmarshal(result, response); err != nil {
+		return fmt.Errorf("failed to unmarshal response: %w", err)
+	}
+
+	return nil
+}
+
+// decodeRenderResult copies a pinned render result into a Go response.
+// Each rendered chat is copied exactly once, and the generation indices of
+// all chats are built from two allocations (see generationIndices).
+func decodeRenderResult(result *C.Py_RenderResult) *RenderJinjaTemplateResponse {
+	numChats := int(result.num_chats)
+	chats := unsafe.Slice(result.chats, numChats)
+	chatLens := unsafe.Slice(result.chat_lens, numChats)
+	cSpanCounts := unsafe.Slice(result.span_counts, numChats)
+
+	spanCounts := make([]int, numChats)
+	totalSpans := 0
+	for i := range cSpanCounts {
+		spanCounts[i] = int(cSpanCounts[i])
+		totalSpans += spanCounts[i]
+	}
+	spans := unsafe.Slice(result.spans, 2*totalSpans)
+
+	flat := make([]int, len(spans))
+	for i := range spans {
+		flat[i] = int(spans[i])
+	}
+
+	renderedChats := make([]string, numChats)
+	for i := range renderedChats {
+		renderedChats[i] = C.GoStringN(chats[i], C.int(chatLens[i]))
+	}
+
+	return &RenderJinjaTemplateResponse{
+		RenderedChats:     renderedChats,
+		GenerationIndices: generationIndices(spanCounts, flat),
+	}
+}
+
+// encodeRenderRequest encodes a request for the embedded interpreters in the
+// configured wire format.
+func (w *ChatTemplatingProcessor) encodeRenderRequest(req *renderRequest) ([]byte, error) {
+	if w.config.WireFormat == BinaryWireFormat {
+		if data, err := encodeWireRequest(req); err == nil {
+			return data, nil
+		}
+		// Requests the binary format cannot represent like JSON are sent as JSON.
+	}
+	return json.Marshal(req)
+}
+
+// encodeRenderBatch encodes a batch like encodeRenderRequest does a request.
+func (w *ChatTemplatingProcessor) encodeRenderBatch(reqs []*renderRequest) ([]byte, error) {
+	if w.config.WireFormat == BinaryWireFormat {
+		if data, err := encodeWireBatch(reqs); err == nil {
+			return data, nil
+		}
+	}
+	return json.Marshal(reqs)
 }
 
 // ClearCaches clears all caches for testing purposes.
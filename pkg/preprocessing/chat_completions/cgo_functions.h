@@ -44,27 +44,175 @@ PyObject* Go_PyDict_GetItemString(PyObject* dict, const char* key);
 // Helper function to convert Python string to Go string
 const char* PyUnicode_AsGoString(PyObject* obj);
 
-// === NEW CACHING FUNCTIONS FOR OPTIMIZATION ===
+// === LOGGING ===
+
+// Levels of the bridge's diagnostics
+#define PY_LOG_ERROR 0
+#define PY_LOG_WARNING 1
+#define PY_LOG_INFO 2
+#define PY_LOG_DEBUG 3
+
+// Maximum number of messages logged per second from one call site of the
+// bridge, counted per entry point in helpers shared by several. Further
+// messages are dropped and their count is appended to the next message
+// logged from the site, so error storms cost no I/O.
+#define PY_LOG_SITE_RATE 10
+
+// Py_LogHandler receives the bridge's diagnostics: a PY_LOG_* level, the
+// function logging it, and the message, including the Python exception that
+// caused it if any. Both strings are only valid for the duration of the call,
+// which may hold an interpreter's GIL.
+typedef void (*Py_LogHandler)(int level, char* site, char* message);
+
+// Route the bridge's diagnostics to `handler`, or to stderr if NULL (the default)
+void Py_SetLogHandler(Py_LogHandler handler);
+
+// The Go log handler, routing to klog (exported by bridge_log.go)
+extern void goBridgeLog(int level, char* site, char* message);
+
+// === RESULT BUFFERS ===
+
+// Py_ResultBuffer is a borrowed, length-prefixed view over the UTF-8 bytes of
+// a Python result string. The bytes are owned by the pinned `owner` object and
+// stay valid until Py_ReleaseResultBuffer is called, so Go can read them in
+// place without an intermediate strdup/C.GoString copy.
+typedef struct {
+    const char* data;
+    Py_ssize_t len;
+    PyObject* owner;
+} Py_ResultBuffer;
+
+// Release the Python object pinned by a result buffer and reset the buffer
+void Py_ReleaseResultBuffer(Py_ResultBuffer* buf);
+
+// Py_RenderResult exposes the (rendered_chats, generation_indices) tuple of a
+// render call without encoding it to JSON. The chat pointers borrow the UTF-8
+// bytes of the pinned `owner` tuple, and the generation indices are flattened
+// into (start, end) pairs, `span_counts[i]` of them for chat i. Everything is
+// extracted while holding the GIL, so Go can decode the result after it has
+// been released.
+//
+// Results of a batch call also carry the `status` of their request: 0,
+// PY_RENDER_TEMPLATE_NOT_CACHED, or -1 with the Python error message borrowed
+// from `owner` in `error_message` when it could be converted.
+typedef struct {
+    Py_ssize_t num_chats;
+    const char** chats;
+    Py_ssize_t* chat_lens;
+    Py_ssize_t* span_counts;
+    long long* spans;
+    PyObject* owner;
+    int interp;
+    int status;
+    const char* error_message;
+    Py_ssize_t error_len;
+} Py_RenderResult;
+
+// Release the Python object pinned by a render result and free its arrays
+void Py_ReleaseRenderResult(Py_RenderResult* result);
+
+// Release the `count` render results of a batch call, entering their
+// interpreter once
+void Py_ReleaseRenderResults(Py_RenderResult* results, Py_ssize_t count);
+
+// Py_TokenizeResult holds the tokens of a rendered chat: `num_tokens` token
+// IDs, and the (start, end) byte offsets of each token in the UTF-8 rendered
+// chat, flattened into pairs. Both arrays are plain C memory.
+typedef struct {
+    Py_ssize_t num_tokens;
+    unsigned int* token_ids;
+    Py_ssize_t* offsets;
+} Py_TokenizeResult;
+
+// Free the arrays of a tokenize result and reset it. Does not need the GIL.
+void Py_ReleaseTokenizeResult(Py_TokenizeResult* result);
+
+// Py_CallTimings breaks the duration of a call down by phase, in nanoseconds
+// of CLOCK_MONOTONIC: waiting for the interpreter's GIL, building the Python
+// argument from the request, the Python function call, and converting its
+// result for Go. Phases a failed call did not reach are 0.
+typedef struct {
+    long long gil_wait_ns;
+    long long args_ns;
+    long long call_ns;
+    long long convert_ns;
+} Py_CallTimings;
 
-// Global variables to hold cached module and functions
-extern PyObject* g_chat_template_module;
-extern PyObject* g_render_jinja_template_func;
-extern PyObject* g_get_model_chat_template_func;
+// === NEW CACHING FUNCTIONS FOR OPTIMIZATION ===
 
 // Initialize the cached module and functions (call once at startup)
 int Py_InitChatTemplateModule();
 
-// Call the cached render_jinja_template function
-char* Py_CallRenderJinjaTemplate(const char* json_request);
-
-// Internal function that does the actual work
-char* Py_CallRenderJinjaTemplateInternal(const char* json_request);
-
-// Call the cached get_model_chat_template function
-char* Py_CallGetModelChatTemplate(const char* json_request);
-
-// Internal function that does the actual work
-char* Py_CallGetModelChatTemplateInternal(const char* json_request);
+// === INTERPRETER POOL ===
+
+// Maximum number of interpreters in the render pool
+#define PY_MAX_INTERPRETERS 64
+
+// Create sub-interpreters with their own GIL (PEP 684, Python 3.12+) until the
+// render pool holds `size` interpreters, the main interpreter included. Each
+// sub-interpreter imports its own render_jinja_template_wrapper module.
+// Interpreters that fail to import the wrapper's dependencies are discarded.
+// Returns the resulting pool size (at least 1) or -1 on error.
+int Py_InitInterpreterPool(int size);
+
+// Number of interpreters in the render pool
+int Py_InterpreterPoolSize(void);
+
+// Returned by Py_CallRenderJinjaTemplate when the request refers to its chat
+// template by hash and the interpreter does not hold it; the caller resends
+// the request with the template.
+#define PY_RENDER_TEMPLATE_NOT_CACHED 1
+
+// Binary wire format of render requests, mirrored by wire_format.go. A request
+// starting with PY_WIRE_MAGIC holds one tagged value in native byte order,
+// decoded straight into the Python objects json.loads would build; any other
+// request is JSON.
+#define PY_WIRE_MAGIC 0xB1
+#define PY_WIRE_MAX_DEPTH 64
+#define PY_WIRE_NONE 0
+#define PY_WIRE_FALSE 1
+#define PY_WIRE_TRUE 2
+#define PY_WIRE_INT 3
+#define PY_WIRE_FLOAT 4
+#define PY_WIRE_STR 5
+#define PY_WIRE_LIST 6
+#define PY_WIRE_DICT 7
+
+// Call the cached render_jinja_template function on interpreter `interp`
+// (0 is the main interpreter, see Py_InitInterpreterPool).
+// The request, JSON or in the binary wire format, is read as `json_len` bytes
+// (no NUL terminator required) and the result is returned through `out`, which
+// must be released with Py_ReleaseRenderResult, and the call's timings through
+// `timings`. Returns 0 on success, PY_RENDER_TEMPLATE_NOT_CACHED or -1 on failure.
+int Py_CallRenderJinjaTemplate(int interp, const char* json_request, Py_ssize_t json_len, Py_RenderResult* out,
+                               Py_CallTimings* timings);
+
+// Call the cached render_jinja_template_batch function on interpreter `interp`.
+// The request is an array of `count` render requests, JSON or in the binary
+// wire format, rendered under a single GIL acquisition. The result of request i
+// is returned through `out[i]` with its status; all `count` results must be
+// released with Py_ReleaseRenderResults, whatever the return value. The timings
+// of the whole batch are returned through `timings`. Returns 0 if the batch
+// was rendered, even if some of its requests failed, -1 on failure.
+int Py_CallRenderJinjaTemplateBatch(int interp, const char* json_request, Py_ssize_t json_len,
+                                    Py_ssize_t count, Py_RenderResult* out, Py_CallTimings* timings);
+
+// Call the cached render_and_tokenize function on interpreter `interp`: render
+// the chat template of a request, like Py_CallRenderJinjaTemplate, and encode
+// the rendered chat with the fast tokenizer of the model named in its
+// `tokenize` entry, in a single call. The rendered chat stays in Python.
+// The tokens are returned through `out`, which must be released with
+// Py_ReleaseTokenizeResult, and the call's timings through `timings`. Returns 0
+// on success, PY_RENDER_TEMPLATE_NOT_CACHED or -1 on failure.
+int Py_CallRenderAndTokenize(int interp, const char* request, Py_ssize_t request_len, Py_TokenizeResult* out,
+                             Py_CallTimings* timings);
+
+// Call the cached get_model_chat_template function.
+// The result is returned through `out`, which must be released with
+// Py_ReleaseResultBuffer, and the call's timings through `timings`. Returns 0
+// on success, -1 on failure.
+int Py_CallGetModelChatTemplate(const char* json_request, Py_ssize_t json_len, Py_ResultBuffer* out,
+                                Py_CallTimings* timings);
 
 // Clear all caches for testing purposes
 char* Py_ClearCaches(void);
@@ -72,7 +220,12 @@ char* Py_ClearCaches(void);
 // Clean up cached objects
 void Py_CleanupChatTemplateModule();
 
-// Re-initialize Python interpreter state
+// Reload the wrapper module in every interpreter of the render pool, e.g. to
+// pick up a new version of it, initializing Python if needed. Each
+// interpreter's new module state is published atomically: calls in flight
+// finish with the functions they started with, later calls use the reloaded
+// ones, and interpreters that fail to reload keep their previous module.
+// Returns 0 on success, -1 if any interpreter failed to reload.
 int Py_ReinitializeGo();
 
 #endif // CGO_FUNCTIONS_H 
\ No newline at end of file
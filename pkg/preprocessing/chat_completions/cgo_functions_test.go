@@ -21,10 +21,13 @@ import (
 	"flag"
 	"fmt"
 	"os"
+	"path/filepath"
 	"strings"
 	"sync"
+	"syscall"
 	"testing"
 	"time"
+	"unicode/utf8"
 
 	preprocessing "github.com/llm-d/llm-d-kv-cache-manager/pkg/preprocessing/chat_completions"
 	"github.com/stretchr/testify/assert"
@@ -42,7 +45,9 @@ var (
 // getGlobalWrapper returns a singleton wrapper instance.
 func getGlobalWrapper() *preprocessing.ChatTemplatingProcessor {
 	globalWrapperOnce.Do(func() {
-		globalWrapper = preprocessing.NewChatTemplatingProcessor()
+		globalWrapper = preprocessing.NewChatTemplatingProcessor(&preprocessing.Config{
+			InterpreterPoolSize: 4,
+		})
 		err := globalWrapper.Initialize()
 		if err != nil {
 			panic(fmt.Sprintf("Failed to initialize global wrapper: %v", err))
@@ -206,9 +211,435 @@ func TestRenderJinjaTemplate(t *testing.T) {
 	}
 }
 
+// TestRenderLargePrompt tests that large rendered prompts survive the result buffer round-trip intact.
+func TestRenderLargePrompt(t *testing.T) {
+	wrapper := getGlobalWrapper()
+
+	// Multi-byte characters make sure lengths are handled in bytes, not runes.
+	content := strings.Repeat("Großer Kontext → ", 16*1024)
+	request := &preprocessing.RenderJinjaTemplateRequest{
+		Conversations: []preprocessing.ChatMessage{
+			{Role: "user", Content: content},
+		},
+		ChatTemplate: `{% for message in messages %}{{ message.role }}: {{ message.content }}
+{% endfor %}`,
+	}
+
+	response, err := wrapper.RenderChatTemplate(context.Background(), request)
+	require.NoError(t, err, "RenderChatTemplate should not return an error")
+	require.Len(t, response.RenderedChats, 1, "Should have one rendered chat")
+	assert.Equal(t, "user: "+content+"\n", response.RenderedChats[0], "Rendered prompt should be intact")
+}
+
+// TestRenderConcurrent tests that concurrent renders, dispatched across the
+// interpreter pool, return the result of their own request.
+func TestRenderConcurrent(t *testing.T) {
+	wrapper := getGlobalWrapper()
+
+	const goroutines = 16
+	var wg sync.WaitGroup
+	for i := 0; i < goroutines; i++ {
+		wg.Add(1)
+		go func(i int) {
+			defer wg.Done()
+			content := fmt.Sprintf("request %d", i)
+			request := &preprocessing.RenderJinjaTemplateRequest{
+				Conversations: []preprocessing.ChatMessage{
+					{Role: "user", Content: content},
+				},
+				ChatTemplate: `{% for message in messages %}{{ message.content }}{% endfor %}`,
+			}
+
+			for j := 0; j < 10; j++ {
+				response, err := wrapper.RenderChatTemplate(context.Background(), request)
+				if !assert.NoError(t, err, "RenderChatTemplate should not return an error") {
+					return
+				}
+				assert.Equal(t, []string{content}, response.RenderedChats, "Should render its own request")
+			}
+		}(i)
+	}
+	wg.Wait()
+
+	depths := wrapper.QueueDepths()
+	require.NotEmpty(t, depths, "Pool should have at least one interpreter")
+	for i, depth := range depths {
+		assert.Zero(t, depth, "Interpreter %d should have no renders in flight", i)
+	}
+}
+
+// TestRenderTemplateCache tests that renders referring to their chat template
+// by hash render like the first one, including after the Python side dropped
+// the template.
+func TestRenderTemplateCache(t *testing.T) {
+	wrapper := getGlobalWrapper()
+	ctx := context.Background()
+
+	request := &preprocessing.RenderJinjaTemplateRequest{
+		Conversations: []preprocessing.ChatMessage{
+			{Role: "user", Content: "Hello"},
+		},
+		ChatTemplate: `{% for message in messages %}<{{ message.role }}>{{ message.content }}{% endfor %}`,
+	}
+
+	expected := []string{"<user>Hello"}
+	for i := 0; i < 8; i++ {
+		response, err := wrapper.RenderChatTemplate(ctx, request)
+		require.NoError(t, err, "Render %d should not return an error", i)
+		assert.Equal(t, expected, response.RenderedChats, "Render %d should use the cached template", i)
+	}
+
+	require.NoError(t, preprocessing.ClearCaches(ctx), "Failed to clear caches")
+	response, err := wrapper.RenderChatTemplate(ctx, request)
+	require.NoError(t, err, "Render after clearing caches should resend the template")
+	assert.Equal(t, expected, response.RenderedChats)
+}
+
+// TestRenderPayloadInterning tests that requests sending their tools and
+// documents by hash render like requests sending them, including after the
+// Python side dropped them.
+func TestRenderPayloadInterning(t *testing.T) {
+	wrapper := getGlobalWrapper()
+	ctx := context.Background()
+
+	tools := []interface{}{map[string]interface{}{"name": "get_weather", "parameters": map[string]interface{}{}}}
+	documents := []interface{}{map[string]interface{}{"title": "Größe", "text": "☃"}}
+	toolsHash, err := preprocessing.HashPayload(tools)
+	require.NoError(t, err)
+	documentsHash, err := preprocessing.HashPayload(documents)
+	require.NoError(t, err)
+
+	request := &preprocessing.RenderJinjaTemplateRequest{
+		Conversations: []preprocessing.ChatMessage{{Role: "user", Content: "Hello"}},
+		Tools:         tools,
+		Documents:     documents,
+		ChatTemplate:  `{{ tools | tojson }}|{{ documents | tojson }}|{{ messages[0].content }}`,
+	}
+	expected, err := wrapper.RenderChatTemplate(ctx, request)
+	require.NoError(t, err)
+
+	hashed := *request
+	hashed.ToolsHash, hashed.DocumentsHash = toolsHash, documentsHash
+	for i := 0; i < 8; i++ {
+		response, err := wrapper.RenderChatTemplate(ctx, &hashed)
+		require.NoError(t, err, "Render %d should not return an error", i)
+		assert.Equal(t, expected.RenderedChats, response.RenderedChats, "Render %d should use the interned payloads", i)
+	}
+
+	require.NoError(t, preprocessing.ClearCaches(ctx), "Failed to clear caches")
+	response, err := wrapper.RenderChatTemplate(ctx, &hashed)
+	require.NoError(t, err, "Render after clearing caches should resend the payloads")
+	assert.Equal(t, expected.RenderedChats, response.RenderedChats)
+}
+
+// TestRenderChatTemplatesBatch tests that a batch renders each request like
+// RenderChatTemplate, with failures confined to their request.
+func TestRenderChatTemplatesBatch(t *testing.T) {
+	wrapper := getGlobalWrapper()
+	ctx := context.Background()
+
+	template := `{% for message in messages %}{{ message.role }}: {{ message.content }}
+{% endfor %}`
+	reqs := make([]*preprocessing.RenderJinjaTemplateRequest, 0, 8)
+	for i := 0; i < 6; i++ {
+		reqs = append(reqs, &preprocessing.RenderJinjaTemplateRequest{
+			Conversations: []preprocessing.ChatMessage{{Role: "user", Content: fmt.Sprintf("Größe %d", i)}},
+			ChatTemplate:  template,
+		})
+	}
+	reqs = append(reqs, &preprocessing.RenderJinjaTemplateRequest{
+		Conversations: []preprocessing.ChatMessage{{Role: "user", Content: "Hi"}},
+		ChatTemplate:  "{{ undefined_filter | nonexistent }}",
+	}, nil)
+
+	// Clearing the caches makes the batch resend the template it refers to by hash.
+	for _, clear := range []bool{false, true} {
+		if clear {
+			require.NoError(t, preprocessing.ClearCaches(ctx), "Failed to clear caches")
+		}
+
+		responses, err := wrapper.RenderChatTemplatesBatch(ctx, reqs)
+		require.Error(t, err, "Failed requests should be reported")
+		require.Len(t, responses, len(reqs))
+		for i, req := range reqs[:6] {
+			expected, err := wrapper.RenderChatTemplate(ctx, req)
+			require.NoError(t, err)
+			require.NotNil(t, responses[i], "Request %d should be rendered", i)
+			assert.Equal(t, expected.RenderedChats, responses[i].RenderedChats, "Request %d should render alone", i)
+		}
+		assert.Nil(t, responses[6], "Template errors should fail their request")
+		assert.Nil(t, responses[7], "Nil requests should fail")
+	}
+}
+
+// TestRenderBatchWindow tests that concurrent renders coalesced into batches
+// return the result of their own request.
+func TestRenderBatchWindow(t *testing.T) {
+	getGlobalWrapper() // the interpreters are shared by all processors
+	processor := preprocessing.NewChatTemplatingProcessor(&preprocessing.Config{
+		InterpreterPoolSize: 4,
+		BatchWindow:         2 * time.Millisecond,
+		MaxBatchSize:        4,
+	})
+	require.NoError(t, processor.Initialize())
+
+	var wg sync.WaitGroup
+	for i := 0; i < 16; i++ {
+		wg.Add(1)
+		go func(i int) {
+			defer wg.Done()
+			content := fmt.Sprintf("request %d", i)
+			request := &preprocessing.RenderJinjaTemplateRequest{
+				Conversations: []preprocessing.ChatMessage{{Role: "user", Content: content}},
+				ChatTemplate:  `{% for message in messages %}{{ message.content }}{% endfor %}`,
+			}
+			for j := 0; j < 10; j++ {
+				response, err := processor.RenderChatTemplate(context.Background(), request)
+				if !assert.NoError(t, err, "RenderChatTemplate should not return an error") {
+					return
+				}
+				assert.Equal(t, []string{content}, response.RenderedChats, "Should render its own request")
+			}
+		}(i)
+	}
+	wg.Wait()
+}
+
+// TestRenderWireFormats tests that requests render the same in the binary
+// wire format as in JSON.
+func TestRenderWireFormats(t *testing.T) {
+	getGlobalWrapper() // the interpreters are shared by all processors
+	request := &preprocessing.RenderJinjaTemplateRequest{
+		Conversations: []preprocessing.ChatMessage{{Role: "user", Content: "héllo \u2603"}},
+		Tools: []interface{}{map[string]interface{}{
+			"name":       "get_weather",
+			"parameters": map[string]interface{}{"type": "object", "required": []string{"city"}},
+		}},
+		ChatTemplate: `{{ messages | tojson }}|{{ tools | tojson }}|{{ count }}|{{ ratio }}|{{ flag }}|{{ none }}` +
+			`{% if add_generation_prompt %}|prompt{% endif %}`,
+		AddGenerationPrompt: true,
+		ChatTemplateKWArgs: map[string]interface{}{
+			"count": 3.0, "ratio": 0.25, "flag": false, "none": nil,
+		},
+	}
+
+	var rendered []string
+	for _, format := range []preprocessing.WireFormat{preprocessing.JSONWireFormat, preprocessing.BinaryWireFormat} {
+		processor := preprocessing.NewChatTemplatingProcessor(&preprocessing.Config{WireFormat: format})
+		require.NoError(t, processor.Initialize())
+		response, err := processor.RenderChatTemplate(context.Background(), request)
+		require.NoError(t, err, "RenderChatTemplate should not return an error")
+		rendered = append(rendered, response.RenderedChats...)
+	}
+	require.Len(t, rendered, 2)
+	assert.Equal(t, rendered[0], rendered[1], "Both wire formats should render the same")
+	assert.Contains(t, rendered[1], "|3|0.25|False|None|prompt")
+}
+
+// TestWarmUp tests that a processor warming up is only ready once
+// initialized, and renders like one that does not.
+func TestWarmUp(t *testing.T) {
+	getGlobalWrapper() // the interpreters are shared by all processors
+	processor := preprocessing.NewChatTemplatingProcessor(&preprocessing.Config{WarmUp: true, NativeTemplates: true})
+	assert.False(t, processor.Ready(), "Processor should not be ready before Initialize")
+	require.NoError(t, processor.Initialize())
+	assert.True(t, processor.Ready(), "Processor should be ready after warming up")
+
+	request := &preprocessing.RenderJinjaTemplateRequest{
+		Conversations: []preprocessing.ChatMessage{{Role: "user", Content: "Hello"}},
+		ChatTemplate:  `{% for message in messages %}<{{ message.role }}>{{ message.content }}{% endfor %}`,
+	}
+	response, err := processor.RenderChatTemplate(context.Background(), request)
+	require.NoError(t, err)
+	assert.Equal(t, []string{"<user>Hello"}, response.RenderedChats)
+}
+
+// TestRenderPrefixCache tests that growing conversations rendered from
+// their cached prefixes render like full renders, for prefix-stable templates
+// and for templates that are not.
+func TestRenderPrefixCache(t *testing.T) {
+	getGlobalWrapper() // the interpreters are shared by all processors
+	templates := map[string]string{
+		"stable": `{{ bos_token }}{% if messages[0].role != 'system' %}<|system|>You are helpful.</s>{% endif %}` +
+			`{% for message in messages %}{% if (message.role == 'user') != (loop.index0 % 2 == 1) %}` +
+			`{{ raise_exception('Roles must alternate') }}{% endif %}` +
+			`<|{{ message.role }}|>{{ message.content }}</s>{% endfor %}{% if add_generation_prompt %}<|assistant|>{% endif %}`,
+		"counting": `{{ messages | length }} messages:{% for message in messages %}{{ message.content }}|{% endfor %}`,
+		"last":     `{% for message in messages %}{% if loop.last %}[last]{% endif %}{{ message.content }}{% endfor %}`,
+	}
+
+	for name, template := range templates {
+		t.Run(name, func(t *testing.T) {
+			full := preprocessing.NewChatTemplatingProcessor(nil)
+			require.NoError(t, full.Initialize())
+			config := preprocessing.DefaultConfig()
+			config.PrefixCacheSize = 64
+			memoized := preprocessing.NewChatTemplatingProcessor(config)
+			require.NoError(t, memoized.Initialize())
+
+			messages := []preprocessing.ChatMessage{{Role: "system", Content: "Be brief."}}
+			for turn := 0; turn < 8; turn++ {
+				messages = append(messages, preprocessing.ChatMessage{Role: "user", Content: fmt.Sprintf("question %d", turn)})
+				request := &preprocessing.RenderJinjaTemplateRequest{
+					Conversations:       messages,
+					ChatTemplate:        template,
+					AddGenerationPrompt: true,
+					ChatTemplateKWArgs:  map[string]interface{}{"bos_token": "<s>"},
+				}
+				expected, err := full.RenderChatTemplate(context.Background(), request)
+				require.NoError(t, err)
+				for i := 0; i < 2; i++ {
+					response, err := memoized.RenderChatTemplate(context.Background(), request)
+					require.NoError(t, err)
+					assert.Equal(t, expected.RenderedChats, response.RenderedChats, "Turn %d should render in full", turn)
+				}
+				messages = append(messages, preprocessing.ChatMessage{Role: "assistant", Content: fmt.Sprintf("answer %d", turn)})
+			}
+		})
+	}
+}
+
+// TestProcessRenderMode tests that worker processes render the same output as
+// the embedded interpreter.
+func TestProcessRenderMode(t *testing.T) {
+	config := preprocessing.DefaultConfig()
+	config.Mode = preprocessing.ProcessRenderMode
+	config.WorkerPoolConfig.WorkersCount = 2
+	config.NativeTemplates = false
+	processor := preprocessing.NewChatTemplatingProcessor(config)
+	require.NoError(t, processor.Initialize(), "Worker processes should start")
+	defer processor.Finalize()
+
+	ctx := context.Background()
+	request := &preprocessing.RenderJinjaTemplateRequest{
+		Conversations: []preprocessing.ChatMessage{
+			{Role: "user", Content: "Größe?"},
+			{Role: "assistant", Content: "42"},
+		},
+		ChatTemplate: `{% for message in messages %}{{ message.role }}: {{ message.content }}
+{% endfor %}`,
+	}
+
+	expected, err := getGlobalWrapper().RenderChatTemplate(ctx, request)
+	require.NoError(t, err, "Embedded render should not return an error")
+	response, err := processor.RenderChatTemplate(ctx, request)
+	require.NoError(t, err, "Worker render should not return an error")
+	assert.Equal(t, expected.RenderedChats, response.RenderedChats, "Worker should render like the embedded interpreter")
+	for i := 0; i < 4; i++ {
+		response, err = processor.RenderChatTemplate(ctx, request)
+		require.NoError(t, err, "Worker render by template hash should not return an error")
+		assert.Equal(t, expected.RenderedChats, response.RenderedChats, "Worker should render the cached template")
+	}
+
+	// A worker that dies is skipped until it is restarted.
+	pids := processor.WorkerPIDs()
+	require.Len(t, pids, 2)
+	require.NoError(t, syscall.Kill(pids[0], syscall.SIGKILL))
+	time.Sleep(100 * time.Millisecond) // for the exit to be noticed
+	for i := 0; i < 4; i++ {
+		response, err = processor.RenderChatTemplate(ctx, request)
+		require.NoError(t, err, "Renders should not be sent to the killed worker")
+		assert.Equal(t, expected.RenderedChats, response.RenderedChats)
+	}
+	require.Eventually(t, func() bool { return processor.WorkerPIDs()[0] != pids[0] }, time.Minute, 100*time.Millisecond,
+		"Killed worker should be restarted")
+	for i := 0; i < 4; i++ {
+		response, err = processor.RenderChatTemplate(ctx, request)
+		require.NoError(t, err, "Renders should succeed after the restart")
+		assert.Equal(t, expected.RenderedChats, response.RenderedChats)
+	}
+
+	template, _, err := processor.FetchChatTemplate(ctx, preprocessing.FetchChatTemplateRequest{
+		Model: "ibm-granite/granite-3.3-8b-instruct",
+	})
+	require.NoError(t, err, "Worker fetch should not return an error")
+	assert.NotEmpty(t, template, "Worker should fetch the chat template")
+
+	request.ChatTemplate = "{{ undefined_filter | nonexistent }}"
+	_, err = processor.RenderChatTemplate(ctx, request)
+	assert.Error(t, err, "Template errors should be returned by the worker")
+	assert.Len(t, processor.QueueDepths(), 2, "Should track both workers")
+}
+
+// TestProcessRenderModeStartTimeout tests that a worker that never becomes
+// ready fails Initialize instead of blocking it.
+func TestProcessRenderModeStartTimeout(t *testing.T) {
+	executable := filepath.Join(t.TempDir(), "hanging-python")
+	require.NoError(t, os.WriteFile(executable, []byte("#!/bin/sh\nexec sleep 60\n"), 0o700)) //nolint:gosec // test script
+
+	config := preprocessing.DefaultConfig()
+	config.Mode = preprocessing.ProcessRenderMode
+	config.WorkerPoolConfig.WorkersCount = 1
+	config.WorkerPoolConfig.PythonExecutable = executable
+	config.WorkerPoolConfig.StartTimeout = 200 * time.Millisecond
+	processor := preprocessing.NewChatTemplatingProcessor(config)
+
+	start := time.Now()
+	assert.Error(t, processor.Initialize(), "A hanging worker should fail Initialize")
+	assert.Less(t, time.Since(start), 10*time.Second, "Initialize should not wait for the hanging worker")
+}
+
+// TestFetchChatTemplateWarmStart tests that templates persisted by a
+// processor are served by a new one without fetching them.
+func TestFetchChatTemplateWarmStart(t *testing.T) {
+	getGlobalWrapper() // the interpreters are shared by all processors
+	dir := t.TempDir()
+	config := preprocessing.DefaultConfig()
+	config.TemplateCacheDir = dir
+	processor := preprocessing.NewChatTemplatingProcessor(config)
+	require.NoError(t, processor.Initialize())
+
+	request := preprocessing.FetchChatTemplateRequest{Model: "ibm-granite/granite-3.3-8b-instruct"}
+	template, kwargs, err := processor.FetchChatTemplate(context.Background(), request)
+	require.NoError(t, err)
+
+	// With Python's cache cleared, the template can only come from the directory.
+	restarted := preprocessing.NewChatTemplatingProcessor(&preprocessing.Config{TemplateCacheDir: dir})
+	require.NoError(t, restarted.Initialize())
+	require.NoError(t, preprocessing.ClearCaches(context.Background()))
+	cachedTemplate, cachedKWArgs, err := restarted.FetchChatTemplate(context.Background(), request)
+	require.NoError(t, err, "Persisted template should be served without fetching it")
+	assert.Equal(t, template, cachedTemplate)
+	assert.Equal(t, kwargs, cachedKWArgs)
+}
+
+// TestRenderAndTokenize tests that the fused render and tokenize call returns
+// the tokens of the rendered chat, with byte offsets into it.
+func TestRenderAndTokenize(t *testing.T) {
+	wrapper := getGlobalWrapper()
+	ctx := context.Background()
+	model := "ibm-granite/granite-3.3-8b-instruct"
+
+	template, kwargs, err := wrapper.FetchChatTemplate(ctx, preprocessing.FetchChatTemplateRequest{Model: model})
+	require.NoError(t, err)
+	request := &preprocessing.RenderJinjaTemplateRequest{
+		Conversations:      []preprocessing.ChatMessage{{Role: "user", Content: "Größe ☃ and 😀?"}},
+		ChatTemplate:       template,
+		ChatTemplateKWArgs: kwargs,
+	}
+	rendered, err := wrapper.RenderChatTemplate(ctx, request)
+	require.NoError(t, err)
+	chat := rendered.RenderedChats[0]
+
+	response, err := wrapper.RenderAndTokenize(ctx, request, &preprocessing.TokenizeOptions{Model: model})
+	require.NoError(t, err)
+	require.NotEmpty(t, response.TokenIDs)
+	require.Len(t, response.Offsets, len(response.TokenIDs))
+	for i, offset := range response.Offsets {
+		assert.LessOrEqual(t, offset[0], offset[1], "Token %d should not end before it starts", i)
+		require.LessOrEqual(t, offset[1], uint(len(chat)), "Token %d should be in the rendered chat", i)
+		assert.True(t, offset[0] == uint(len(chat)) || utf8.RuneStart(chat[offset[0]]),
+			"Token %d should start on a character", i)
+	}
+	assert.Contains(t, chat[response.Offsets[0][0]:response.Offsets[len(response.Offsets)-1][1]], "Größe ☃ and 😀?")
+}
+
 // TestTemplateCaching tests the caching functionality.
 func TestTemplateCaching(t *testing.T) {
-	wrapper := getGlobalWrapper()
+	getGlobalWrapper() // the interpreters are shared by all processors
+	// A new processor, to start without fetched templates cached in Go.
+	wrapper := preprocessing.NewChatTemplatingProcessor(nil)
+	require.NoError(t, wrapper.Initialize())
 
 	// Clear all caches to ensure we start with a clean state
 	err := preprocessing.ClearCaches(context.Background())
@@ -449,7 +880,9 @@ func TestLongChatCompletions(t *testing.T) {
 
 // BenchmarkGetModelChatTemplate benchmarks the template fetching performance.
 func BenchmarkGetModelChatTemplate(b *testing.B) {
-	wrapper := getGlobalWrapper()
+	getGlobalWrapper() // the interpreters are shared by all processors
+	wrapper := preprocessing.NewChatTemplatingProcessor(nil)
+	require.NoError(b, wrapper.Initialize())
 
 	// Clear caches to ensure accurate timing measurements
 	err := preprocessing.ClearCaches(context.Background())
@@ -689,7 +1122,7 @@ func TestMain(m *testing.M) {
 	flag.Parse()
 
 	// Create a new processor to handle initialization.
-	processor := preprocessing.NewChatTemplatingProcessor()
+	processor := preprocessing.NewChatTemplatingProcessor(nil)
 
 	// Set up: Initialize the Python interpreter.
 	klog.Info("Initializing Python interpreter for tests...")
@@ -0,0 +1,1080 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package jinja
+
+import (
+	"fmt"
+	"io"
+	"math"
+	"strings"
+)
+
+// scope holds the variables of a template, loop iteration or macro call.
+// Lookups fall through to the parent scopes.
+type scope struct {
+	vars   map[string]Value
+	parent *scope
+}
+
+func newScope(parent *scope) *scope {
+	return &scope{vars: make(map[string]Value), parent: parent}
+}
+
+func (s *scope) lookup(name string) (Value, bool) {
+	for ; s != nil; s = s.parent {
+		if v, ok := s.vars[name]; ok {
+			return v, true
+		}
+	}
+	return nil, false
+}
+
+// flow is how a list of nodes finished rendering.
+type flow int
+
+const (
+	flowNormal flow = iota
+	flowBreak
+	flowContinue
+)
+
+// renderer holds the state of a single render.
+type renderer struct {
+	out io.StringWriter
+}
+
+// macro is a macro definition. Macros defined while rendering are bound to
+// the scope they were defined in.
+type macro struct {
+	name     string
+	params   []string
+	defaults []expr // nil for parameters without a default
+	body     []node
+	closure  *scope
+}
+
+// namespace is the object created by namespace(), the only object whose
+// attributes templates can assign.
+type namespace struct {
+	attrs *Dict
+}
+
+// loopContext is the `loop` variable of a for loop.
+type loopContext struct {
+	items []Value
+	index int
+}
+
+// iterator is a single-use sequence, like the generators returned by
+// Jinja's map and select filters.
+type iterator struct {
+	items []Value
+	pos   int
+}
+
+func (it *iterator) consume() []Value {
+	items := it.items[it.pos:]
+	it.pos = len(it.items)
+	return items
+}
+
+// dictView is the result of dict.keys(), values() and items().
+type dictView struct {
+	dict *Dict
+	kind string // "keys", "values" or "items"
+}
+
+func (v *dictView) items() []Value {
+	switch v.kind {
+	case "keys":
+		return v.dict.keys
+	case "values":
+		return v.dict.values
+	}
+	items := make([]Value, len(v.dict.keys))
+	for i, key := range v.dict.keys {
+		items[i] = Tuple{key, v.dict.values[i]}
+	}
+	return items
+}
+
+// method is a method of a Python builtin type bound to its receiver.
+type method struct {
+	recv Value
+	name string
+}
+
+// builtin is a global function or a method of an internal object.
+type builtin func(r *renderer, args *callArgs) (Value, error)
+
+// callArgs holds the evaluated arguments of a call.
+type callArgs struct {
+	args    []Value
+	kwNames []string
+	kwArgs  []Value
+}
+
+// absent marks a parameter that was not passed in callArgs.bind.
+type absent struct{}
+
+// bind maps the arguments to params the way Python binds keyword-or-
+// positional parameters. Parameters not passed are absent{}.
+func (a *callArgs) bind(fn string, params ...string) ([]Value, error) {
+	if len(a.args) > len(params) {
+		return nil, fmt.Errorf("%s() takes at most %d arguments (%d given)", fn, len(params), len(a.args))
+	}
+
+	values := make([]Value, len(params))
+	for i := range values {
+		values[i] = absent{}
+	}
+	copy(values, a.args)
+
+	for i, name := range a.kwNames {
+		found := false
+		for j, param := range params {
+			if param != name {
+				continue
+			}
+			if _, ok := values[j].(absent); !ok {
+				return nil, fmt.Errorf("%s() got multiple values for argument '%s'", fn, name)
+			}
+			values[j] = a.kwArgs[i]
+			found = true
+			break
+		}
+		if !found {
+			return nil, fmt.Errorf("%s() got an unexpected keyword argument '%s'", fn, name)
+		}
+	}
+	return values, nil
+}
+
+// orDefault returns v, or def if v is absent.
+func orDefault(v, def Value) Value {
+	if _, ok := v.(absent); ok {
+		return def
+	}
+	return v
+}
+
+func undefinedError(u Undefined) error {
+	if u.name == "" {
+		return fmt.Errorf("undefined value used")
+	}
+	return fmt.Errorf("'%s' is undefined", u.name)
+}
+
+func (r *renderer) renderNodes(nodes []node, sc *scope) (flow, error) {
+	for _, n := range nodes {
+		f, err := r.renderNode(n, sc)
+		if err != nil || f != flowNormal {
+			return f, err
+		}
+	}
+	return flowNormal, nil
+}
+
+func (r *renderer) renderNode(stmt node, sc *scope) (flow, error) {
+	switch stmt := stmt.(type) {
+	case *textNode:
+		if _, err := r.out.WriteString(stmt.text); err != nil {
+			return flowNormal, err
+		}
+	case *outputNode:
+		v, err := r.eval(stmt.expr, sc)
+		if err != nil {
+			return flowNormal, err
+		}
+		str, err := toString(v)
+		if err != nil {
+			return flowNormal, err
+		}
+		if _, err := r.out.WriteString(str); err != nil {
+			return flowNormal, err
+		}
+	case *ifNode:
+		cond, err := r.eval(stmt.cond, sc)
+		if err != nil {
+			return flowNormal, err
+		}
+		if truthy(cond) {
+			return r.renderNodes(stmt.body, sc)
+		}
+		return r.renderNodes(stmt.elseBody, sc)
+	case *forNode:
+		return flowNormal, r.renderFor(stmt, sc)
+	case *setNode:
+		return flowNormal, r.renderSet(stmt, sc)
+	case *macroNode:
+		bound := *stmt.macro
+		bound.closure = sc
+		sc.vars[bound.name] = &bound
+	case *breakNode:
+		return flowBreak, nil
+	case *continueNode:
+		return flowContinue, nil
+	default:
+		return flowNormal, fmt.Errorf("unknown node %T", stmt)
+	}
+	return flowNormal, nil
+}
+
+func (r *renderer) renderFor(stmt *forNode, sc *scope) error {
+	iterable, err := r.eval(stmt.iter, sc)
+	if err != nil {
+		return err
+	}
+	items, err := iterate(iterable)
+	if err != nil {
+		return err
+	}
+
+	if stmt.filter != nil {
+		filtered := make([]Value, 0, len(items))
+		for _, item := range items {
+			itemScope := newScope(sc)
+			if err := assign(itemScope, stmt.target, item); err != nil {
+				return err
+			}
+			keep, err := r.eval(stmt.filter, itemScope)
+			if err != nil {
+				return err
+			}
+			if truthy(keep) {
+				filtered = append(filtered, item)
+			}
+		}
+		items = filtered
+	}
+
+	if len(items) == 0 {
+		_, err := r.renderNodes(stmt.elseBody, sc)
+		return err
+	}
+
+	loop := &loopContext{items: items}
+	for i, item := range items {
+		loop.index = i
+		// Every iteration gets a fresh scope, so assignments in the body do
+		// not leak into the next iteration or out of the loop.
+		itemScope := newScope(sc)
+		itemScope.vars["loop"] = loop
+		if err := assign(itemScope, stmt.target, item); err != nil {
+			return err
+		}
+		f, err := r.renderNodes(stmt.body, itemScope)
+		if err != nil {
+			return err
+		}
+		if f == flowBreak {
+			break
+		}
+	}
+	return nil
+}
+
+func (r *renderer) renderSet(stmt *setNode, sc *scope) error {
+	var value Value
+	if stmt.value != nil {
+		var err error
+		if value, err = r.eval(stmt.value, sc); err != nil {
+			return err
+		}
+	} else {
+		captured, err := r.capture(stmt.body, sc)
+		if err != nil {
+			return err
+		}
+		value = captured
+	}
+
+	if stmt.target.attr != "" {
+		obj, _ := sc.lookup(stmt.target.names[0])
+		ns, ok := obj.(*namespace)
+		if !ok {
+			return fmt.Errorf("cannot assign attribute on non-namespace object")
+		}
+		return ns.attrs.put(stmt.target.attr, value)
+	}
+	return assign(sc, stmt.target, value)
+}
+
+// capture renders nodes into a string instead of the output.
+func (r *renderer) capture(nodes []node, sc *scope) (string, error) {
+	out := r.out
+	var sb strings.Builder
+	r.out = &sb
+	_, err := r.renderNodes(nodes, sc)
+	r.out = out
+	return sb.String(), err
+}
+
+func assign(sc *scope, target assignTarget, value Value) error {
+	if !target.tuple {
+		sc.vars[target.names[0]] = value
+		return nil
+	}
+
+	items, err := iterate(value)
+	if err != nil {
+		return fmt.Errorf("cannot unpack non-iterable %s object", typeName(value))
+	}
+	if len(items) != len(target.names) {
+		return fmt.Errorf("cannot unpack %d values into %d names", len(items), len(target.names))
+	}
+	for i, name := range target.names {
+		sc.vars[name] = items[i]
+	}
+	return nil
+}
+
+func (r *renderer) eval(ex expr, sc *scope) (Value, error) {
+	switch ex := ex.(type) {
+	case *constExpr:
+		return ex.value, nil
+	case *nameExpr:
+		if v, ok := sc.lookup(ex.name); ok {
+			return v, nil
+		}
+		return Undefined{name: ex.name}, nil
+	case *listExpr:
+		items := make([]Value, len(ex.items))
+		for i, item := range ex.items {
+			v, err := r.eval(item, sc)
+			if err != nil {
+				return nil, err
+			}
+			items[i] = v
+		}
+		if ex.tuple {
+			return Tuple(items), nil
+		}
+		return items, nil
+	case *dictExpr:
+		d := NewDict()
+		for i := range ex.keys {
+			key, err := r.eval(ex.keys[i], sc)
+			if err != nil {
+				return nil, err
+			}
+			value, err := r.eval(ex.values[i], sc)
+			if err != nil {
+				return nil, err
+			}
+			if err := d.put(key, value); err != nil {
+				return nil, err
+			}
+		}
+		return d, nil
+	case *getattrExpr:
+		obj, err := r.eval(ex.obj, sc)
+		if err != nil {
+			return nil, err
+		}
+		return getattr(obj, ex.name)
+	case *getitemExpr:
+		obj, err := r.eval(ex.obj, sc)
+		if err != nil {
+			return nil, err
+		}
+		key, err := r.eval(ex.key, sc)
+		if err != nil {
+			return nil, err
+		}
+		return getitem(obj, key)
+	case *sliceExpr:
+		return r.evalSlice(ex, sc)
+	case *callExpr:
+		fn, err := r.eval(ex.fn, sc)
+		if err != nil {
+			return nil, err
+		}
+		args, err := r.evalArgs(&ex.args, sc)
+		if err != nil {
+			return nil, err
+		}
+		return r.call(fn, args)
+	case *filterExpr:
+		input, err := r.eval(ex.input, sc)
+		if err != nil {
+			return nil, err
+		}
+		args, err := r.evalArgs(&ex.args, sc)
+		if err != nil {
+			return nil, err
+		}
+		return filters[ex.name](r, input, args)
+	case *testExpr:
+		input, err := r.eval(ex.input, sc)
+		if err != nil {
+			return nil, err
+		}
+		args, err := r.evalArgs(&ex.args, sc)
+		if err != nil {
+			return nil, err
+		}
+		ok, err := tests[ex.name](input, args)
+		if err != nil {
+			return nil, err
+		}
+		return ok != ex.negate, nil
+	case *unaryExpr:
+		x, err := r.eval(ex.x, sc)
+		if err != nil {
+			return nil, err
+		}
+		return unaryOp(ex.op, x)
+	case *binaryExpr:
+		return r.evalBinary(ex, sc)
+	case *compareExpr:
+		return r.evalCompare(ex, sc)
+	case *condExpr:
+		cond, err := r.eval(ex.cond, sc)
+		if err != nil {
+			return nil, err
+		}
+		if truthy(cond) {
+			return r.eval(ex.then, sc)
+		}
+		if ex.otherwise == nil {
+			return Undefined{}, nil
+		}
+		return r.eval(ex.otherwise, sc)
+	}
+	return nil, fmt.Errorf("unknown expression %T", ex)
+}
+
+func (r *renderer) evalArgs(ex *callArgsExpr, sc *scope) (*callArgs, error) {
+	args := &callArgs{kwNames: ex.kwNames}
+	if len(ex.args) > 0 {
+		args.args = make([]Value, len(ex.args))
+		for i, arg := range ex.args {
+			v, err := r.eval(arg, sc)
+			if err != nil {
+				return nil, err
+			}
+			args.args[i] = v
+		}
+	}
+	if len(ex.kwArgs) > 0 {
+		args.kwArgs = make([]Value, len(ex.kwArgs))
+		for i, arg := range ex.kwArgs {
+			v, err := r.eval(arg, sc)
+			if err != nil {
+				return nil, err
+			}
+			args.kwArgs[i] = v
+		}
+	}
+	return args, nil
+}
+
+func (r *renderer) evalBinary(ex *binaryExpr, sc *scope) (Value, error) {
+	lhs, err := r.eval(ex.l, sc)
+	if err != nil {
+		return nil, err
+	}
+
+	// and/or return one of their operands, like in Python.
+	switch ex.op {
+	case "and":
+		if !truthy(lhs) {
+			return lhs, nil
+		}
+		return r.eval(ex.r, sc)
+	case "or":
+		if truthy(lhs) {
+			return lhs, nil
+		}
+		return r.eval(ex.r, sc)
+	}
+
+	rhs, err := r.eval(ex.r, sc)
+	if err != nil {
+		return nil, err
+	}
+	if ex.op == "~" {
+		ls, err := toString(lhs)
+		if err != nil {
+			return nil, err
+		}
+		rs, err := toString(rhs)
+		if err != nil {
+			return nil, err
+		}
+		return ls + rs, nil
+	}
+	return binaryOp(ex.op, lhs, rhs)
+}
+
+func (r *renderer) evalCompare(ex *compareExpr, sc *scope) (Value, error) {
+	l, err := r.eval(ex.first, sc)
+	if err != nil {
+		return nil, err
+	}
+	for i, op := range ex.ops {
+		rv, err := r.eval(ex.operands[i], sc)
+		if err != nil {
+			return nil, err
+		}
+		ok, err := compareOp(op, l, rv)
+		if err != nil || !ok {
+			return false, err
+		}
+		l = rv
+	}
+	return true, nil
+}
+
+func compareOp(op string, l, r Value) (bool, error) {
+	switch op {
+	case "==":
+		return equal(l, r), nil
+	case "!=":
+		return !equal(l, r), nil
+	case "in":
+		return contains(r, l)
+	case "notin":
+		ok, err := contains(r, l)
+		return !ok, err
+	}
+
+	if u, ok := l.(Undefined); ok {
+		return false, undefinedError(u)
+	}
+	if u, ok := r.(Undefined); ok {
+		return false, undefinedError(u)
+	}
+	c, err := compare(l, r)
+	if err != nil {
+		return false, err
+	}
+	switch op {
+	case "<":
+		return c < 0, nil
+	case "<=":
+		return c <= 0, nil
+	case ">":
+		return c > 0, nil
+	default: // ">="
+		return c >= 0, nil
+	}
+}
+
+func unaryOp(op string, x Value) (Value, error) {
+	if op == "not" {
+		return !truthy(x), nil
+	}
+	if u, ok := x.(Undefined); ok {
+		return nil, undefinedError(u)
+	}
+
+	i, f, isFloat, ok := toNumber(x)
+	if !ok {
+		return nil, fmt.Errorf("bad operand type for unary %s: '%s'", op, typeName(x))
+	}
+	switch {
+	case op == "+" && isFloat:
+		return f, nil
+	case op == "+":
+		return i, nil
+	case isFloat:
+		return -f, nil
+	case i == math.MinInt64:
+		return nil, errIntOverflow
+	}
+	return -i, nil
+}
+
+var errIntOverflow = fmt.Errorf("%w: integers beyond 64 bits", ErrUnsupported)
+
+// binaryOp implements Python's arithmetic operators.
+func binaryOp(op string, lhs, rhs Value) (Value, error) {
+	if u, ok := lhs.(Undefined); ok {
+		return nil, undefinedError(u)
+	}
+	if u, ok := rhs.(Undefined); ok {
+		return nil, undefinedError(u)
+	}
+
+	li, lf, lFloat, lNum := toNumber(lhs)
+	ri, rf, rFloat, rNum := toNumber(rhs)
+	if lNum && rNum {
+		if !lFloat && !rFloat {
+			return intOp(op, li, ri)
+		}
+		if !lFloat {
+			lf = float64(li)
+		}
+		if !rFloat {
+			rf = float64(ri)
+		}
+		return floatOp(op, lf, rf)
+	}
+
+	switch op {
+	case "+":
+		switch x := lhs.(type) {
+		case string:
+			if y, ok := rhs.(string); ok {
+				return x + y, nil
+			}
+		case []Value:
+			if y, ok := rhs.([]Value); ok {
+				return append(append(make([]Value, 0, len(x)+len(y)), x...), y...), nil
+			}
+		case Tuple:
+			if y, ok := rhs.(Tuple); ok {
+				return append(append(make(Tuple, 0, len(x)+len(y)), x...), y...), nil
+			}
+		}
+	case "*":
+		if lNum && !lFloat {
+			return repeat(rhs, li)
+		}
+		if rNum && !rFloat {
+			return repeat(lhs, ri)
+		}
+	case "%":
+		if _, ok := lhs.(string); ok {
+			return nil, fmt.Errorf("%w: printf-style string formatting", ErrUnsupported)
+		}
+	}
+	return nil, fmt.Errorf("unsupported operand type(s) for %s: '%s' and '%s'", op, typeName(lhs), typeName(rhs))
+}
+
+func repeat(v Value, n int64) (Value, error) {
+	if n < 0 {
+		n = 0
+	}
+	switch x := v.(type) {
+	case string:
+		return strings.Repeat(x, int(n)), nil
+	case []Value:
+		out := make([]Value, 0, len(x)*int(n))
+		for i := int64(0); i < n; i++ {
+			out = append(out, x...)
+		}
+		return out, nil
+	case Tuple:
+		out := make(Tuple, 0, len(x)*int(n))
+		for i := int64(0); i < n; i++ {
+			out = append(out, x...)
+		}
+		return out, nil
+	}
+	return nil, fmt.Errorf("can't multiply sequence by non-int of type '%s'", typeName(v))
+}
+
+func intOp(op string, lhs, rhs int64) (Value, error) {
+	switch op {
+	case "+":
+		c := lhs + rhs
+		if (c > lhs) != (rhs > 0) {
+			return nil, errIntOverflow
+		}
+		return c, nil
+	case "-":
+		c := lhs - rhs
+		if (c < lhs) != (rhs > 0) {
+			return nil, errIntOverflow
+		}
+		return c, nil
+	case "*":
+		return mulInt(lhs, rhs)
+	case "/":
+		if rhs == 0 {
+			return nil, fmt.Errorf("division by zero")
+		}
+		return float64(lhs) / float64(rhs), nil
+	case "//", "%":
+		if rhs == 0 {
+			return nil, fmt.Errorf("integer division or modulo by zero")
+		}
+		if lhs == math.MinInt64 && rhs == -1 {
+			return nil, errIntOverflow
+		}
+		q, m := lhs/rhs, lhs%rhs
+		// Python rounds the quotient towards negative infinity.
+		if m != 0 && (m < 0) != (rhs < 0) {
+			q--
+			m += rhs
+		}
+		if op == "//" {
+			return q, nil
+		}
+		return m, nil
+	default: // "**"
+		// Jinja folds a negative literal base into the generated Python,
+		// where -3 ** 2 is -(3 ** 2).
+		if lhs < 0 {
+			return nil, fmt.Errorf("%w: powers of negative integers", ErrUnsupported)
+		}
+		if rhs < 0 {
+			return nil, fmt.Errorf("%w: negative integer powers", ErrUnsupported)
+		}
+		// Exponentiation by squaring, failing on overflow.
+		result, base := int64(1), lhs
+		for exp := rhs; exp > 0; exp >>= 1 {
+			if exp&1 == 1 {
+				var err error
+				if result, err = mulInt(result, base); err != nil {
+					return nil, err
+				}
+			}
+			if exp > 1 {
+				var err error
+				if base, err = mulInt(base, base); err != nil {
+					return nil, err
+				}
+			}
+		}
+		return result, nil
+	}
+}
+
+func mulInt(lhs, rhs int64) (int64, error) {
+	if lhs == 0 || rhs == 0 {
+		return 0, nil
+	}
+	c := lhs * rhs
+	if c/rhs != lhs || (lhs == -1 && rhs == math.MinInt64) || (rhs == -1 && lhs == math.MinInt64) {
+		return 0, errIntOverflow
+	}
+	return c, nil
+}
+
+func floatOp(op string, lhs, rhs float64) (Value, error) {
+	switch op {
+	case "+":
+		return lhs + rhs, nil
+	case "-":
+		return lhs - rhs, nil
+	case "*":
+		return lhs * rhs, nil
+	case "/":
+		if rhs == 0 {
+			return nil, fmt.Errorf("float division by zero")
+		}
+		return lhs / rhs, nil
+	case "//", "%":
+		if rhs == 0 {
+			return nil, fmt.Errorf("float modulo")
+		}
+		m := math.Mod(lhs, rhs)
+		if m != 0 && (m < 0) != (rhs < 0) {
+			m += rhs
+		}
+		if op == "%" {
+			return m, nil
+		}
+		return math.Floor((lhs - m) / rhs), nil
+	default: // "**"
+		// math.Pow is not correctly rounded like the C library pow, and
+		// Python raises on overflow.
+		return nil, fmt.Errorf("%w: float powers", ErrUnsupported)
+	}
+}
+
+// getattr implements `obj.name`: Python attributes first, then items.
+func getattr(obj Value, name string) (Value, error) {
+	switch obj := obj.(type) {
+	case Undefined:
+		return nil, undefinedError(obj)
+	case *Dict:
+		if dictMethods[name] {
+			return &method{recv: obj, name: name}, nil
+		}
+		if v, ok := obj.get(name); ok {
+			return v, nil
+		}
+	case string:
+		if strMethods[name] {
+			return &method{recv: obj, name: name}, nil
+		}
+	case []Value:
+		if listMethods[name] {
+			return &method{recv: obj, name: name}, nil
+		}
+	case Tuple:
+		if name == "count" || name == "index" {
+			return &method{recv: obj, name: name}, nil
+		}
+	case *namespace:
+		if v, ok := obj.attrs.get(name); ok {
+			return v, nil
+		}
+	case *loopContext:
+		return obj.attr(name), nil
+	case *rangeObject:
+		switch name {
+		case "start":
+			return obj.start, nil
+		case "stop":
+			return obj.stop, nil
+		case "step":
+			return obj.step, nil
+		}
+	}
+	return Undefined{name: name}, nil
+}
+
+// getitem implements `obj[key]`: items first, then Python attributes for
+// string keys.
+func getitem(obj Value, key Value) (Value, error) {
+	switch obj := obj.(type) {
+	case Undefined:
+		return nil, undefinedError(obj)
+	case *Dict:
+		if v, ok := obj.get(key); ok {
+			return v, nil
+		}
+	case []Value:
+		if i, ok := sequenceIndex(key, len(obj)); ok {
+			return obj[i], nil
+		}
+	case Tuple:
+		if i, ok := sequenceIndex(key, len(obj)); ok {
+			return obj[i], nil
+		}
+	case *rangeObject:
+		if i, ok := sequenceIndex(key, len(obj.items)); ok {
+			return obj.items[i], nil
+		}
+	case string:
+		runes := []rune(obj)
+		if i, ok := sequenceIndex(key, len(runes)); ok {
+			return string(runes[i]), nil
+		}
+	}
+
+	if name, ok := key.(string); ok {
+		return getattr(obj, name)
+	}
+	return Undefined{}, nil
+}
+
+// sequenceIndex resolves a Python index, including negative ones.
+func sequenceIndex(key Value, n int) (int, bool) {
+	i, _, isFloat, ok := toNumber(key)
+	if !ok || isFloat {
+		return 0, false
+	}
+	if i < 0 {
+		i += int64(n)
+	}
+	if i < 0 || i >= int64(n) {
+		return 0, false
+	}
+	return int(i), true
+}
+
+func (r *renderer) evalSlice(ex *sliceExpr, sc *scope) (Value, error) {
+	obj, err := r.eval(ex.obj, sc)
+	if err != nil {
+		return nil, err
+	}
+	var bounds [3]Value
+	for i, part := range []expr{ex.start, ex.stop, ex.step} {
+		if part == nil {
+			continue
+		}
+		if bounds[i], err = r.eval(part, sc); err != nil {
+			return nil, err
+		}
+	}
+	if u, ok := obj.(Undefined); ok {
+		return nil, undefinedError(u)
+	}
+
+	var n int
+	switch obj := obj.(type) {
+	case []Value:
+		n = len(obj)
+	case Tuple:
+		n = len(obj)
+	case string:
+		n = len([]rune(obj))
+	case *rangeObject:
+		return nil, fmt.Errorf("%w: slicing ranges", ErrUnsupported)
+	default:
+		return Undefined{}, nil
+	}
+
+	indices, ok, err := sliceIndices(bounds, n)
+	if err != nil || !ok {
+		return Undefined{}, err
+	}
+
+	switch obj := obj.(type) {
+	case []Value:
+		out := make([]Value, len(indices))
+		for i, idx := range indices {
+			out[i] = obj[idx]
+		}
+		return out, nil
+	case Tuple:
+		out := make(Tuple, len(indices))
+		for i, idx := range indices {
+			out[i] = obj[idx]
+		}
+		return out, nil
+	case string:
+		runes := []rune(obj)
+		out := make([]rune, len(indices))
+		for i, idx := range indices {
+			out[i] = runes[idx]
+		}
+		return string(out), nil
+	}
+	return Undefined{}, nil
+}
+
+// sliceIndices returns the indices selected by a Python slice over a
+// sequence of length size. ok is false for bounds that are not integers.
+func sliceIndices(bounds [3]Value, size int) ([]int, bool, error) {
+	var parsed [3]int64
+	var set [3]bool
+	for i, b := range bounds {
+		if b == nil {
+			continue
+		}
+		v, _, isFloat, ok := toNumber(b)
+		if !ok || isFloat {
+			return nil, false, nil
+		}
+		parsed[i], set[i] = v, true
+	}
+
+	step := int64(1)
+	if set[2] {
+		step = parsed[2]
+	}
+	if step == 0 {
+		return nil, false, fmt.Errorf("slice step cannot be zero")
+	}
+
+	length := int64(size)
+	lower, upper := int64(0), length
+	if step < 0 {
+		lower, upper = -1, length-1
+	}
+	adjust := func(v int64, isSet bool, def int64) int64 {
+		if !isSet {
+			return def
+		}
+		if v < 0 {
+			v += length
+			if v < lower {
+				v = lower
+			}
+		} else if v > upper {
+			v = upper
+		}
+		return v
+	}
+
+	var start, stop int64
+	if step > 0 {
+		start, stop = adjust(parsed[0], set[0], lower), adjust(parsed[1], set[1], upper)
+	} else {
+		start, stop = adjust(parsed[0], set[0], upper), adjust(parsed[1], set[1], lower)
+	}
+
+	var indices []int
+	for i := start; (step > 0 && i < stop) || (step < 0 && i > stop); i += step {
+		indices = append(indices, int(i))
+	}
+	return indices, true, nil
+}
+
+func (r *renderer) call(fn Value, args *callArgs) (Value, error) {
+	switch f := fn.(type) {
+	case *macro:
+		return r.callMacro(f, args)
+	case *method:
+		return callMethod(f, args)
+	case builtin:
+		return f(r, args)
+	case Undefined:
+		return nil, undefinedError(f)
+	}
+	return nil, fmt.Errorf("'%s' object is not callable", typeName(fn))
+}
+
+func (r *renderer) callMacro(m *macro, args *callArgs) (Value, error) {
+	values, err := args.bind(m.name, m.params...)
+	if err != nil {
+		return nil, err
+	}
+
+	s := newScope(m.closure)
+	for i, param := range m.params {
+		v := values[i]
+		if _, ok := v.(absent); ok {
+			if m.defaults[i] == nil {
+				v = Undefined{name: param}
+			} else if v, err = r.eval(m.defaults[i], s); err != nil {
+				return nil, err
+			}
+		}
+		s.vars[param] = v
+	}
+
+	return r.capture(m.body, s)
+}
+
+func (l *loopContext) attr(name string) Value {
+	count := len(l.items)
+	switch name {
+	case "index":
+		return int64(l.index + 1)
+	case "index0":
+		return int64(l.index)
+	case "revindex":
+		return int64(count - l.index)
+	case "revindex0":
+		return int64(count - l.index - 1)
+	case "first":
+		return l.index == 0
+	case "last":
+		return l.index == count-1
+	case "length":
+		return int64(count)
+	case "depth":
+		return int64(1)
+	case "depth0":
+		return int64(0)
+	case "previtem":
+		if l.index > 0 {
+			return l.items[l.index-1]
+		}
+	case "nextitem":
+		if l.index < count-1 {
+			return l.items[l.index+1]
+		}
+	case "cycle":
+		return builtin(func(_ *renderer, args *callArgs) (Value, error) {
+			if len(args.args) == 0 {
+				return nil, fmt.Errorf("no items for cycling given")
+			}
+			return args.args[l.index%len(args.args)], nil
+		})
+	}
+	return Undefined{name: name}
+}
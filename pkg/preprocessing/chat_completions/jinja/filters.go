@@ -0,0 +1,755 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package jinja
+
+import (
+	"fmt"
+	"math"
+	"strconv"
+	"strings"
+	"unicode"
+)
+
+type (
+	filterFunc func(r *renderer, input Value, args *callArgs) (Value, error)
+	testFunc   func(input Value, args *callArgs) (bool, error)
+)
+
+// filters and tests hold the supported subset of the Jinja builtins, with
+// tojson replaced like transformers does. Templates using others are not
+// compiled.
+var (
+	filters map[string]filterFunc
+	tests   map[string]testFunc
+)
+
+//nolint:gochecknoinits // the filter tables refer to themselves through map and select
+func init() {
+	filters = map[string]filterFunc{
+		"abs":        filterAbs,
+		"capitalize": caseFilter(capitalize),
+		"count":      filterLength,
+		"d":          filterDefault,
+		"default":    filterDefault,
+		"first":      filterFirst,
+		"float":      filterFloat,
+		"indent":     filterIndent,
+		"int":        filterInt,
+		"items":      filterItems,
+		"join":       filterJoin,
+		"last":       filterLast,
+		"length":     filterLength,
+		"list":       filterList,
+		"lower":      caseFilter(strings.ToLower),
+		"map":        filterMap,
+		"reject":     selectFilter(false, false),
+		"rejectattr": selectFilter(true, false),
+		"replace":    filterReplace,
+		"reverse":    filterReverse,
+		"safe":       filterString,
+		"select":     selectFilter(false, true),
+		"selectattr": selectFilter(true, true),
+		"string":     filterString,
+		"title":      caseFilter(jinjaTitle),
+		"tojson":     filterToJSON,
+		"trim":       filterTrim,
+		"upper":      caseFilter(strings.ToUpper),
+	}
+
+	tests = map[string]testFunc{
+		"boolean":     typeTest(func(v Value) bool { _, ok := v.(bool); return ok }),
+		"callable":    typeTest(isCallable),
+		"defined":     typeTest(func(v Value) bool { _, ok := v.(Undefined); return !ok }),
+		"divisibleby": testDivisibleBy,
+		"eq":          compareTest("=="),
+		"equalto":     compareTest("=="),
+		"==":          compareTest("=="),
+		"even":        parityTest(0),
+		"false":       typeTest(func(v Value) bool { b, ok := v.(bool); return ok && !b }),
+		"float":       typeTest(func(v Value) bool { _, ok := v.(float64); return ok }),
+		"ge":          compareTest(">="),
+		">=":          compareTest(">="),
+		"gt":          compareTest(">"),
+		"greaterthan": compareTest(">"),
+		">":           compareTest(">"),
+		"in":          testIn,
+		"integer":     typeTest(func(v Value) bool { _, ok := v.(int64); return ok }),
+		"iterable":    typeTest(isIterable),
+		"le":          compareTest("<="),
+		"<=":          compareTest("<="),
+		"lt":          compareTest("<"),
+		"lessthan":    compareTest("<"),
+		"<":           compareTest("<"),
+		"mapping":     typeTest(func(v Value) bool { _, ok := v.(*Dict); return ok }),
+		"ne":          compareTest("!="),
+		"!=":          compareTest("!="),
+		"none":        typeTest(func(v Value) bool { return v == nil }),
+		"number":      typeTest(func(v Value) bool { _, _, _, ok := toNumber(v); return ok }),
+		"odd":         parityTest(1),
+		"sameas":      testSameAs,
+		"sequence":    typeTest(isSequence),
+		"string":      typeTest(func(v Value) bool { _, ok := v.(string); return ok }),
+		"true":        typeTest(func(v Value) bool { b, ok := v.(bool); return ok && b }),
+		"undefined":   typeTest(func(v Value) bool { _, ok := v.(Undefined); return ok }),
+	}
+}
+
+func stringFilter(fn func(string) string) filterFunc {
+	return func(_ *renderer, input Value, args *callArgs) (Value, error) {
+		if _, err := args.bind("filter"); err != nil {
+			return nil, err
+		}
+		s, err := toString(input)
+		if err != nil {
+			return nil, err
+		}
+		return fn(s), nil
+	}
+}
+
+// caseFilter is a stringFilter changing letter case, see mapCase.
+func caseFilter(fn func(string) string) filterFunc {
+	return func(_ *renderer, input Value, args *callArgs) (Value, error) {
+		if _, err := args.bind("filter"); err != nil {
+			return nil, err
+		}
+		s, err := toString(input)
+		if err != nil {
+			return nil, err
+		}
+		return mapCase(fn, s)
+	}
+}
+
+func filterString(_ *renderer, input Value, args *callArgs) (Value, error) {
+	return stringFilter(func(s string) string { return s })(nil, input, args)
+}
+
+func filterTrim(_ *renderer, input Value, args *callArgs) (Value, error) {
+	values, err := args.bind("trim", "chars")
+	if err != nil {
+		return nil, err
+	}
+	s, err := toString(input)
+	if err != nil {
+		return nil, err
+	}
+	return pyStrip(s, orDefault(values[0], nil), true, true)
+}
+
+func filterLength(_ *renderer, input Value, args *callArgs) (Value, error) {
+	if _, err := args.bind("length"); err != nil {
+		return nil, err
+	}
+	n, err := length(input)
+	return int64(n), err
+}
+
+func filterDefault(_ *renderer, input Value, args *callArgs) (Value, error) {
+	values, err := args.bind("default", "default_value", "boolean")
+	if err != nil {
+		return nil, err
+	}
+	def := orDefault(values[0], "")
+	_, undefined := input.(Undefined)
+	if undefined || (truthy(orDefault(values[1], false)) && !truthy(input)) {
+		return def, nil
+	}
+	return input, nil
+}
+
+func filterFirst(_ *renderer, input Value, args *callArgs) (Value, error) {
+	if _, err := args.bind("first"); err != nil {
+		return nil, err
+	}
+	if it, ok := input.(*iterator); ok {
+		if it.pos < len(it.items) {
+			it.pos++
+			return it.items[it.pos-1], nil
+		}
+		return Undefined{}, nil
+	}
+
+	items, err := iterate(input)
+	if err != nil {
+		return nil, err
+	}
+	if len(items) == 0 {
+		return Undefined{}, nil
+	}
+	return items[0], nil
+}
+
+func filterLast(_ *renderer, input Value, args *callArgs) (Value, error) {
+	if _, err := args.bind("last"); err != nil {
+		return nil, err
+	}
+	if _, ok := input.(*iterator); ok {
+		return nil, fmt.Errorf("'generator' object is not reversible")
+	}
+	items, err := iterate(input)
+	if err != nil {
+		return nil, err
+	}
+	if len(items) == 0 {
+		return Undefined{}, nil
+	}
+	return items[len(items)-1], nil
+}
+
+func filterList(_ *renderer, input Value, args *callArgs) (Value, error) {
+	if _, err := args.bind("list"); err != nil {
+		return nil, err
+	}
+	items, err := iterate(input)
+	if err != nil {
+		return nil, err
+	}
+	return append([]Value{}, items...), nil
+}
+
+func filterReverse(_ *renderer, input Value, args *callArgs) (Value, error) {
+	if _, err := args.bind("reverse"); err != nil {
+		return nil, err
+	}
+	if s, ok := input.(string); ok {
+		runes := []rune(s)
+		for i, j := 0, len(runes)-1; i < j; i, j = i+1, j-1 {
+			runes[i], runes[j] = runes[j], runes[i]
+		}
+		return string(runes), nil
+	}
+
+	items, err := iterate(input)
+	if err != nil {
+		return nil, err
+	}
+	reversed := make([]Value, len(items))
+	for i, item := range items {
+		reversed[len(items)-1-i] = item
+	}
+	if _, ok := input.(*iterator); ok {
+		return reversed, nil
+	}
+	// reversed() returns an iterator for sequences.
+	return &iterator{items: reversed}, nil
+}
+
+func filterJoin(_ *renderer, input Value, args *callArgs) (Value, error) {
+	values, err := args.bind("join", "d", "attribute")
+	if err != nil {
+		return nil, err
+	}
+	sep, err := toString(orDefault(values[0], ""))
+	if err != nil {
+		return nil, err
+	}
+	items, err := iterate(input)
+	if err != nil {
+		return nil, err
+	}
+
+	attribute := orDefault(values[1], nil)
+	parts := make([]string, len(items))
+	for i, item := range items {
+		if attribute != nil {
+			if item, err = attrGetter(item, attribute, nil); err != nil {
+				return nil, err
+			}
+		}
+		if parts[i], err = toString(item); err != nil {
+			return nil, err
+		}
+	}
+	return strings.Join(parts, sep), nil
+}
+
+func filterReplace(_ *renderer, input Value, args *callArgs) (Value, error) {
+	values, err := args.bind("replace", "old", "new", "count")
+	if err != nil {
+		return nil, err
+	}
+	strs := make([]string, 3)
+	for i, v := range []Value{input, values[0], values[1]} {
+		if _, ok := v.(absent); ok {
+			return nil, fmt.Errorf("replace() missing required argument")
+		}
+		if strs[i], err = toString(v); err != nil {
+			return nil, err
+		}
+	}
+
+	count := int64(-1)
+	if c := orDefault(values[2], nil); c != nil {
+		n, _, isFloat, ok := toNumber(c)
+		if !ok || isFloat {
+			return nil, fmt.Errorf("replace() count must be an integer")
+		}
+		count = n
+	}
+	return pyReplace(strs[0], strs[1], strs[2], count), nil
+}
+
+func filterItems(_ *renderer, input Value, args *callArgs) (Value, error) {
+	if _, err := args.bind("items"); err != nil {
+		return nil, err
+	}
+	switch x := input.(type) {
+	case Undefined:
+		return &iterator{}, nil
+	case *Dict:
+		return &iterator{items: (&dictView{dict: x, kind: "items"}).items()}, nil
+	}
+	return nil, fmt.Errorf("can only get item pairs from a mapping")
+}
+
+func filterAbs(_ *renderer, input Value, args *callArgs) (Value, error) {
+	if _, err := args.bind("abs"); err != nil {
+		return nil, err
+	}
+	i, f, isFloat, ok := toNumber(input)
+	switch {
+	case !ok:
+		return nil, fmt.Errorf("bad operand type for abs(): '%s'", typeName(input))
+	case isFloat:
+		return math.Abs(f), nil
+	case i == math.MinInt64:
+		return nil, errIntOverflow
+	case i < 0:
+		return -i, nil
+	}
+	return i, nil
+}
+
+func filterInt(_ *renderer, input Value, args *callArgs) (Value, error) {
+	values, err := args.bind("int", "default", "base")
+	if err != nil {
+		return nil, err
+	}
+	def := orDefault(values[0], int64(0))
+	if base := orDefault(values[1], int64(10)); !equal(base, int64(10)) {
+		return nil, fmt.Errorf("%w: int filter bases other than 10", ErrUnsupported)
+	}
+
+	switch x := input.(type) {
+	case Undefined:
+		return nil, undefinedError(x)
+	case bool:
+		if x {
+			return int64(1), nil
+		}
+		return int64(0), nil
+	case int64:
+		return x, nil
+	case float64:
+		return floatToInt(x)
+	case string:
+		s := strings.TrimFunc(x, isSpace)
+		if n, err := strconv.ParseInt(strings.ReplaceAll(s, "_", ""), 10, 64); err == nil && validUnderscores(s) {
+			return n, nil
+		}
+		// "42.23"|int gives 42.
+		if f, ok := parsePyFloat(s); ok {
+			return floatToInt(f)
+		}
+	}
+	return def, nil
+}
+
+func floatToInt(f float64) (Value, error) {
+	if math.IsNaN(f) || math.IsInf(f, 0) {
+		return nil, fmt.Errorf("cannot convert float %s to integer", formatFloat(f))
+	}
+	if math.Abs(f) >= 1<<63 {
+		return nil, errIntOverflow
+	}
+	return int64(f), nil
+}
+
+func validUnderscores(s string) bool {
+	s = strings.TrimLeft(s, "+-")
+	return !strings.HasPrefix(s, "_") && !strings.HasSuffix(s, "_") && !strings.Contains(s, "__")
+}
+
+// parsePyFloat parses a string the way Python's float() does.
+func parsePyFloat(s string) (float64, bool) {
+	s = strings.TrimFunc(s, isSpace)
+	lower := strings.ToLower(strings.TrimLeft(s, "+-"))
+	switch lower {
+	case "inf", "infinity", "nan":
+	default:
+		if strings.ContainsAny(lower, "xp") || !validUnderscores(s) {
+			return 0, false
+		}
+	}
+	f, err := strconv.ParseFloat(strings.ReplaceAll(s, "_", ""), 64)
+	if err != nil && !strings.Contains(err.Error(), "out of range") {
+		return 0, false
+	}
+	return f, true
+}
+
+func filterFloat(_ *renderer, input Value, args *callArgs) (Value, error) {
+	values, err := args.bind("float", "default")
+	if err != nil {
+		return nil, err
+	}
+	switch x := input.(type) {
+	case Undefined:
+		return nil, undefinedError(x)
+	case bool, int64:
+		i, _, _, _ := toNumber(x)
+		return float64(i), nil
+	case float64:
+		return x, nil
+	case string:
+		if f, ok := parsePyFloat(x); ok {
+			return f, nil
+		}
+	}
+	return orDefault(values[0], 0.0), nil
+}
+
+func filterIndent(_ *renderer, input Value, args *callArgs) (Value, error) {
+	values, err := args.bind("indent", "width", "first", "blank")
+	if err != nil {
+		return nil, err
+	}
+	s, err := toString(input)
+	if err != nil {
+		return nil, err
+	}
+
+	var indention string
+	switch w := orDefault(values[0], int64(4)).(type) {
+	case string:
+		indention = w
+	case int64:
+		indention = strings.Repeat(" ", int(max(w, 0)))
+	default:
+		return nil, fmt.Errorf("%w: indent width of type '%s'", ErrUnsupported, typeName(w))
+	}
+
+	lines := splitLines(s + "\n")
+	var rv string
+	if truthy(orDefault(values[2], false)) {
+		rv = strings.Join(lines, "\n"+indention)
+	} else {
+		rv = lines[0]
+		if len(lines) > 1 {
+			rest := make([]string, len(lines)-1)
+			for i, line := range lines[1:] {
+				if line != "" {
+					line = indention + line
+				}
+				rest[i] = line
+			}
+			rv += "\n" + strings.Join(rest, "\n")
+		}
+	}
+	if truthy(orDefault(values[1], false)) {
+		rv = indention + rv
+	}
+	return rv, nil
+}
+
+// splitLines implements Python's str.splitlines.
+func splitLines(s string) []string {
+	var lines []string
+	start := 0
+	runes := []rune(s)
+	for i := 0; i < len(runes); i++ {
+		switch runes[i] {
+		case '\n', '\r', '\v', '\f', 0x1c, 0x1d, 0x1e, 0x85, 0x2028, 0x2029:
+			lines = append(lines, string(runes[start:i]))
+			if runes[i] == '\r' && i+1 < len(runes) && runes[i+1] == '\n' {
+				i++
+			}
+			start = i + 1
+		}
+	}
+	if start < len(runes) {
+		lines = append(lines, string(runes[start:]))
+	}
+	return lines
+}
+
+func filterMap(rdr *renderer, input Value, args *callArgs) (Value, error) {
+	if !truthy(input) {
+		return &iterator{}, nil
+	}
+	items, err := iterate(input)
+	if err != nil {
+		return nil, err
+	}
+
+	var fn func(Value) (Value, error)
+	if len(args.args) == 0 {
+		values, err := args.bind("map", "attribute", "default")
+		if err != nil {
+			return nil, err
+		}
+		if _, ok := values[0].(absent); ok {
+			return nil, fmt.Errorf("map requires a filter or an attribute")
+		}
+		def := orDefault(values[1], nil)
+		fn = func(item Value) (Value, error) { return attrGetter(item, values[0], def) }
+	} else {
+		name, ok := args.args[0].(string)
+		filter := filters[name]
+		if !ok || filter == nil {
+			return nil, fmt.Errorf("%w: map with filter %v", ErrUnsupported, args.args[0])
+		}
+		rest := &callArgs{args: args.args[1:], kwNames: args.kwNames, kwArgs: args.kwArgs}
+		fn = func(item Value) (Value, error) { return filter(rdr, item, rest) }
+	}
+
+	mapped := make([]Value, len(items))
+	for i, item := range items {
+		if mapped[i], err = fn(item); err != nil {
+			return nil, err
+		}
+	}
+	return &iterator{items: mapped}, nil
+}
+
+// selectFilter implements select and reject, and selectattr and rejectattr
+// when lookupAttr is set.
+func selectFilter(lookupAttr, keep bool) filterFunc {
+	return func(_ *renderer, input Value, args *callArgs) (Value, error) {
+		if !truthy(input) {
+			return &iterator{}, nil
+		}
+		items, err := iterate(input)
+		if err != nil {
+			return nil, err
+		}
+
+		positional := args.args
+		var attribute Value
+		if lookupAttr {
+			if len(positional) == 0 {
+				return nil, fmt.Errorf("missing parameter for attribute name")
+			}
+			attribute, positional = positional[0], positional[1:]
+		}
+		var test testFunc
+		testArgs := &callArgs{kwNames: args.kwNames, kwArgs: args.kwArgs}
+		if len(positional) > 0 {
+			name, ok := positional[0].(string)
+			if test = tests[name]; !ok || test == nil {
+				return nil, fmt.Errorf("%w: test %v", ErrUnsupported, positional[0])
+			}
+			testArgs.args = positional[1:]
+		}
+
+		var selected []Value
+		for _, item := range items {
+			value := item
+			if lookupAttr {
+				if value, err = attrGetter(item, attribute, nil); err != nil {
+					return nil, err
+				}
+			}
+			ok := truthy(value)
+			if test != nil {
+				if ok, err = test(value, testArgs); err != nil {
+					return nil, err
+				}
+			}
+			if ok == keep {
+				selected = append(selected, item)
+			}
+		}
+		return &iterator{items: selected}, nil
+	}
+}
+
+// attrGetter implements Jinja's make_attrgetter: a dotted path of items,
+// with integer parts used as indices.
+func attrGetter(item, attribute, def Value) (Value, error) {
+	var parts []Value
+	if s, ok := attribute.(string); ok {
+		for _, part := range strings.Split(s, ".") {
+			if n, err := strconv.ParseInt(part, 10, 64); err == nil && isASCIIDigits(part) {
+				parts = append(parts, n)
+			} else {
+				parts = append(parts, part)
+			}
+		}
+	} else {
+		parts = []Value{attribute}
+	}
+
+	var err error
+	for _, part := range parts {
+		if item, err = getitem(item, part); err != nil {
+			return nil, err
+		}
+		if _, ok := item.(Undefined); ok && def != nil {
+			item = def
+		}
+	}
+	return item, nil
+}
+
+func isASCIIDigits(s string) bool {
+	for _, c := range s {
+		if c < '0' || c > '9' {
+			return false
+		}
+	}
+	return s != ""
+}
+
+func filterToJSON(_ *renderer, input Value, args *callArgs) (Value, error) {
+	values, err := args.bind("tojson", "ensure_ascii", "indent", "separators", "sort_keys")
+	if err != nil {
+		return nil, err
+	}
+	return dumpJSON(input, jsonOptions{
+		ensureASCII: truthy(orDefault(values[0], false)),
+		indent:      orDefault(values[1], nil),
+		separators:  orDefault(values[2], nil),
+		sortKeys:    truthy(orDefault(values[3], false)),
+	})
+}
+
+// capitalize implements Python's str.capitalize.
+func capitalize(s string) string {
+	for i, r := range s {
+		return string(unicode.ToTitle(r)) + strings.ToLower(s[i+len(string(r)):])
+	}
+	return s
+}
+
+// jinjaTitle implements Jinja's title filter, which capitalizes words
+// delimited by whitespace, dashes and opening brackets.
+func jinjaTitle(s string) string {
+	var sb strings.Builder
+	wordStart := true
+	for _, r := range s {
+		switch {
+		case isSpace(r) || strings.ContainsRune("-({[<", r):
+			sb.WriteRune(r)
+			wordStart = true
+		case wordStart:
+			sb.WriteString(strings.ToUpper(string(r)))
+			wordStart = false
+		default:
+			sb.WriteString(strings.ToLower(string(r)))
+		}
+	}
+	return sb.String()
+}
+
+func typeTest(fn func(Value) bool) testFunc {
+	return func(input Value, args *callArgs) (bool, error) {
+		if len(args.args) > 0 || len(args.kwNames) > 0 {
+			return false, fmt.Errorf("test takes no arguments")
+		}
+		return fn(input), nil
+	}
+}
+
+func compareTest(op string) testFunc {
+	return func(input Value, args *callArgs) (bool, error) {
+		values, err := args.bind("test", "other")
+		if err != nil {
+			return false, err
+		}
+		if _, ok := values[0].(absent); ok {
+			return false, fmt.Errorf("test requires an argument")
+		}
+		return compareOp(op, input, values[0])
+	}
+}
+
+func testIn(input Value, args *callArgs) (bool, error) {
+	values, err := args.bind("in", "seq")
+	if err != nil {
+		return false, err
+	}
+	if _, ok := values[0].(absent); ok {
+		return false, fmt.Errorf("test requires an argument")
+	}
+	return contains(values[0], input)
+}
+
+func testSameAs(input Value, args *callArgs) (bool, error) {
+	values, err := args.bind("sameas", "other")
+	if err != nil {
+		return false, err
+	}
+	other := values[0]
+	switch x := input.(type) {
+	case nil, bool:
+		return x == other, nil
+	case *Dict, *namespace, *macro:
+		return x == other, nil
+	}
+	return false, fmt.Errorf("%w: sameas on '%s' values", ErrUnsupported, typeName(input))
+}
+
+func parityTest(remainder int64) testFunc {
+	return func(input Value, args *callArgs) (bool, error) {
+		if _, err := args.bind("test"); err != nil {
+			return false, err
+		}
+		m, err := binaryOp("%", input, int64(2))
+		if err != nil {
+			return false, err
+		}
+		return equal(m, remainder), nil
+	}
+}
+
+func testDivisibleBy(input Value, args *callArgs) (bool, error) {
+	values, err := args.bind("divisibleby", "num")
+	if err != nil {
+		return false, err
+	}
+	m, err := binaryOp("%", input, values[0])
+	if err != nil {
+		return false, err
+	}
+	return equal(m, int64(0)), nil
+}
+
+func isCallable(v Value) bool {
+	switch v.(type) {
+	case *macro, *method, builtin:
+		return true
+	}
+	return false
+}
+
+func isIterable(v Value) bool {
+	switch v.(type) {
+	case string, []Value, Tuple, *rangeObject, *Dict, *dictView, *iterator, Undefined:
+		return true
+	}
+	return false
+}
+
+func isSequence(v Value) bool {
+	switch v.(type) {
+	case string, []Value, Tuple, *rangeObject, *Dict, Undefined:
+		return true
+	}
+	return false
+}
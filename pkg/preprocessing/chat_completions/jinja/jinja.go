@@ -0,0 +1,83 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// Package jinja renders chat templates in Go.
+//
+// It implements the subset of Jinja2 that Hugging Face chat templates use,
+// with the environment transformers renders them in: trim_blocks,
+// lstrip_blocks, the loopcontrols extension, the generation tag, and the
+// raise_exception and strftime_now globals. Output matches the Python
+// renderer byte for byte. Templates using anything outside the subset fail
+// to compile or render with ErrUnsupported, so that callers can fall back to
+// the Python renderer.
+package jinja
+
+import (
+	"errors"
+	"io"
+	"strings"
+)
+
+var (
+	// ErrUnsupported is returned for templates using Jinja features or
+	// Python behaviour this package does not implement.
+	ErrUnsupported = errors.New("unsupported by the native renderer")
+	// ErrRaised is returned when a template calls raise_exception.
+	ErrRaised = errors.New("template raised an exception")
+)
+
+// Template is a compiled chat template. It is safe for concurrent use.
+type Template struct {
+	body []node
+}
+
+// Compile parses a template source.
+func Compile(source string) (*Template, error) {
+	tokens, err := tokenize(source)
+	if err != nil {
+		return nil, err
+	}
+	body, err := parse(tokens)
+	if err != nil {
+		return nil, err
+	}
+	return &Template{body: body}, nil
+}
+
+// Render renders the template with the given variables, which are built
+// from nil, bool, int64, float64, string, []Value and *Dict values, e.g. by
+// DecodeJSON.
+func (t *Template) Render(vars map[string]Value) (string, error) {
+	var out strings.Builder
+	if err := t.RenderTo(&out, vars); err != nil {
+		return "", err
+	}
+	return out.String(), nil
+}
+
+// RenderTo renders the template like Render, writing the output to w as it
+// is produced. Rendering stops at the first error, including write errors;
+// the output written until then is partial.
+func (t *Template) RenderTo(w io.StringWriter, vars map[string]Value) error {
+	s := newScope(&scope{vars: globals})
+	for name, v := range vars {
+		s.vars[name] = v
+	}
+
+	r := &renderer{out: w}
+	_, err := r.renderNodes(t.body, s)
+	return err
+}
@@ -0,0 +1,306 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package jinja //nolint:testpackage // overrides the strftime_now clock
+
+import (
+	"errors"
+	"strings"
+	"testing"
+	"time"
+
+	"github.com/stretchr/testify/assert"
+	"github.com/stretchr/testify/require"
+)
+
+const testMessages = `{"messages": [
+	{"role": "system", "content": "You are helpful."},
+	{"role": "user", "content": "Hi there"},
+	{"role": "assistant", "content": "Hello! How can I help?"},
+	{"role": "user", "content": "What's 2+2? \"quote\" é ☃ 😀"}
+], "eos_token": "</s>"}`
+
+func render(t *testing.T, source, vars string) (string, error) {
+	t.Helper()
+	tmpl, err := Compile(source)
+	if err != nil {
+		return "", err
+	}
+
+	decoded, err := DecodeJSON([]byte(vars))
+	require.NoError(t, err)
+	dict, ok := decoded.(*Dict)
+	require.True(t, ok, "Variables should be a JSON object")
+	values := make(map[string]Value, dict.Len())
+	for i, key := range dict.keys {
+		name, ok := key.(string)
+		require.True(t, ok, "JSON keys should be strings")
+		values[name] = dict.values[i]
+	}
+	return tmpl.Render(values)
+}
+
+// TestRender tests rendering against outputs of the transformers renderer.
+func TestRender(t *testing.T) {
+	timeNow = func() time.Time { return time.Date(2024, 7, 26, 15, 4, 5, 0, time.UTC) }
+	defer func() { timeNow = time.Now }()
+
+	tests := []struct {
+		name     string
+		template string
+		vars     string
+		expected string
+	}{
+		{
+			name:     "Arithmetic",
+			template: `{{ 1 + 2 }} {{ 10/4 }} {{ 7//2 }} {{ -7 % 3 }} {{ 3**2 }} {{ 2**10 }} {{ 1e16 }} {{ 0.00001 }}`,
+			expected: "3 2.5 3 2 9 1024 1e+16 1e-05",
+		},
+		{
+			name:     "Floats",
+			template: `{{ 0.1 + 0.2 }} {{ 1e-7 }} {{ 123456789012345678.0 }} {{ 2.0 }} {{ -0.0 }} {{ 1.0/3 }} {{ 100.0 }}`,
+			expected: "0.30000000000000004 1e-07 1.2345678901234568e+17 2.0 -0.0 0.3333333333333333 100.0",
+		},
+		{
+			name: "Python reprs",
+			template: `{{ 'a' ~ 1 ~ none ~ true }}|{{ [1,'a',none,true,1.0] }}` +
+				`|{{ {'a':1,'b':[2]} }}|{{ (1,) }}|{{ ['a\'b', "c\"d", 'é\n'] }}`,
+			expected: `a1NoneTrue|[1, 'a', None, True, 1.0]|{'a': 1, 'b': [2]}|(1,)|["a'b", 'c"d', 'é\n']`,
+		},
+		{
+			name:     "Loop",
+			template: `{% for m in messages %}{{ loop.index }}:{{ m.role|upper }}{% if not loop.last %},{% endif %}{% endfor %}`,
+			vars:     testMessages,
+			expected: "1:SYSTEM,2:USER,3:ASSISTANT,4:USER",
+		},
+		{
+			name: "Whitespace control",
+			template: "{%- for m in messages %}\n  {%- if m.role == 'system' %}\n    {{- '<<SYS>>' + m.content + '<</SYS>>' }}\n" +
+				"  {%- else %}\n{{ m.content }}\n  {% endif %}\n{% endfor %}\n",
+			vars:     testMessages,
+			expected: "<<SYS>>You are helpful.<</SYS>>Hi there\nHello! How can I help?\nWhat's 2+2? \"quote\" é ☃ 😀\n",
+		},
+		{
+			name:     "Trim and lstrip blocks",
+			template: "  {% if true %}\n    yes\n  {% endif %}\n  {#- comment #}  \n{{- ' x' }}  {{ 'y' -}}  \n  z\n",
+			expected: "    yes\n x  yz",
+		},
+		{
+			name: "Namespace",
+			template: `{% set ns = namespace(found=false, n=0) %}{% for m in messages %}{% if m.role == 'user' %}` +
+				`{% set ns.found = true %}{% set ns.n = ns.n + 1 %}{% endif %}{% endfor %}{{ ns.found }} {{ ns.n }}`,
+			vars:     testMessages,
+			expected: "True 2",
+		},
+		{
+			name:     "Loop scoping",
+			template: `{% set i = 0 %}{% for m in messages %}{% set i = loop.index %}{% endfor %}{{ i }}`,
+			vars:     testMessages,
+			expected: "0",
+		},
+		{
+			name: "Loop controls",
+			template: `{% for x in range(5) %}{% if x == 1 %}{% continue %}{% endif %}` +
+				`{% if x == 3 %}{% break %}{% endif %}{{ x }}{% endfor %}`,
+			expected: "02",
+		},
+		{
+			name: "Loop else and filter",
+			template: `{% for a, b in [[1,2],[3,4]] %}{{ a + b }}{% else %}` +
+				`empty{% endfor %}{% for x in [] %}x{% else %}empty{% endfor %}` +
+				`{% for x in [1,2,3,4] if x is even %}{{ x }}{{ loop.length }}{% endfor %}`,
+			expected: "37empty2242",
+		},
+		{
+			name:     "Loop attributes",
+			template: `{% for x in 'abc' %}{{ loop.previtem }}{{ loop.nextitem }}{{ loop.cycle('o','e') }}{{ loop.revindex }}{% endfor %}`,
+			expected: "bo3ace2bo1",
+		},
+		{
+			name: "Filters",
+			template: `{{ messages|map(attribute='role')|join(',') }}|{{ messages|selectattr('role','equalto','user')|list|length }}|` +
+				`{{ messages|rejectattr('role','==','user')|map(attribute='content')|first }}`,
+			vars:     testMessages,
+			expected: "system,user,assistant,user|2|You are helpful.",
+		},
+		{
+			name: "More filters",
+			template: `{{ [3,1,2]|reverse|list }}{{ 'abc'|reverse }}{{ [1,2]|last }}{{ ' x '|trim }}{{ 'ab cd'|capitalize }}` +
+				`{{ 12.7|int }}{{ '3'|int + 1 }}{{ '1.5'|float }}{{ -3|abs }}{{ {'a':1}|items|list }}{{ 'hé-llo wor(ld'|title }}`,
+			expected: "[2, 1, 3]cba2xAb cd1241.53[('a', 1)]Hé-Llo Wor(Ld",
+		},
+		{
+			name: "Defaults",
+			template: `{{ y | default('dflt') }}{{ none | default('n', true) }}` +
+				`{{ '' | d('e', true) }}{{ z|length if z is defined else 0 }}`,
+			expected: "dfltne0",
+		},
+		{
+			name: "Tests",
+			template: `{{ x is defined }}{{ y is defined }}{{ y is none }}{{ x is string }}{{ 3 is odd }}{{ 4 is divisibleby 2 }}` +
+				`{{ x is not none }}{{ [1] is sequence }}{{ d is mapping }}{{ 1.0 is float }}{{ 1 is integer }}{{ z is undefined }}`,
+			vars:     `{"x": "s", "y": null, "d": {}}`,
+			expected: "TrueTrueTrueTrueTrueTrueTrueTrueTrueTrueTrueTrue",
+		},
+		{
+			name: "Comparisons",
+			template: `{{ 1 < 2 < 3 }}{{ 3 > 2 > 5 }}{{ 'a' in 'abc' }}{{ 2 not in [1] }}{{ 1 == 1.0 }}{{ {1:'a'}[1.0] }}` +
+				`{{ (1,2) == [1,2] }}{{ [1,2] < [1,3] }}`,
+			expected: "TrueFalseTrueTrueTrueaFalseTrue",
+		},
+		{
+			name: "Subscripts and slices",
+			template: `{{ messages[1:]|length }}|{{ messages[-1].content[:5] }}` +
+				`|{{ 'abcdef'[::-1] }}|{{ 'abcdef'[1:5:2] }}|{{ d.missing }}`,
+			vars:     `{"messages": [{}, {}, {"content": "What's up"}], "d": {}}`,
+			expected: "2|What'|fedcba|bd|",
+		},
+		{
+			name: "String methods",
+			template: `{{ 'Hello World'.split() }}{{ ' a  b '.split(' ') }}{{ 'a,b,c'.split(',', 1) }}{{ 'xxhixx'.strip('x') }}` +
+				`{{ 'hello'.endswith(('x','lo')) }}{{ 'hello world'.title() }}{{ 'abc'.find('c') }}`,
+			expected: "['Hello', 'World']['', 'a', '', 'b', '']['a', 'b,c']hiTrueHello World2",
+		},
+		{
+			name: "Dict methods",
+			template: `{{ d.get('a') }}{{ d.get('z', 5) }}{{ d.keys()|list }}` +
+				`{% for k, v in d.items() %}{{ k }}={{ v }};{% endfor %}{{ d.items() }}`,
+			vars:     `{"d": {"a": 1, "b": "x"}}`,
+			expected: "15['a', 'b']a=1;b=x;dict_items([('a', 1), ('b', 'x')])",
+		},
+		{
+			name: "Set",
+			template: `{% set content %}captured {{ 1 }}{% endset %}[{{ content }}` +
+				`]{% set a, b = 1, 2 %}{{ a }}{{ b }}{% set t = 1, 2 %}{{ t }}`,
+			expected: "[captured 1]12(1, 2)",
+		},
+		{
+			name:     "Macros",
+			template: `{% macro m(a, b=a) %}{{ a }}{{ b }}{{ c }}{% endmacro %}{% set c = 'C' %}{{ m(1) }}{{ m(1, 2) }}{{ m(b=3, a=4) }}`,
+			expected: "11C12C43C",
+		},
+		{
+			name: "JSON",
+			template: `{{ tools|tojson }}|{{ tools|tojson(indent=2) }}|{{ {'a':'é','b':[1,2.5,none,true]}|tojson(ensure_ascii=true) }}|` +
+				`{{ {'b':1,'a':2}|tojson(sort_keys=true) }}` +
+				`|{{ tools|tojson(separators=(',', ':')) }}|{{ '😀\x01'|tojson(ensure_ascii=true) }}`,
+			vars: `{"tools": [{"name": "get", "parameters": {}}]}`,
+			expected: "[{\"name\": \"get\", \"parameters\": {}}]|[\n  {\n    \"name\": \"get\",\n    \"parameters\": {}\n  }\n]|" +
+				`{"a": "\u00e9", "b": [1, 2.5, null, true]}|{"a": 2, "b": 1}|[{"name":"get","parameters":{}}]|"\ud83d\ude00\u0001"`,
+		},
+		{
+			name:     "Globals",
+			template: `{{ strftime_now('%d %b %Y %H:%M:%S %A %j %p %I') }}|{{ range(5,0,-2)|list }}{{ dict(a=1) }}`,
+			expected: "26 Jul 2024 15:04:05 Friday 208 PM 03|[5, 3, 1]{'a': 1}",
+		},
+		{
+			name: "Ranges",
+			template: `{{ range(3) }}|{{ range(1, 7, 2) }}|{{ range(3)|string }}|{{ range(3)|length }}|{{ range(3)[-1] }}|` +
+				`{{ 2 in range(3) }}|{{ range(3) == range(0, 3) }}|{{ range(3) == [0, 1, 2] }}|{{ range(3).stop }}|` +
+				`{{ range(0) is sequence }}{% if not range(0) %}|empty{% endif %}|{{ range(3)|join(',') }}|{{ range(3)|list }}`,
+			expected: "range(0, 3)|range(1, 7, 2)|range(0, 3)|3|2|True|True|False|3|True|empty|0,1,2|[0, 1, 2]",
+		},
+		{
+			name:     "Generation tag",
+			template: `{% generation %}gen {{ 1 }}{% endgeneration %}`,
+			expected: "gen 1",
+		},
+	}
+
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			vars := tt.vars
+			if vars == "" {
+				vars = "{}"
+			}
+			rendered, err := render(t, tt.template, vars)
+			require.NoError(t, err)
+			assert.Equal(t, tt.expected, rendered)
+		})
+	}
+}
+
+// TestRenderErrors tests that template errors and unsupported features are
+// reported, the latter with ErrUnsupported.
+func TestRenderErrors(t *testing.T) {
+	tests := []struct {
+		name        string
+		template    string
+		unsupported bool
+	}{
+		{name: "Raised exception", template: `{{ raise_exception('bad role') }}`},
+		{name: "Undefined attribute", template: `{{ x.y.z }}`},
+		{name: "Division by zero", template: `{{ 1/0 }}`},
+		{name: "Syntax error", template: `{% for x in %}{% endfor %}`},
+		{name: "Unclosed block", template: `{% if true %}`},
+		{name: "Big integers", template: `{{ 9999999999 * 9999999999 }}`, unsupported: true},
+		{name: "Raw block", template: `{% raw %}{{ x }}{% endraw %}`, unsupported: true},
+		{name: "Unknown filter", template: `{{ x | nonexistent }}`, unsupported: true},
+		{name: "String formatting", template: `{{ '{:d}'.format(1) }}`, unsupported: true},
+		{name: "Special casing", template: `{{ 'ß'|upper }}`, unsupported: true},
+		{name: "Range slicing", template: `{{ range(5)[1:3] }}`, unsupported: true},
+	}
+
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			_, err := render(t, tt.template, `{"x": {}}`)
+			require.Error(t, err)
+			assert.Equal(t, tt.unsupported, errors.Is(err, ErrUnsupported), "Unexpected error: %v", err)
+		})
+	}
+}
+
+// failingWriter collects writes until its limit, then fails.
+type failingWriter struct {
+	writes []string
+	limit  int
+}
+
+var errWriteFailed = errors.New("write failed")
+
+func (w *failingWriter) WriteString(s string) (int, error) {
+	if len(w.writes) == w.limit {
+		return 0, errWriteFailed
+	}
+	w.writes = append(w.writes, s)
+	return len(s), nil
+}
+
+// TestRenderTo tests that RenderTo writes the output as it renders and stops
+// at the first write error.
+func TestRenderTo(t *testing.T) {
+	tmpl, err := Compile(`{% for message in messages %}<{{ message.role }}>{{ message.content }}{% endfor %}`)
+	require.NoError(t, err)
+	messages := []Value{}
+	for _, role := range []string{"user", "assistant", "user"} {
+		message := NewDict()
+		message.Set("role", role)
+		message.Set("content", "hi")
+		messages = append(messages, message)
+	}
+	vars := map[string]Value{"messages": messages}
+
+	out := &failingWriter{limit: -1}
+	require.NoError(t, tmpl.RenderTo(out, vars))
+	rendered, err := tmpl.Render(vars)
+	require.NoError(t, err)
+	assert.Equal(t, rendered, strings.Join(out.writes, ""), "Writes should add up to the render")
+	assert.Greater(t, len(out.writes), 1, "Output should be written as it renders")
+
+	out = &failingWriter{limit: 2}
+	assert.ErrorIs(t, tmpl.RenderTo(out, vars), errWriteFailed)
+	assert.Len(t, out.writes, 2, "Rendering should stop at the failed write")
+}
@@ -0,0 +1,254 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package jinja
+
+import (
+	"fmt"
+	"math"
+	"sort"
+	"strconv"
+	"strings"
+	"unicode/utf16"
+)
+
+// jsonOptions are the arguments of Python's json.dumps that the transformers
+// tojson filter forwards.
+type jsonOptions struct {
+	ensureASCII bool
+	indent      Value // nil, an int or a string
+	separators  Value // nil or a pair of strings
+	sortKeys    bool
+}
+
+// jsonEncoder writes values byte-for-byte like Python's json.dumps.
+type jsonEncoder struct {
+	sb            strings.Builder
+	opts          jsonOptions
+	indent        string
+	pretty        bool
+	itemSeparator string
+	keySeparator  string
+}
+
+func dumpJSON(value Value, opts jsonOptions) (Value, error) {
+	enc := &jsonEncoder{opts: opts, itemSeparator: ", ", keySeparator: ": "}
+
+	switch indent := opts.indent.(type) {
+	case nil:
+	case string:
+		enc.pretty, enc.indent = true, indent
+	default:
+		n, _, isFloat, ok := toNumber(indent)
+		if !ok || isFloat {
+			return nil, fmt.Errorf("%w: json indent of type '%s'", ErrUnsupported, typeName(indent))
+		}
+		enc.pretty, enc.indent = true, strings.Repeat(" ", int(max(n, 0)))
+	}
+	if enc.pretty {
+		enc.itemSeparator = ","
+	}
+
+	if opts.separators != nil {
+		items, err := iterate(opts.separators)
+		if err != nil {
+			return nil, err
+		}
+		if len(items) != 2 {
+			return nil, fmt.Errorf("json separators must be a pair")
+		}
+		var ok1, ok2 bool
+		enc.itemSeparator, ok1 = items[0].(string)
+		enc.keySeparator, ok2 = items[1].(string)
+		if !ok1 || !ok2 {
+			return nil, fmt.Errorf("json separators must be strings")
+		}
+	}
+
+	if err := enc.encode(value, 0); err != nil {
+		return nil, err
+	}
+	return enc.sb.String(), nil
+}
+
+func (e *jsonEncoder) encode(value Value, depth int) error {
+	switch x := value.(type) {
+	case nil:
+		e.sb.WriteString("null")
+	case bool:
+		if x {
+			e.sb.WriteString("true")
+		} else {
+			e.sb.WriteString("false")
+		}
+	case int64:
+		e.sb.WriteString(strconv.FormatInt(x, 10))
+	case float64:
+		e.sb.WriteString(jsonFloat(x))
+	case string:
+		e.writeString(x)
+	case []Value:
+		return e.encodeList(x, depth)
+	case Tuple:
+		return e.encodeList(x, depth)
+	case *Dict:
+		return e.encodeDict(x, depth)
+	default:
+		return fmt.Errorf("object of type %s is not JSON serializable", typeName(value))
+	}
+	return nil
+}
+
+func (e *jsonEncoder) newline(depth int) {
+	if e.pretty {
+		e.sb.WriteByte('\n')
+		e.sb.WriteString(strings.Repeat(e.indent, depth))
+	}
+}
+
+func (e *jsonEncoder) encodeList(items []Value, depth int) error {
+	if len(items) == 0 {
+		e.sb.WriteString("[]")
+		return nil
+	}
+	e.sb.WriteByte('[')
+	for i, item := range items {
+		if i > 0 {
+			e.sb.WriteString(e.itemSeparator)
+		}
+		e.newline(depth + 1)
+		if err := e.encode(item, depth+1); err != nil {
+			return err
+		}
+	}
+	e.newline(depth)
+	e.sb.WriteByte(']')
+	return nil
+}
+
+func (e *jsonEncoder) encodeDict(dict *Dict, depth int) error {
+	if dict.Len() == 0 {
+		e.sb.WriteString("{}")
+		return nil
+	}
+
+	order := make([]int, dict.Len())
+	for i := range order {
+		order[i] = i
+	}
+	if e.opts.sortKeys {
+		keys := make([]string, len(dict.keys))
+		for i, key := range dict.keys {
+			str, ok := key.(string)
+			if !ok {
+				return fmt.Errorf("%w: sort_keys with non-string keys", ErrUnsupported)
+			}
+			keys[i] = str
+		}
+		sort.SliceStable(order, func(i, j int) bool { return keys[order[i]] < keys[order[j]] })
+	}
+
+	e.sb.WriteByte('{')
+	for n, i := range order {
+		if n > 0 {
+			e.sb.WriteString(e.itemSeparator)
+		}
+		e.newline(depth + 1)
+		key, err := jsonKey(dict.keys[i])
+		if err != nil {
+			return err
+		}
+		e.writeString(key)
+		e.sb.WriteString(e.keySeparator)
+		if err := e.encode(dict.values[i], depth+1); err != nil {
+			return err
+		}
+	}
+	e.newline(depth)
+	e.sb.WriteByte('}')
+	return nil
+}
+
+// jsonKey converts a dict key the way json.dumps does.
+func jsonKey(key Value) (string, error) {
+	switch k := key.(type) {
+	case string:
+		return k, nil
+	case nil, bool, int64, float64:
+		e := jsonEncoder{}
+		if err := e.encode(k, 0); err != nil {
+			return "", err
+		}
+		return e.sb.String(), nil
+	}
+	return "", fmt.Errorf("keys must be str, int, float, bool or None, not %s", typeName(key))
+}
+
+func jsonFloat(f float64) string {
+	switch {
+	case math.IsNaN(f):
+		return "NaN"
+	case math.IsInf(f, 1):
+		return "Infinity"
+	case math.IsInf(f, -1):
+		return "-Infinity"
+	}
+	return formatFloat(f)
+}
+
+func (e *jsonEncoder) writeString(s string) {
+	const hex = "0123456789abcdef"
+	writeEscape := func(r rune) {
+		e.sb.WriteString(`\u`)
+		for shift := 12; shift >= 0; shift -= 4 {
+			e.sb.WriteByte(hex[(r>>shift)&0xf])
+		}
+	}
+
+	e.sb.WriteByte('"')
+	for _, char := range s {
+		switch char {
+		case '"':
+			e.sb.WriteString(`\"`)
+		case '\\':
+			e.sb.WriteString(`\\`)
+		case '\n':
+			e.sb.WriteString(`\n`)
+		case '\r':
+			e.sb.WriteString(`\r`)
+		case '\t':
+			e.sb.WriteString(`\t`)
+		case '\b':
+			e.sb.WriteString(`\b`)
+		case '\f':
+			e.sb.WriteString(`\f`)
+		default:
+			switch {
+			case char < 0x20:
+				writeEscape(char)
+			case !e.opts.ensureASCII || char < 0x7f:
+				e.sb.WriteRune(char)
+			case char > 0xffff:
+				r1, r2 := utf16.EncodeRune(char)
+				writeEscape(r1)
+				writeEscape(r2)
+			default:
+				writeEscape(char)
+			}
+		}
+	}
+	e.sb.WriteByte('"')
+}
@@ -0,0 +1,448 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package jinja
+
+import (
+	"fmt"
+	"strconv"
+	"strings"
+	"unicode"
+	"unicode/utf8"
+)
+
+type tokenKind int
+
+const (
+	tokenData tokenKind = iota
+	tokenVariableBegin
+	tokenVariableEnd
+	tokenBlockBegin
+	tokenBlockEnd
+	tokenName
+	tokenString
+	tokenInteger
+	tokenFloat
+	tokenOperator
+	tokenEOF
+)
+
+type token struct {
+	kind  tokenKind
+	value string // text, name, operator, decoded string or number literal
+	line  int
+}
+
+// operators lists the Jinja operators, longest first.
+var operators = []string{
+	"//", "**", "==", "!=", "<=", ">=",
+	"+", "-", "/", "*", "%", "~", "[", "]", "(", ")", "{", "}",
+	">", "<", "=", ".", ":", "|", ",", ";",
+}
+
+// lexer splits a template into tokens the way Jinja does with the
+// transformers environment settings: trim_blocks and lstrip_blocks enabled,
+// keep_trailing_newline disabled and "\n" as the newline sequence.
+type lexer struct {
+	src    string
+	pos    int
+	line   int
+	tokens []token
+}
+
+func tokenize(source string) ([]token, error) {
+	source = strings.ReplaceAll(source, "\r\n", "\n")
+	source = strings.ReplaceAll(source, "\r", "\n")
+	source = strings.TrimSuffix(source, "\n")
+
+	l := &lexer{src: source, line: 1}
+	if err := l.run(); err != nil {
+		return nil, err
+	}
+	l.emit(tokenEOF, "")
+	return l.tokens, nil
+}
+
+func (l *lexer) emit(kind tokenKind, value string) {
+	l.tokens = append(l.tokens, token{kind: kind, value: value, line: l.line})
+}
+
+func (l *lexer) errorf(format string, args ...interface{}) error {
+	return fmt.Errorf("line %d: %s", l.line, fmt.Sprintf(format, args...))
+}
+
+func (l *lexer) run() error {
+	// lineStarting is whether the text before the next tag starts a line,
+	// which lstrip_blocks needs when that text holds no newline.
+	lineStarting := true
+
+	for l.pos < len(l.src) {
+		start := nextTagStart(l.src, l.pos)
+		if start < 0 {
+			l.emitData(l.src[l.pos:])
+			return nil
+		}
+
+		text := l.src[l.pos:start]
+		kind := l.src[start+1]
+		sign := byte(0)
+		tagEnd := start + 2
+		if tagEnd < len(l.src) && (l.src[tagEnd] == '-' || l.src[tagEnd] == '+') {
+			sign = l.src[tagEnd]
+			tagEnd++
+		}
+
+		switch {
+		case sign == '-':
+			text = strings.TrimRightFunc(text, isSpace)
+		case sign != '+' && kind != '{':
+			lineStart := strings.LastIndexByte(text, '\n') + 1
+			if lineStart > 0 || lineStarting {
+				if rest := text[lineStart:]; rest != "" && strings.TrimLeftFunc(rest, isSpace) == "" {
+					text = text[:lineStart]
+				}
+			}
+		}
+		l.emitData(text)
+		l.line += strings.Count(l.src[l.pos:start], "\n")
+		l.pos = tagEnd
+
+		var err error
+		switch kind {
+		case '#':
+			lineStarting, err = l.lexComment()
+		case '%':
+			if isRawBlock(l.src[l.pos:]) {
+				return fmt.Errorf("line %d: %w: raw blocks", l.line, ErrUnsupported)
+			}
+			l.emit(tokenBlockBegin, "")
+			lineStarting, err = l.lexTag("%}")
+		default:
+			l.emit(tokenVariableBegin, "")
+			lineStarting, err = l.lexTag("}}")
+		}
+		if err != nil {
+			return err
+		}
+	}
+
+	return nil
+}
+
+func (l *lexer) emitData(text string) {
+	if text != "" {
+		l.emit(tokenData, text)
+	}
+}
+
+// nextTagStart returns the index of the next "{{", "{%" or "{#" at or after
+// pos, or -1.
+func nextTagStart(src string, pos int) int {
+	for {
+		i := strings.IndexByte(src[pos:], '{')
+		if i < 0 || pos+i+1 >= len(src) {
+			return -1
+		}
+		pos += i
+		if c := src[pos+1]; c == '{' || c == '%' || c == '#' {
+			return pos
+		}
+		pos++
+	}
+}
+
+func isRawBlock(rest string) bool {
+	rest = strings.TrimLeftFunc(rest, isSpace)
+	if !strings.HasPrefix(rest, "raw") {
+		return false
+	}
+	r, _ := utf8.DecodeRuneInString(rest[len("raw"):])
+	return !isNameRune(r)
+}
+
+// lexComment skips a comment and the whitespace its end marker strips. It
+// returns whether the consumed input ends with a newline.
+func (l *lexer) lexComment() (bool, error) {
+	contentStart := l.pos
+	end := strings.Index(l.src[l.pos:], "#}")
+	if end < 0 {
+		return false, l.errorf("missing end of comment tag")
+	}
+	end += l.pos
+
+	l.line += strings.Count(l.src[l.pos:end], "\n")
+	l.pos = end + len("#}")
+	sign := byte(0)
+	if end > contentStart {
+		sign = l.src[end-1]
+	}
+	return l.trimAfterTag(sign, true), nil
+}
+
+// trimAfterTag applies the whitespace control of an end marker preceded by
+// sign, and returns whether the consumed input ends with a newline.
+func (l *lexer) trimAfterTag(sign byte, trimBlock bool) bool {
+	switch {
+	case sign == '-':
+		start := l.pos
+		for l.pos < len(l.src) {
+			r, size := utf8.DecodeRuneInString(l.src[l.pos:])
+			if !isSpace(r) {
+				break
+			}
+			l.pos += size
+		}
+		l.line += strings.Count(l.src[start:l.pos], "\n")
+		return l.pos > start && l.src[l.pos-1] == '\n'
+	case sign != '+' && trimBlock && l.pos < len(l.src) && l.src[l.pos] == '\n':
+		l.pos++
+		l.line++
+		return true
+	}
+	return false
+}
+
+// lexTag lexes the expression tokens of a block or variable tag up to its end
+// marker.
+func (l *lexer) lexTag(endMarker string) (bool, error) {
+	endKind := tokenVariableEnd
+	if endMarker == "%}" {
+		endKind = tokenBlockEnd
+	}
+
+	depth := 0
+	for {
+		l.skipSpace()
+		if l.pos >= len(l.src) {
+			return false, l.errorf("unexpected end of template, expected %q", endMarker)
+		}
+
+		// End markers are only recognized outside of brackets, like Jinja's
+		// balancing stack does.
+		if depth == 0 {
+			rest := l.src[l.pos:]
+			sign := byte(0)
+			if len(rest) > 0 && (rest[0] == '-' || (rest[0] == '+' && endKind == tokenBlockEnd)) {
+				sign = rest[0]
+				rest = rest[1:]
+			}
+			if strings.HasPrefix(rest, endMarker) {
+				l.pos += len(endMarker)
+				if sign != 0 {
+					l.pos++
+				}
+				l.emit(endKind, "")
+				return l.trimAfterTag(sign, endKind == tokenBlockEnd), nil
+			}
+		}
+
+		c := l.src[l.pos]
+		switch {
+		case c == '\'' || c == '"':
+			if err := l.lexString(c); err != nil {
+				return false, err
+			}
+		case c >= '0' && c <= '9':
+			l.lexNumber()
+		case isNameStart(l.src[l.pos:]):
+			l.lexName()
+		default:
+			op := ""
+			for _, candidate := range operators {
+				if strings.HasPrefix(l.src[l.pos:], candidate) {
+					op = candidate
+					break
+				}
+			}
+			if op == "" {
+				return false, l.errorf("unexpected character %q", c)
+			}
+			switch op {
+			case "(", "[", "{":
+				depth++
+			case ")", "]", "}":
+				if depth == 0 {
+					return false, l.errorf("unexpected %q", op)
+				}
+				depth--
+			}
+			l.pos += len(op)
+			l.emit(tokenOperator, op)
+		}
+	}
+}
+
+func (l *lexer) skipSpace() {
+	for l.pos < len(l.src) {
+		r, size := utf8.DecodeRuneInString(l.src[l.pos:])
+		if !isSpace(r) {
+			return
+		}
+		if r == '\n' {
+			l.line++
+		}
+		l.pos += size
+	}
+}
+
+func isNameStart(s string) bool {
+	r, _ := utf8.DecodeRuneInString(s)
+	return r == '_' || unicode.IsLetter(r)
+}
+
+func isNameRune(r rune) bool {
+	return r == '_' || unicode.IsLetter(r) || unicode.IsDigit(r)
+}
+
+func (l *lexer) lexName() {
+	start := l.pos
+	for l.pos < len(l.src) {
+		r, size := utf8.DecodeRuneInString(l.src[l.pos:])
+		if !isNameRune(r) {
+			break
+		}
+		l.pos += size
+	}
+	l.emit(tokenName, l.src[start:l.pos])
+}
+
+// lexNumber lexes a decimal integer or float literal. Underscores between
+// digits are allowed and dropped.
+func (l *lexer) lexNumber() {
+	start := l.pos
+	l.skipDigits()
+	kind := tokenInteger
+
+	// A number right after a dot is an attribute index (`foo.0.1`), never a
+	// float.
+	afterDot := start > 0 && l.src[start-1] == '.'
+	if !afterDot && l.pos+1 < len(l.src) && l.src[l.pos] == '.' && isDigit(l.src[l.pos+1]) {
+		l.pos++
+		l.skipDigits()
+		kind = tokenFloat
+	}
+	if !afterDot && l.pos < len(l.src) && (l.src[l.pos] == 'e' || l.src[l.pos] == 'E') {
+		exp := l.pos + 1
+		if exp < len(l.src) && (l.src[exp] == '+' || l.src[exp] == '-') {
+			exp++
+		}
+		if exp < len(l.src) && isDigit(l.src[exp]) {
+			l.pos = exp
+			l.skipDigits()
+			kind = tokenFloat
+		}
+	}
+
+	l.emit(kind, strings.ReplaceAll(l.src[start:l.pos], "_", ""))
+}
+
+func (l *lexer) skipDigits() {
+	for l.pos < len(l.src) {
+		c := l.src[l.pos]
+		if !isDigit(c) && (c != '_' || l.pos+1 >= len(l.src) || !isDigit(l.src[l.pos+1])) {
+			return
+		}
+		l.pos++
+	}
+}
+
+func isDigit(c byte) bool {
+	return c >= '0' && c <= '9'
+}
+
+// lexString lexes a quoted string literal and decodes its escapes like
+// Python's "unicode-escape" codec, which is what Jinja uses.
+func (l *lexer) lexString(quote byte) error {
+	var sb strings.Builder
+	end := l.pos + 1
+	for {
+		if end >= len(l.src) {
+			return l.errorf("unterminated string")
+		}
+		c := l.src[end]
+		if c == quote {
+			break
+		}
+		if c != '\\' || end+1 >= len(l.src) {
+			sb.WriteByte(c)
+			end++
+			continue
+		}
+
+		consumed, err := decodeEscape(&sb, l.src[end+1:])
+		if err != nil {
+			return l.errorf("%v", err)
+		}
+		end += 1 + consumed
+	}
+
+	l.line += strings.Count(l.src[l.pos:end], "\n")
+	l.pos = end + 1
+	l.emit(tokenString, sb.String())
+	return nil
+}
+
+// decodeEscape decodes the escape sequence following a backslash and returns
+// the number of bytes it spans.
+func decodeEscape(sb *strings.Builder, rest string) (int, error) {
+	switch char := rest[0]; char {
+	case '\n':
+		return 1, nil
+	case '\\', '\'', '"':
+		sb.WriteByte(char)
+	case 'a':
+		sb.WriteByte('\a')
+	case 'b':
+		sb.WriteByte('\b')
+	case 'f':
+		sb.WriteByte('\f')
+	case 'n':
+		sb.WriteByte('\n')
+	case 'r':
+		sb.WriteByte('\r')
+	case 't':
+		sb.WriteByte('\t')
+	case 'v':
+		sb.WriteByte('\v')
+	case 'x', 'u', 'U':
+		digits := map[byte]int{'x': 2, 'u': 4, 'U': 8}[char]
+		if len(rest) < 1+digits {
+			return 0, fmt.Errorf("truncated \\%c escape", char)
+		}
+		code, err := strconv.ParseUint(rest[1:1+digits], 16, 32)
+		if err != nil || code > unicode.MaxRune {
+			return 0, fmt.Errorf("invalid \\%c escape", char)
+		}
+		sb.WriteRune(rune(code))
+		return 1 + digits, nil
+	case 'N':
+		return 0, fmt.Errorf("%w: \\N escapes", ErrUnsupported)
+	default:
+		if char >= '0' && char <= '7' {
+			n := 1
+			for n < 3 && n < len(rest) && rest[n] >= '0' && rest[n] <= '7' {
+				n++
+			}
+			code, _ := strconv.ParseUint(rest[:n], 8, 32)
+			sb.WriteRune(rune(code))
+			return n, nil
+		}
+		// Unknown escapes are kept as they are.
+		sb.WriteByte('\\')
+		return 0, nil
+	}
+	return 1, nil
+}
@@ -0,0 +1,477 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package jinja
+
+import (
+	"fmt"
+	"strings"
+	"time"
+	"unicode"
+)
+
+// The methods of Python builtin types. Accessing any of them yields a method
+// value, so that templates see the same attributes as in Python, but only
+// some can be called; see callMethod.
+var (
+	strMethods = nameSet("capitalize", "casefold", "center", "count", "encode", "endswith", "expandtabs",
+		"find", "format", "format_map", "index", "isalnum", "isalpha", "isascii", "isdecimal", "isdigit",
+		"isidentifier", "islower", "isnumeric", "isprintable", "isspace", "istitle", "isupper", "join",
+		"ljust", "lower", "lstrip", "maketrans", "partition", "removeprefix", "removesuffix", "replace",
+		"rfind", "rindex", "rjust", "rpartition", "rsplit", "rstrip", "split", "splitlines", "startswith",
+		"strip", "swapcase", "title", "translate", "upper", "zfill")
+	dictMethods = nameSet("clear", "copy", "fromkeys", "get", "items", "keys", "pop", "popitem",
+		"setdefault", "update", "values")
+	listMethods = nameSet("append", "clear", "copy", "count", "extend", "index", "insert", "pop",
+		"remove", "reverse", "sort")
+)
+
+func nameSet(names ...string) map[string]bool {
+	set := make(map[string]bool, len(names))
+	for _, name := range names {
+		set[name] = true
+	}
+	return set
+}
+
+// timeNow is the clock of strftime_now.
+var timeNow = time.Now
+
+// globals are the global functions of the transformers environment.
+var globals = map[string]Value{
+	"range":     builtin(globalRange),
+	"dict":      builtin(globalDict),
+	"namespace": builtin(globalNamespace),
+	"raise_exception": builtin(func(_ *renderer, args *callArgs) (Value, error) {
+		values, err := args.bind("raise_exception", "message")
+		if err != nil {
+			return nil, err
+		}
+		message, err := toString(orDefault(values[0], Undefined{}))
+		if err != nil {
+			return nil, err
+		}
+		return nil, fmt.Errorf("%w: %s", ErrRaised, message)
+	}),
+	"strftime_now": builtin(func(_ *renderer, args *callArgs) (Value, error) {
+		values, err := args.bind("strftime_now", "format_str")
+		if err != nil {
+			return nil, err
+		}
+		format, ok := values[0].(string)
+		if !ok {
+			return nil, fmt.Errorf("strftime_now() requires a format string")
+		}
+		return strftime(timeNow(), format)
+	}),
+}
+
+// maxRange is the largest range the sandboxed environment allows.
+const maxRange = 100000
+
+func globalRange(_ *renderer, args *callArgs) (Value, error) {
+	if len(args.kwNames) > 0 || len(args.args) == 0 || len(args.args) > 3 {
+		return nil, fmt.Errorf("range expected 1 to 3 positional arguments")
+	}
+	var bounds [3]int64
+	for i, arg := range args.args {
+		n, _, isFloat, ok := toNumber(arg)
+		if !ok || isFloat {
+			return nil, fmt.Errorf("'%s' object cannot be interpreted as an integer", typeName(arg))
+		}
+		bounds[i] = n
+	}
+
+	start, stop, step := int64(0), bounds[0], int64(1)
+	if len(args.args) > 1 {
+		start, stop = bounds[0], bounds[1]
+	}
+	if len(args.args) > 2 {
+		step = bounds[2]
+	}
+	if step == 0 {
+		return nil, fmt.Errorf("range() arg 3 must not be zero")
+	}
+
+	var items []Value
+	for i := start; (step > 0 && i < stop) || (step < 0 && i > stop); i += step {
+		if len(items) == maxRange {
+			return nil, fmt.Errorf("range too big, maximum size for range is %d", maxRange)
+		}
+		items = append(items, i)
+	}
+	return &rangeObject{start: start, stop: stop, step: step, items: items}, nil
+}
+
+func globalDict(_ *renderer, args *callArgs) (Value, error) {
+	if len(args.args) > 0 {
+		return nil, fmt.Errorf("%w: dict() with positional arguments", ErrUnsupported)
+	}
+	d := NewDict()
+	for i, name := range args.kwNames {
+		d.Set(name, args.kwArgs[i])
+	}
+	return d, nil
+}
+
+func globalNamespace(_ *renderer, args *callArgs) (Value, error) {
+	attrs := NewDict()
+	switch len(args.args) {
+	case 0:
+	case 1:
+		d, ok := args.args[0].(*Dict)
+		if !ok {
+			return nil, fmt.Errorf("%w: namespace() from '%s'", ErrUnsupported, typeName(args.args[0]))
+		}
+		for i, key := range d.keys {
+			if err := attrs.put(key, d.values[i]); err != nil {
+				return nil, err
+			}
+		}
+	default:
+		return nil, fmt.Errorf("namespace expected at most 1 positional argument")
+	}
+	for i, name := range args.kwNames {
+		attrs.Set(name, args.kwArgs[i])
+	}
+	return &namespace{attrs: attrs}, nil
+}
+
+// callMethod calls a method of a Python builtin type.
+func callMethod(m *method, args *callArgs) (Value, error) {
+	switch recv := m.recv.(type) {
+	case string:
+		return callStrMethod(recv, m.name, args)
+	case *Dict:
+		return callDictMethod(recv, m.name, args)
+	}
+	return nil, fmt.Errorf("%w: calling %s.%s", ErrUnsupported, typeName(m.recv), m.name)
+}
+
+func callStrMethod(str, name string, args *callArgs) (Value, error) {
+	switch name {
+	case "strip", "lstrip", "rstrip":
+		values, err := args.bind(name, "chars")
+		if err != nil {
+			return nil, err
+		}
+		return pyStrip(str, orDefault(values[0], nil), name != "rstrip", name != "lstrip")
+	case "split":
+		values, err := args.bind(name, "sep", "maxsplit")
+		if err != nil {
+			return nil, err
+		}
+		maxSplit, _, isFloat, ok := toNumber(orDefault(values[1], int64(-1)))
+		if !ok || isFloat {
+			return nil, fmt.Errorf("split() maxsplit must be an integer")
+		}
+		return pySplit(str, orDefault(values[0], nil), maxSplit)
+	case "startswith", "endswith":
+		values, err := args.bind(name, "prefix")
+		if err != nil {
+			return nil, err
+		}
+		candidates := []Value{values[0]}
+		if tuple, ok := values[0].(Tuple); ok {
+			candidates = tuple
+		}
+		for _, candidate := range candidates {
+			affix, ok := candidate.(string)
+			if !ok {
+				return nil, fmt.Errorf("%s first arg must be str or a tuple of str", name)
+			}
+			if (name == "startswith" && strings.HasPrefix(str, affix)) ||
+				(name == "endswith" && strings.HasSuffix(str, affix)) {
+				return true, nil
+			}
+		}
+		return false, nil
+	case "upper", "lower", "title", "capitalize":
+		if _, err := args.bind(name); err != nil {
+			return nil, err
+		}
+		switch name {
+		case "upper":
+			return mapCase(strings.ToUpper, str)
+		case "lower":
+			return mapCase(strings.ToLower, str)
+		case "title":
+			return mapCase(pyTitle, str)
+		}
+		return mapCase(capitalize, str)
+	case "replace":
+		values, err := args.bind(name, "old", "new", "count")
+		if err != nil {
+			return nil, err
+		}
+		old, ok1 := values[0].(string)
+		replacement, ok2 := values[1].(string)
+		count, _, isFloat, ok3 := toNumber(orDefault(values[2], int64(-1)))
+		if !ok1 || !ok2 || !ok3 || isFloat {
+			return nil, fmt.Errorf("replace() arguments must be str, str and int")
+		}
+		return pyReplace(str, old, replacement, count), nil
+	case "find", "count":
+		values, err := args.bind(name, "sub")
+		if err != nil {
+			return nil, err
+		}
+		sub, ok := values[0].(string)
+		if !ok {
+			return nil, fmt.Errorf("must be str, not %s", typeName(values[0]))
+		}
+		if name == "count" {
+			if sub == "" {
+				return int64(len([]rune(str)) + 1), nil
+			}
+			return int64(strings.Count(str, sub)), nil
+		}
+		i := strings.Index(str, sub)
+		if i > 0 {
+			i = len([]rune(str[:i]))
+		}
+		return int64(i), nil
+	case "join":
+		values, err := args.bind(name, "iterable")
+		if err != nil {
+			return nil, err
+		}
+		items, err := iterate(values[0])
+		if err != nil {
+			return nil, err
+		}
+		parts := make([]string, len(items))
+		for i, item := range items {
+			part, ok := item.(string)
+			if !ok {
+				return nil, fmt.Errorf("sequence item %d: expected str instance, %s found", i, typeName(item))
+			}
+			parts[i] = part
+		}
+		return strings.Join(parts, str), nil
+	case "removeprefix", "removesuffix":
+		values, err := args.bind(name, "affix")
+		if err != nil {
+			return nil, err
+		}
+		affix, ok := values[0].(string)
+		if !ok {
+			return nil, fmt.Errorf("%s() argument must be str", name)
+		}
+		if name == "removeprefix" {
+			return strings.TrimPrefix(str, affix), nil
+		}
+		return strings.TrimSuffix(str, affix), nil
+	}
+	return nil, fmt.Errorf("%w: calling str.%s", ErrUnsupported, name)
+}
+
+func callDictMethod(d *Dict, name string, args *callArgs) (Value, error) {
+	switch name {
+	case "get":
+		values, err := args.bind(name, "key", "default")
+		if err != nil {
+			return nil, err
+		}
+		if _, err := hashKey(values[0]); err != nil {
+			return nil, err
+		}
+		if v, ok := d.get(values[0]); ok {
+			return v, nil
+		}
+		return orDefault(values[1], nil), nil
+	case "keys", "values", "items":
+		if _, err := args.bind(name); err != nil {
+			return nil, err
+		}
+		return &dictView{dict: d, kind: name}, nil
+	}
+	// The sandbox refuses the methods that modify the dict.
+	return nil, fmt.Errorf("%w: calling dict.%s", ErrUnsupported, name)
+}
+
+// pyStrip implements Python's str.strip, lstrip and rstrip.
+func pyStrip(s string, chars Value, left, right bool) (Value, error) {
+	cut := isSpace
+	switch c := chars.(type) {
+	case nil:
+	case string:
+		cut = func(r rune) bool { return strings.ContainsRune(c, r) }
+	default:
+		return nil, fmt.Errorf("strip arg must be None or str")
+	}
+	if left {
+		s = strings.TrimLeftFunc(s, cut)
+	}
+	if right {
+		s = strings.TrimRightFunc(s, cut)
+	}
+	return s, nil
+}
+
+// pySplit implements Python's str.split.
+func pySplit(str string, sep Value, maxSplit int64) (Value, error) {
+	var parts []string
+	switch sep := sep.(type) {
+	case nil:
+		rest := strings.TrimLeftFunc(str, isSpace)
+		for rest != "" {
+			if maxSplit >= 0 && int64(len(parts)) == maxSplit {
+				parts = append(parts, rest)
+				break
+			}
+			end := strings.IndexFunc(rest, isSpace)
+			if end < 0 {
+				parts = append(parts, rest)
+				break
+			}
+			parts = append(parts, rest[:end])
+			rest = strings.TrimLeftFunc(rest[end:], isSpace)
+		}
+	case string:
+		if sep == "" {
+			return nil, fmt.Errorf("empty separator")
+		}
+		n := -1
+		if maxSplit >= 0 {
+			n = int(maxSplit) + 1
+		}
+		parts = strings.SplitN(str, sep, n)
+	default:
+		return nil, fmt.Errorf("must be str or None, not %s", typeName(sep))
+	}
+
+	items := make([]Value, len(parts))
+	for i, part := range parts {
+		items[i] = part
+	}
+	return items, nil
+}
+
+// pyReplace implements Python's str.replace, where a negative count
+// replaces all occurrences.
+func pyReplace(s, old, replacement string, count int64) string {
+	if count < 0 {
+		return strings.ReplaceAll(s, old, replacement)
+	}
+	return strings.Replace(s, old, replacement, int(count))
+}
+
+// specialCasing holds the characters whose case mappings in Python differ
+// from Go's: those mapping to several characters, like 'ß'.upper() == 'SS',
+// and the final sigma rule of str.lower.
+var specialCasing = &unicode.RangeTable{
+	R16: []unicode.Range16{
+		{Lo: 0x00df, Hi: 0x00df, Stride: 1},
+		{Lo: 0x0130, Hi: 0x0130, Stride: 1},
+		{Lo: 0x0149, Hi: 0x0149, Stride: 1},
+		{Lo: 0x01f0, Hi: 0x01f0, Stride: 1},
+		{Lo: 0x0390, Hi: 0x0390, Stride: 1},
+		{Lo: 0x03a3, Hi: 0x03a3, Stride: 1},
+		{Lo: 0x03b0, Hi: 0x03b0, Stride: 1},
+		{Lo: 0x0587, Hi: 0x0587, Stride: 1},
+		{Lo: 0x1e96, Hi: 0x1e9a, Stride: 1},
+		{Lo: 0x1f50, Hi: 0x1f56, Stride: 2},
+		{Lo: 0x1f80, Hi: 0x1faf, Stride: 1},
+		{Lo: 0x1fb2, Hi: 0x1fb4, Stride: 1},
+		{Lo: 0x1fb6, Hi: 0x1fb7, Stride: 1},
+		{Lo: 0x1fbc, Hi: 0x1fbc, Stride: 1},
+		{Lo: 0x1fc2, Hi: 0x1fc4, Stride: 1},
+		{Lo: 0x1fc6, Hi: 0x1fc7, Stride: 1},
+		{Lo: 0x1fcc, Hi: 0x1fcc, Stride: 1},
+		{Lo: 0x1fd2, Hi: 0x1fd3, Stride: 1},
+		{Lo: 0x1fd6, Hi: 0x1fd7, Stride: 1},
+		{Lo: 0x1fe2, Hi: 0x1fe4, Stride: 1},
+		{Lo: 0x1fe6, Hi: 0x1fe7, Stride: 1},
+		{Lo: 0x1ff2, Hi: 0x1ff4, Stride: 1},
+		{Lo: 0x1ff6, Hi: 0x1ff7, Stride: 1},
+		{Lo: 0x1ffc, Hi: 0x1ffc, Stride: 1},
+		{Lo: 0xfb00, Hi: 0xfb06, Stride: 1},
+		{Lo: 0xfb13, Hi: 0xfb17, Stride: 1},
+	},
+}
+
+// mapCase applies a case mapping, refusing strings whose mapping in Python
+// Go cannot reproduce.
+func mapCase(fn func(string) string, s string) (Value, error) {
+	if strings.IndexFunc(s, func(r rune) bool { return unicode.Is(specialCasing, r) }) >= 0 {
+		return nil, fmt.Errorf("%w: special case mappings", ErrUnsupported)
+	}
+	return fn(s), nil
+}
+
+// pyTitle implements Python's str.title.
+func pyTitle(s string) string {
+	var sb strings.Builder
+	previousCased := false
+	for _, r := range s {
+		if previousCased {
+			sb.WriteString(strings.ToLower(string(r)))
+		} else {
+			sb.WriteRune(unicode.ToTitle(r))
+		}
+		previousCased = unicode.IsUpper(r) || unicode.IsLower(r) || unicode.IsTitle(r)
+	}
+	return sb.String()
+}
+
+// strftime implements the common directives of Python's strftime in the C
+// locale.
+func strftime(now time.Time, format string) (Value, error) {
+	var sb strings.Builder
+	for pos := 0; pos < len(format); pos++ {
+		if format[pos] != '%' || pos+1 == len(format) {
+			sb.WriteByte(format[pos])
+			continue
+		}
+		pos++
+		switch format[pos] {
+		case 'a':
+			sb.WriteString(now.Format("Mon"))
+		case 'A':
+			sb.WriteString(now.Format("Monday"))
+		case 'b':
+			sb.WriteString(now.Format("Jan"))
+		case 'B':
+			sb.WriteString(now.Format("January"))
+		case 'd':
+			fmt.Fprintf(&sb, "%02d", now.Day())
+		case 'H':
+			fmt.Fprintf(&sb, "%02d", now.Hour())
+		case 'I':
+			fmt.Fprintf(&sb, "%02d", (now.Hour()+11)%12+1)
+		case 'j':
+			fmt.Fprintf(&sb, "%03d", now.YearDay())
+		case 'm':
+			fmt.Fprintf(&sb, "%02d", int(now.Month()))
+		case 'M':
+			fmt.Fprintf(&sb, "%02d", now.Minute())
+		case 'p':
+			sb.WriteString(now.Format("PM"))
+		case 'S':
+			fmt.Fprintf(&sb, "%02d", now.Second())
+		case 'y':
+			fmt.Fprintf(&sb, "%02d", now.Year()%100)
+		case 'Y':
+			fmt.Fprintf(&sb, "%d", now.Year())
+		case '%':
+			sb.WriteByte('%')
+		default:
+			return nil, fmt.Errorf("%w: strftime directive %%%c", ErrUnsupported, format[pos])
+		}
+	}
+	return sb.String(), nil
+}
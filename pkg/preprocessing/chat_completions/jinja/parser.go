@@ -0,0 +1,1076 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package jinja
+
+import (
+	"fmt"
+	"strconv"
+)
+
+// Statement nodes.
+type (
+	node interface{}
+
+	textNode struct {
+		text string
+	}
+
+	outputNode struct {
+		expr expr
+	}
+
+	ifNode struct {
+		cond     expr
+		body     []node
+		elseBody []node // holds a single ifNode for elif
+	}
+
+	forNode struct {
+		target   assignTarget
+		iter     expr
+		filter   expr // optional
+		body     []node
+		elseBody []node
+	}
+
+	setNode struct {
+		target assignTarget
+		value  expr   // nil for block assignments
+		body   []node // block assignment
+	}
+
+	macroNode struct {
+		macro *macro
+	}
+
+	breakNode    struct{}
+	continueNode struct{}
+)
+
+// assignTarget is the left-hand side of a set or for statement: a name, a
+// tuple of names, or a namespace attribute.
+type assignTarget struct {
+	names []string
+	tuple bool
+	attr  string // set on names[0] when not empty
+}
+
+// Expression nodes, evaluated in eval.go.
+type (
+	expr interface{}
+
+	constExpr struct {
+		value Value
+	}
+
+	nameExpr struct {
+		name string
+	}
+
+	listExpr struct {
+		items []expr
+		tuple bool
+	}
+
+	dictExpr struct {
+		keys   []expr
+		values []expr
+	}
+
+	getattrExpr struct {
+		obj  expr
+		name string
+	}
+
+	getitemExpr struct {
+		obj expr
+		key expr
+	}
+
+	sliceExpr struct {
+		obj               expr
+		start, stop, step expr // optional
+	}
+
+	callExpr struct {
+		fn   expr
+		args callArgsExpr
+	}
+
+	filterExpr struct {
+		input expr
+		name  string
+		args  callArgsExpr
+	}
+
+	testExpr struct {
+		input  expr
+		name   string
+		args   callArgsExpr
+		negate bool
+	}
+
+	unaryExpr struct {
+		op string // "-", "+" or "not"
+		x  expr
+	}
+
+	binaryExpr struct {
+		op   string // arithmetic, "~", "and" or "or"
+		l, r expr
+	}
+
+	compareExpr struct {
+		first    expr
+		ops      []string // comparison operators, "in" and "notin"
+		operands []expr
+	}
+
+	condExpr struct {
+		cond, then expr
+		otherwise  expr // optional
+	}
+)
+
+type callArgsExpr struct {
+	args    []expr
+	kwNames []string
+	kwArgs  []expr
+}
+
+// parser builds the statement tree of a template from its tokens, following
+// jinja2.parser.
+type parser struct {
+	tokens []token
+	pos    int
+}
+
+func parse(tokens []token) ([]node, error) {
+	p := &parser{tokens: tokens}
+	body, end, err := p.parseBody()
+	if err != nil {
+		return nil, err
+	}
+	if end != "" {
+		return nil, p.errorf("unexpected '%s'", end)
+	}
+	return body, nil
+}
+
+func (p *parser) current() token {
+	return p.tokens[p.pos]
+}
+
+func (p *parser) peek(offset int) token {
+	if p.pos+offset >= len(p.tokens) {
+		return p.tokens[len(p.tokens)-1]
+	}
+	return p.tokens[p.pos+offset]
+}
+
+func (p *parser) next() token {
+	tok := p.tokens[p.pos]
+	if tok.kind != tokenEOF {
+		p.pos++
+	}
+	return tok
+}
+
+func (p *parser) errorf(format string, args ...interface{}) error {
+	return fmt.Errorf("line %d: %s", p.current().line, fmt.Sprintf(format, args...))
+}
+
+func (p *parser) unsupported(what string) error {
+	return fmt.Errorf("line %d: %w: %s", p.current().line, ErrUnsupported, what)
+}
+
+func (p *parser) isOperator(op string) bool {
+	tok := p.current()
+	return tok.kind == tokenOperator && tok.value == op
+}
+
+func (p *parser) isName(name string) bool {
+	tok := p.current()
+	return tok.kind == tokenName && tok.value == name
+}
+
+func (p *parser) skipOperator(op string) bool {
+	if p.isOperator(op) {
+		p.pos++
+		return true
+	}
+	return false
+}
+
+func (p *parser) skipName(name string) bool {
+	if p.isName(name) {
+		p.pos++
+		return true
+	}
+	return false
+}
+
+func (p *parser) expectOperator(op string) error {
+	if !p.skipOperator(op) {
+		return p.errorf("expected '%s'", op)
+	}
+	return nil
+}
+
+func (p *parser) expectName() (string, error) {
+	tok := p.current()
+	if tok.kind != tokenName {
+		return "", p.errorf("expected a name")
+	}
+	p.pos++
+	return tok.value, nil
+}
+
+func (p *parser) expectBlockEnd() error {
+	if p.current().kind != tokenBlockEnd {
+		return p.errorf("expected end of statement block")
+	}
+	p.pos++
+	return nil
+}
+
+// parseBody parses nodes up to a block tag that is not a statement on its
+// own (endfor, else, ...), whose name it returns with the parser positioned
+// right after it. The name is empty at the end of the template.
+func (p *parser) parseBody() ([]node, string, error) {
+	var body []node
+	for {
+		tok := p.next()
+		switch tok.kind {
+		case tokenEOF:
+			return body, "", nil
+		case tokenData:
+			body = append(body, &textNode{text: tok.value})
+		case tokenVariableBegin:
+			e, err := p.parseTuple(true)
+			if err != nil {
+				return nil, "", err
+			}
+			if p.current().kind != tokenVariableEnd {
+				return nil, "", p.errorf("expected end of print statement")
+			}
+			p.pos++
+			body = append(body, &outputNode{expr: e})
+		case tokenBlockBegin:
+			name, err := p.expectName()
+			if err != nil {
+				return nil, "", err
+			}
+			n, err := p.parseStatement(name)
+			if err != nil {
+				return nil, "", err
+			}
+			if n == nil {
+				return body, name, nil
+			}
+			body = append(body, n...)
+		default:
+			return nil, "", p.errorf("unexpected token")
+		}
+	}
+}
+
+// parseStatement parses the statement introduced by name. It returns nil
+// nodes for tags that end or continue an enclosing statement.
+func (p *parser) parseStatement(name string) ([]node, error) {
+	switch name {
+	case "if":
+		n, err := p.parseIf()
+		return []node{n}, err
+	case "for":
+		n, err := p.parseFor()
+		return []node{n}, err
+	case "set":
+		n, err := p.parseSet()
+		return []node{n}, err
+	case "macro":
+		n, err := p.parseMacro()
+		return []node{n}, err
+	case "break", "continue":
+		if err := p.expectBlockEnd(); err != nil {
+			return nil, err
+		}
+		if name == "break" {
+			return []node{&breakNode{}}, nil
+		}
+		return []node{&continueNode{}}, nil
+	case "generation":
+		// The transformers generation tag renders its body as is unless the
+		// assistant tokens mask is requested, which is left to Python.
+		if err := p.expectBlockEnd(); err != nil {
+			return nil, err
+		}
+		body, end, err := p.parseBody()
+		if err != nil {
+			return nil, err
+		}
+		if end != "endgeneration" {
+			return nil, p.errorf("expected 'endgeneration'")
+		}
+		return append([]node{}, body...), p.expectBlockEnd()
+	case "elif", "else", "endif", "endfor", "endset", "endmacro", "endgeneration":
+		return nil, nil
+	default:
+		return nil, p.unsupported(fmt.Sprintf("'%s' tags", name))
+	}
+}
+
+func (p *parser) parseIf() (node, error) {
+	cond, err := p.parseTuple(false)
+	if err != nil {
+		return nil, err
+	}
+	if err := p.expectBlockEnd(); err != nil {
+		return nil, err
+	}
+
+	body, end, err := p.parseBody()
+	if err != nil {
+		return nil, err
+	}
+	stmt := &ifNode{cond: cond, body: body}
+
+	switch end {
+	case "elif":
+		elif, err := p.parseIf()
+		if err != nil {
+			return nil, err
+		}
+		stmt.elseBody = []node{elif}
+		return stmt, nil
+	case "else":
+		if err := p.expectBlockEnd(); err != nil {
+			return nil, err
+		}
+		if stmt.elseBody, end, err = p.parseBody(); err != nil {
+			return nil, err
+		}
+	}
+	if end != "endif" {
+		return nil, p.errorf("expected 'endif'")
+	}
+	return stmt, p.expectBlockEnd()
+}
+
+func (p *parser) parseFor() (node, error) {
+	target, err := p.parseAssignTarget(false)
+	if err != nil {
+		return nil, err
+	}
+	if !p.skipName("in") {
+		return nil, p.errorf("expected 'in'")
+	}
+	// "if" starts the loop filter here, not a conditional expression.
+	iter, err := p.parseTuple(false)
+	if err != nil {
+		return nil, err
+	}
+
+	stmt := &forNode{target: target, iter: iter}
+	if p.skipName("if") {
+		if stmt.filter, err = p.parseTuple(false); err != nil {
+			return nil, err
+		}
+	}
+	if p.isName("recursive") {
+		return nil, p.unsupported("recursive loops")
+	}
+	if err := p.expectBlockEnd(); err != nil {
+		return nil, err
+	}
+
+	body, end, err := p.parseBody()
+	if err != nil {
+		return nil, err
+	}
+	stmt.body = body
+	if end == "else" {
+		if err := p.expectBlockEnd(); err != nil {
+			return nil, err
+		}
+		if stmt.elseBody, end, err = p.parseBody(); err != nil {
+			return nil, err
+		}
+	}
+	if end != "endfor" {
+		return nil, p.errorf("expected 'endfor'")
+	}
+	return stmt, p.expectBlockEnd()
+}
+
+func (p *parser) parseSet() (node, error) {
+	target, err := p.parseAssignTarget(true)
+	if err != nil {
+		return nil, err
+	}
+
+	if p.skipOperator("=") {
+		value, err := p.parseTuple(true)
+		if err != nil {
+			return nil, err
+		}
+		return &setNode{target: target, value: value}, p.expectBlockEnd()
+	}
+
+	if p.isOperator("|") {
+		return nil, p.unsupported("filtered block assignments")
+	}
+	if err := p.expectBlockEnd(); err != nil {
+		return nil, err
+	}
+	body, end, err := p.parseBody()
+	if err != nil {
+		return nil, err
+	}
+	if end != "endset" {
+		return nil, p.errorf("expected 'endset'")
+	}
+	return &setNode{target: target, body: body}, p.expectBlockEnd()
+}
+
+// parseAssignTarget parses a name or a tuple of names, or, for set
+// statements, a namespace attribute.
+func (p *parser) parseAssignTarget(allowAttr bool) (assignTarget, error) {
+	var target assignTarget
+	parenthesized := p.skipOperator("(")
+
+	for {
+		name, err := p.expectName()
+		if err != nil {
+			return target, err
+		}
+		if allowAttr && len(target.names) == 0 && p.skipOperator(".") {
+			if target.attr, err = p.expectName(); err != nil {
+				return target, err
+			}
+			target.names = []string{name}
+			return target, nil
+		}
+		target.names = append(target.names, name)
+
+		if !p.skipOperator(",") {
+			break
+		}
+		target.tuple = true
+		if p.isOperator(")") || p.isName("in") || p.isOperator("=") {
+			break
+		}
+	}
+
+	if parenthesized {
+		if err := p.expectOperator(")"); err != nil {
+			return target, err
+		}
+	}
+	return target, nil
+}
+
+func (p *parser) parseMacro() (node, error) {
+	name, err := p.expectName()
+	if err != nil {
+		return nil, err
+	}
+	mac := &macro{name: name}
+
+	if err := p.expectOperator("("); err != nil {
+		return nil, err
+	}
+	for !p.skipOperator(")") {
+		if len(mac.params) > 0 {
+			if err := p.expectOperator(","); err != nil {
+				return nil, err
+			}
+			if p.skipOperator(")") {
+				break
+			}
+		}
+		param, err := p.expectName()
+		if err != nil {
+			return nil, err
+		}
+		var def expr
+		if p.skipOperator("=") {
+			if def, err = p.parseExpression(true); err != nil {
+				return nil, err
+			}
+		} else if len(mac.defaults) > 0 && mac.defaults[len(mac.defaults)-1] != nil {
+			return nil, p.errorf("non-default argument follows default argument")
+		}
+		mac.params = append(mac.params, param)
+		mac.defaults = append(mac.defaults, def)
+	}
+	if err := p.expectBlockEnd(); err != nil {
+		return nil, err
+	}
+
+	body, end, err := p.parseBody()
+	if err != nil {
+		return nil, err
+	}
+	if end != "endmacro" {
+		return nil, p.errorf("expected 'endmacro'")
+	}
+	mac.body = body
+	return &macroNode{macro: mac}, p.expectBlockEnd()
+}
+
+// parseTuple parses an expression, or a tuple for comma separated
+// expressions.
+func (p *parser) parseTuple(withCondition bool) (expr, error) {
+	return p.parseTupleWith(func() (expr, error) { return p.parseExpression(withCondition) })
+}
+
+func (p *parser) parseTupleWith(parseItem func() (expr, error)) (expr, error) {
+	var items []expr
+	isTuple := false
+	for {
+		if len(items) > 0 {
+			if !p.skipOperator(",") {
+				break
+			}
+			isTuple = true
+		}
+		if p.isTupleEnd() {
+			break
+		}
+		item, err := parseItem()
+		if err != nil {
+			return nil, err
+		}
+		items = append(items, item)
+	}
+
+	if !isTuple {
+		if len(items) == 0 {
+			return nil, p.errorf("expected an expression")
+		}
+		return items[0], nil
+	}
+	return &listExpr{items: items, tuple: true}, nil
+}
+
+func (p *parser) isTupleEnd() bool {
+	tok := p.current()
+	switch tok.kind {
+	case tokenVariableEnd, tokenBlockEnd, tokenEOF:
+		return true
+	case tokenOperator:
+		return tok.value == ")" || tok.value == "="
+	case tokenName:
+		return tok.value == "in" || tok.value == "if" || tok.value == "recursive"
+	}
+	return false
+}
+
+func (p *parser) parseExpression(withCondition bool) (expr, error) {
+	if withCondition {
+		return p.parseCondition()
+	}
+	return p.parseOr()
+}
+
+func (p *parser) parseCondition() (expr, error) {
+	e, err := p.parseOr()
+	if err != nil {
+		return nil, err
+	}
+	for p.skipName("if") {
+		cond, err := p.parseOr()
+		if err != nil {
+			return nil, err
+		}
+		c := &condExpr{cond: cond, then: e}
+		if p.skipName("else") {
+			if c.otherwise, err = p.parseCondition(); err != nil {
+				return nil, err
+			}
+		}
+		e = c
+	}
+	return e, nil
+}
+
+func (p *parser) parseOr() (expr, error) {
+	l, err := p.parseAnd()
+	if err != nil {
+		return nil, err
+	}
+	for p.skipName("or") {
+		r, err := p.parseAnd()
+		if err != nil {
+			return nil, err
+		}
+		l = &binaryExpr{op: "or", l: l, r: r}
+	}
+	return l, nil
+}
+
+func (p *parser) parseAnd() (expr, error) {
+	l, err := p.parseNot()
+	if err != nil {
+		return nil, err
+	}
+	for p.skipName("and") {
+		r, err := p.parseNot()
+		if err != nil {
+			return nil, err
+		}
+		l = &binaryExpr{op: "and", l: l, r: r}
+	}
+	return l, nil
+}
+
+func (p *parser) parseNot() (expr, error) {
+	if p.skipName("not") {
+		x, err := p.parseNot()
+		if err != nil {
+			return nil, err
+		}
+		return &unaryExpr{op: "not", x: x}, nil
+	}
+	return p.parseCompare()
+}
+
+func (p *parser) parseCompare() (expr, error) {
+	first, err := p.parseMath1()
+	if err != nil {
+		return nil, err
+	}
+
+	cmpExpr := &compareExpr{first: first}
+	for {
+		var op string
+		tok := p.current()
+		switch {
+		case tok.kind == tokenOperator && isCompareOperator(tok.value):
+			op = tok.value
+			p.pos++
+		case p.skipName("in"):
+			op = "in"
+		case p.isName("not") && p.peek(1).kind == tokenName && p.peek(1).value == "in":
+			p.pos += 2
+			op = "notin"
+		default:
+			if len(cmpExpr.ops) == 0 {
+				return first, nil
+			}
+			return cmpExpr, nil
+		}
+
+		operand, err := p.parseMath1()
+		if err != nil {
+			return nil, err
+		}
+		cmpExpr.ops = append(cmpExpr.ops, op)
+		cmpExpr.operands = append(cmpExpr.operands, operand)
+	}
+}
+
+func isCompareOperator(op string) bool {
+	switch op {
+	case "==", "!=", "<", "<=", ">", ">=":
+		return true
+	}
+	return false
+}
+
+func (p *parser) parseBinary(ops []string, operand func() (expr, error)) (expr, error) {
+	l, err := operand()
+	if err != nil {
+		return nil, err
+	}
+	for {
+		matched := ""
+		for _, op := range ops {
+			if p.isOperator(op) {
+				matched = op
+				break
+			}
+		}
+		if matched == "" {
+			return l, nil
+		}
+		p.pos++
+		r, err := operand()
+		if err != nil {
+			return nil, err
+		}
+		l = &binaryExpr{op: matched, l: l, r: r}
+	}
+}
+
+func (p *parser) parseMath1() (expr, error) {
+	return p.parseBinary([]string{"+", "-"}, p.parseConcat)
+}
+
+func (p *parser) parseConcat() (expr, error) {
+	return p.parseBinary([]string{"~"}, p.parseMath2)
+}
+
+func (p *parser) parseMath2() (expr, error) {
+	return p.parseBinary([]string{"*", "/", "//", "%"}, p.parsePow)
+}
+
+func (p *parser) parsePow() (expr, error) {
+	return p.parseBinary([]string{"**"}, func() (expr, error) { return p.parseUnary(true) })
+}
+
+func (p *parser) parseUnary(withFilter bool) (expr, error) {
+	var ex expr
+	var err error
+	switch {
+	case p.isOperator("-") || p.isOperator("+"):
+		op := p.next().value
+		x, err := p.parseUnary(false)
+		if err != nil {
+			return nil, err
+		}
+		ex = &unaryExpr{op: op, x: x}
+	default:
+		if ex, err = p.parsePrimary(); err != nil {
+			return nil, err
+		}
+	}
+
+	if ex, err = p.parsePostfix(ex); err != nil {
+		return nil, err
+	}
+	if withFilter {
+		return p.parseFilterExpr(ex)
+	}
+	return ex, nil
+}
+
+func (p *parser) parsePrimary() (expr, error) {
+	tok := p.next()
+	switch tok.kind {
+	case tokenName:
+		switch tok.value {
+		case "true", "True":
+			return &constExpr{value: true}, nil
+		case "false", "False":
+			return &constExpr{value: false}, nil
+		case "none", "None":
+			return &constExpr{value: nil}, nil
+		}
+		return &nameExpr{name: tok.value}, nil
+	case tokenString:
+		s := tok.value
+		// Adjacent string literals are concatenated.
+		for p.current().kind == tokenString {
+			s += p.next().value
+		}
+		return &constExpr{value: s}, nil
+	case tokenInteger:
+		n, err := strconv.ParseInt(tok.value, 10, 64)
+		if err != nil {
+			return nil, p.unsupported("integer literals beyond 64 bits")
+		}
+		return &constExpr{value: n}, nil
+	case tokenFloat:
+		f, err := strconv.ParseFloat(tok.value, 64)
+		if err != nil {
+			return nil, p.errorf("invalid float literal %q", tok.value)
+		}
+		return &constExpr{value: f}, nil
+	case tokenOperator:
+		switch tok.value {
+		case "(":
+			if p.skipOperator(")") {
+				return &listExpr{tuple: true}, nil
+			}
+			e, err := p.parseTuple(true)
+			if err != nil {
+				return nil, err
+			}
+			return e, p.expectOperator(")")
+		case "[":
+			items, err := p.parseList("]")
+			return &listExpr{items: items}, err
+		case "{":
+			return p.parseDict()
+		}
+	}
+	return nil, fmt.Errorf("line %d: unexpected token %q", tok.line, tok.value)
+}
+
+// parseList parses comma separated expressions up to the closing operator,
+// allowing a trailing comma.
+func (p *parser) parseList(closing string) ([]expr, error) {
+	var items []expr
+	for !p.skipOperator(closing) {
+		if len(items) > 0 {
+			if err := p.expectOperator(","); err != nil {
+				return nil, err
+			}
+			if p.skipOperator(closing) {
+				break
+			}
+		}
+		item, err := p.parseExpression(true)
+		if err != nil {
+			return nil, err
+		}
+		items = append(items, item)
+	}
+	return items, nil
+}
+
+func (p *parser) parseDict() (expr, error) {
+	dict := &dictExpr{}
+	for !p.skipOperator("}") {
+		if len(dict.keys) > 0 {
+			if err := p.expectOperator(","); err != nil {
+				return nil, err
+			}
+			if p.skipOperator("}") {
+				break
+			}
+		}
+		key, err := p.parseExpression(true)
+		if err != nil {
+			return nil, err
+		}
+		if err := p.expectOperator(":"); err != nil {
+			return nil, err
+		}
+		value, err := p.parseExpression(true)
+		if err != nil {
+			return nil, err
+		}
+		dict.keys = append(dict.keys, key)
+		dict.values = append(dict.values, value)
+	}
+	return dict, nil
+}
+
+func (p *parser) parsePostfix(e expr) (expr, error) {
+	for {
+		var err error
+		switch {
+		case p.isOperator(".") || p.isOperator("["):
+			e, err = p.parseSubscript(e)
+		case p.isOperator("("):
+			e, err = p.parseCall(e)
+		default:
+			return e, nil
+		}
+		if err != nil {
+			return nil, err
+		}
+	}
+}
+
+func (p *parser) parseFilterExpr(e expr) (expr, error) {
+	for {
+		var err error
+		switch {
+		case p.isOperator("|"):
+			e, err = p.parseFilter(e)
+		case p.isName("is"):
+			e, err = p.parseTest(e)
+		case p.isOperator("("):
+			e, err = p.parseCall(e)
+		default:
+			return e, nil
+		}
+		if err != nil {
+			return nil, err
+		}
+	}
+}
+
+func (p *parser) parseSubscript(ex expr) (expr, error) {
+	if p.skipOperator(".") {
+		tok := p.next()
+		switch tok.kind {
+		case tokenName:
+			return &getattrExpr{obj: ex, name: tok.value}, nil
+		case tokenInteger:
+			n, err := strconv.ParseInt(tok.value, 10, 64)
+			if err != nil {
+				return nil, p.errorf("invalid index %q", tok.value)
+			}
+			return &getitemExpr{obj: ex, key: &constExpr{value: n}}, nil
+		}
+		return nil, p.errorf("expected name or number")
+	}
+
+	p.pos++ // [
+	var parts [3]expr
+	part := 0
+	isSlice := false
+	for !p.skipOperator("]") {
+		switch {
+		case p.skipOperator(":"):
+			isSlice = true
+			part++
+			if part > 2 {
+				return nil, p.errorf("invalid slice")
+			}
+		case p.isOperator(","):
+			return nil, p.unsupported("tuple subscripts")
+		default:
+			if parts[part] != nil {
+				return nil, p.errorf("expected ']'")
+			}
+			item, err := p.parseExpression(true)
+			if err != nil {
+				return nil, err
+			}
+			parts[part] = item
+		}
+	}
+
+	if isSlice {
+		return &sliceExpr{obj: ex, start: parts[0], stop: parts[1], step: parts[2]}, nil
+	}
+	if parts[0] == nil {
+		return nil, p.errorf("expected subscript expression")
+	}
+	return &getitemExpr{obj: ex, key: parts[0]}, nil
+}
+
+func (p *parser) parseCall(e expr) (expr, error) {
+	args, err := p.parseCallArgs()
+	if err != nil {
+		return nil, err
+	}
+	return &callExpr{fn: e, args: args}, nil
+}
+
+func (p *parser) parseCallArgs() (callArgsExpr, error) {
+	var args callArgsExpr
+	if err := p.expectOperator("("); err != nil {
+		return args, err
+	}
+
+	first := true
+	for !p.skipOperator(")") {
+		if !first {
+			if err := p.expectOperator(","); err != nil {
+				return args, err
+			}
+			if p.skipOperator(")") {
+				break
+			}
+		}
+		first = false
+
+		if p.isOperator("*") || p.isOperator("**") {
+			return args, p.unsupported("argument unpacking")
+		}
+		if p.current().kind == tokenName && p.peek(1).kind == tokenOperator && p.peek(1).value == "=" {
+			name := p.next().value
+			p.pos++ // =
+			value, err := p.parseExpression(true)
+			if err != nil {
+				return args, err
+			}
+			args.kwNames = append(args.kwNames, name)
+			args.kwArgs = append(args.kwArgs, value)
+			continue
+		}
+
+		if len(args.kwNames) > 0 {
+			return args, p.errorf("positional argument follows keyword argument")
+		}
+		value, err := p.parseExpression(true)
+		if err != nil {
+			return args, err
+		}
+		args.args = append(args.args, value)
+	}
+	return args, nil
+}
+
+// parseDottedName parses a filter or test name, which may contain dots.
+func (p *parser) parseDottedName() (string, error) {
+	name, err := p.expectName()
+	if err != nil {
+		return "", err
+	}
+	for p.skipOperator(".") {
+		part, err := p.expectName()
+		if err != nil {
+			return "", err
+		}
+		name += "." + part
+	}
+	return name, nil
+}
+
+func (p *parser) parseFilter(e expr) (expr, error) {
+	p.pos++ // |
+	name, err := p.parseDottedName()
+	if err != nil {
+		return nil, err
+	}
+	if _, ok := filters[name]; !ok {
+		return nil, p.unsupported(fmt.Sprintf("filter '%s'", name))
+	}
+
+	f := &filterExpr{input: e, name: name}
+	if p.isOperator("(") {
+		if f.args, err = p.parseCallArgs(); err != nil {
+			return nil, err
+		}
+	}
+	return f, nil
+}
+
+func (p *parser) parseTest(e expr) (expr, error) {
+	p.pos++ // is
+	test := &testExpr{input: e, negate: p.skipName("not")}
+
+	name, err := p.parseDottedName()
+	if err != nil {
+		return nil, err
+	}
+	if _, ok := tests[name]; !ok {
+		return nil, p.unsupported(fmt.Sprintf("test '%s'", name))
+	}
+	test.name = name
+
+	tok := p.current()
+	switch {
+	case p.isOperator("("):
+		if test.args, err = p.parseCallArgs(); err != nil {
+			return nil, err
+		}
+	case tok.kind == tokenString || tok.kind == tokenInteger || tok.kind == tokenFloat ||
+		(tok.kind == tokenOperator && (tok.value == "[" || tok.value == "{")) ||
+		(tok.kind == tokenName && tok.value != "else" && tok.value != "or" && tok.value != "and"):
+		if tok.kind == tokenName && tok.value == "is" {
+			return nil, p.errorf("you cannot chain multiple tests with is")
+		}
+		arg, err := p.parsePrimary()
+		if err != nil {
+			return nil, err
+		}
+		if arg, err = p.parsePostfix(arg); err != nil {
+			return nil, err
+		}
+		test.args.args = []expr{arg}
+	}
+	return test, nil
+}
@@ -0,0 +1,631 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package jinja
+
+import (
+	"bytes"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"io"
+	"math"
+	"strconv"
+	"strings"
+	"unicode"
+	"unicode/utf8"
+)
+
+// Value is a template value. Values follow the semantics of the Python
+// objects Jinja would see, and are one of: nil (None), bool, int64, float64,
+// string, []Value (list), Tuple, *Dict, Undefined, or one of the internal
+// range, macro, namespace, loop, method and iterator types.
+type Value = interface{}
+
+// Tuple is a Python tuple.
+type Tuple []Value
+
+// rangeObject is a Python range. It iterates, indexes and compares as its
+// items, but prints as range(start, stop[, step]).
+type rangeObject struct {
+	start, stop, step int64
+	items             []Value
+}
+
+// Undefined is the value of missing variables, attributes and items, with
+// the lenient semantics of jinja2.Undefined.
+type Undefined struct {
+	name string
+}
+
+// Dict is a Python dict: keys keep their insertion order.
+type Dict struct {
+	keys   []Value
+	values []Value
+	index  map[Value]int
+}
+
+// NewDict creates an empty dict.
+func NewDict() *Dict {
+	return &Dict{index: make(map[Value]int)}
+}
+
+// Set sets a string key.
+func (d *Dict) Set(key string, value Value) {
+	_ = d.put(key, value)
+}
+
+// Len returns the number of keys.
+func (d *Dict) Len() int {
+	return len(d.keys)
+}
+
+func (d *Dict) put(key, value Value) error {
+	hashed, err := hashKey(key)
+	if err != nil {
+		return err
+	}
+	if i, ok := d.index[hashed]; ok {
+		d.values[i] = value
+		return nil
+	}
+	d.index[hashed] = len(d.keys)
+	d.keys = append(d.keys, key)
+	d.values = append(d.values, value)
+	return nil
+}
+
+func (d *Dict) get(key Value) (Value, bool) {
+	hashed, err := hashKey(key)
+	if err != nil {
+		return nil, false
+	}
+	i, ok := d.index[hashed]
+	if !ok {
+		return nil, false
+	}
+	return d.values[i], true
+}
+
+// hashKey maps a dict key to a Go map key, so that keys Python considers
+// equal (1, 1.0 and True) collide.
+func hashKey(key Value) (Value, error) {
+	switch k := key.(type) {
+	case nil, string, int64:
+		return k, nil
+	case bool:
+		if k {
+			return int64(1), nil
+		}
+		return int64(0), nil
+	case float64:
+		if k == math.Trunc(k) && math.Abs(k) < 1<<63 {
+			return int64(k), nil
+		}
+		return k, nil
+	}
+	return nil, fmt.Errorf("unhashable type: '%s'", typeName(key))
+}
+
+// DecodeJSON decodes JSON into template values the way Python's json.loads
+// does: objects become dicts that keep the key order of the document, and
+// numbers become ints unless they have a fraction or an exponent.
+func DecodeJSON(data []byte) (Value, error) {
+	dec := json.NewDecoder(bytes.NewReader(data))
+	dec.UseNumber()
+	v, err := decodeJSONValue(dec)
+	if err != nil {
+		return nil, err
+	}
+	if _, err := dec.Token(); !errors.Is(err, io.EOF) {
+		return nil, fmt.Errorf("unexpected data after JSON value")
+	}
+	return v, nil
+}
+
+func decodeJSONValue(dec *json.Decoder) (Value, error) {
+	tok, err := dec.Token()
+	if err != nil {
+		return nil, err
+	}
+
+	switch tok := tok.(type) {
+	case json.Delim:
+		if tok == '[' {
+			list := []Value{}
+			for dec.More() {
+				item, err := decodeJSONValue(dec)
+				if err != nil {
+					return nil, err
+				}
+				list = append(list, item)
+			}
+			_, err := dec.Token()
+			return list, err
+		}
+
+		d := NewDict()
+		for dec.More() {
+			keyTok, err := dec.Token()
+			if err != nil {
+				return nil, err
+			}
+			value, err := decodeJSONValue(dec)
+			if err != nil {
+				return nil, err
+			}
+			d.Set(keyTok.(string), value)
+		}
+		_, err := dec.Token()
+		return d, err
+	case json.Number:
+		s := tok.String()
+		if strings.ContainsAny(s, ".eE") {
+			return strconv.ParseFloat(s, 64)
+		}
+		n, err := strconv.ParseInt(s, 10, 64)
+		if err != nil {
+			return nil, fmt.Errorf("%w: integer %s beyond 64 bits", ErrUnsupported, s)
+		}
+		return n, nil
+	default: // nil, bool, string
+		return tok, nil
+	}
+}
+
+// typeName returns the Python type name of a value, for error messages.
+func typeName(value Value) string {
+	switch value.(type) {
+	case nil:
+		return "NoneType"
+	case bool:
+		return "bool"
+	case int64:
+		return "int"
+	case float64:
+		return "float"
+	case string:
+		return "str"
+	case []Value:
+		return "list"
+	case Tuple:
+		return "tuple"
+	case *rangeObject:
+		return "range"
+	case *Dict:
+		return "dict"
+	case Undefined:
+		return "Undefined"
+	case *macro:
+		return "Macro"
+	case *namespace:
+		return "Namespace"
+	case *loopContext:
+		return "LoopContext"
+	case *iterator:
+		return "generator"
+	case *dictView:
+		return "dict_view"
+	case *method, builtin:
+		return "builtin_function_or_method"
+	}
+	return fmt.Sprintf("%T", value)
+}
+
+// isSpace matches Python's str.isspace.
+func isSpace(r rune) bool {
+	return unicode.IsSpace(r) || (r >= 0x1c && r <= 0x1f)
+}
+
+func truthy(v Value) bool {
+	switch x := v.(type) {
+	case nil:
+		return false
+	case bool:
+		return x
+	case int64:
+		return x != 0
+	case float64:
+		return x != 0
+	case string:
+		return x != ""
+	case []Value:
+		return len(x) > 0
+	case Tuple:
+		return len(x) > 0
+	case *rangeObject:
+		return len(x.items) > 0
+	case *Dict:
+		return x.Len() > 0
+	case *dictView:
+		return x.dict.Len() > 0
+	case Undefined:
+		return false
+	}
+	return true
+}
+
+// iterate returns the items a Python for loop over v would produce.
+func iterate(value Value) ([]Value, error) {
+	switch x := value.(type) {
+	case []Value:
+		return x, nil
+	case Tuple:
+		return x, nil
+	case *rangeObject:
+		return x.items, nil
+	case string:
+		items := make([]Value, 0, len(x))
+		for _, r := range x {
+			items = append(items, string(r))
+		}
+		return items, nil
+	case *Dict:
+		return x.keys, nil
+	case *dictView:
+		return x.items(), nil
+	case *iterator:
+		return x.consume(), nil
+	case Undefined:
+		return nil, nil
+	}
+	return nil, fmt.Errorf("'%s' object is not iterable", typeName(value))
+}
+
+// length implements Python's len.
+func length(v Value) (int, error) {
+	switch x := v.(type) {
+	case string:
+		return utf8.RuneCountInString(x), nil
+	case []Value:
+		return len(x), nil
+	case Tuple:
+		return len(x), nil
+	case *rangeObject:
+		return len(x.items), nil
+	case *Dict:
+		return x.Len(), nil
+	case *dictView:
+		return x.dict.Len(), nil
+	case Undefined:
+		return 0, nil
+	}
+	return 0, fmt.Errorf("object of type '%s' has no len()", typeName(v))
+}
+
+// toString implements Python's str for printing and concatenation.
+func toString(v Value) (string, error) {
+	switch x := v.(type) {
+	case string:
+		return x, nil
+	case Undefined:
+		return "", nil
+	}
+	return repr(v)
+}
+
+// repr implements Python's repr. Values whose repr holds a memory address
+// cannot be reproduced and are reported as unsupported.
+func repr(v Value) (string, error) {
+	var sb strings.Builder
+	if err := writeRepr(&sb, v); err != nil {
+		return "", err
+	}
+	return sb.String(), nil
+}
+
+func writeRepr(sb *strings.Builder, value Value) error {
+	switch value := value.(type) {
+	case nil:
+		sb.WriteString("None")
+	case bool:
+		if value {
+			sb.WriteString("True")
+		} else {
+			sb.WriteString("False")
+		}
+	case int64:
+		sb.WriteString(strconv.FormatInt(value, 10))
+	case float64:
+		sb.WriteString(formatFloat(value))
+	case string:
+		writeStringRepr(sb, value)
+	case []Value:
+		return writeSequenceRepr(sb, value, "[", "]")
+	case Tuple:
+		if len(value) == 1 {
+			return writeSequenceRepr(sb, value, "(", ",)")
+		}
+		return writeSequenceRepr(sb, value, "(", ")")
+	case *rangeObject:
+		fmt.Fprintf(sb, "range(%d, %d", value.start, value.stop)
+		if value.step != 1 {
+			fmt.Fprintf(sb, ", %d", value.step)
+		}
+		sb.WriteByte(')')
+	case *Dict:
+		sb.WriteByte('{')
+		for i, key := range value.keys {
+			if i > 0 {
+				sb.WriteString(", ")
+			}
+			if err := writeRepr(sb, key); err != nil {
+				return err
+			}
+			sb.WriteString(": ")
+			if err := writeRepr(sb, value.values[i]); err != nil {
+				return err
+			}
+		}
+		sb.WriteByte('}')
+	case *dictView:
+		sb.WriteString("dict_" + value.kind + "(")
+		if err := writeSequenceRepr(sb, value.items(), "[", "]"); err != nil {
+			return err
+		}
+		sb.WriteByte(')')
+	default:
+		return fmt.Errorf("%w: printing '%s' objects", ErrUnsupported, typeName(value))
+	}
+	return nil
+}
+
+func writeSequenceRepr(sb *strings.Builder, items []Value, open, closing string) error {
+	sb.WriteString(open)
+	for i, item := range items {
+		if i > 0 {
+			sb.WriteString(", ")
+		}
+		if err := writeRepr(sb, item); err != nil {
+			return err
+		}
+	}
+	sb.WriteString(closing)
+	return nil
+}
+
+func writeStringRepr(sb *strings.Builder, s string) {
+	quote := '\''
+	if strings.ContainsRune(s, '\'') && !strings.ContainsRune(s, '"') {
+		quote = '"'
+	}
+
+	sb.WriteRune(quote)
+	for _, r := range s {
+		switch {
+		case r == quote || r == '\\':
+			sb.WriteByte('\\')
+			sb.WriteRune(r)
+		case r == '\t':
+			sb.WriteString(`\t`)
+		case r == '\n':
+			sb.WriteString(`\n`)
+		case r == '\r':
+			sb.WriteString(`\r`)
+		case r < ' ' || r == 0x7f:
+			fmt.Fprintf(sb, `\x%02x`, r)
+		case r < utf8.RuneSelf || unicode.IsPrint(r):
+			sb.WriteRune(r)
+		case r < 0x100:
+			fmt.Fprintf(sb, `\x%02x`, r)
+		case r < 0x10000:
+			fmt.Fprintf(sb, `\u%04x`, r)
+		default:
+			fmt.Fprintf(sb, `\U%08x`, r)
+		}
+	}
+	sb.WriteRune(quote)
+}
+
+// formatFloat implements Python's repr of floats: the shortest digits that
+// round-trip, in positional notation for exponents from -4 to 15.
+func formatFloat(val float64) string {
+	switch {
+	case math.IsNaN(val):
+		return "nan"
+	case math.IsInf(val, 1):
+		return "inf"
+	case math.IsInf(val, -1):
+		return "-inf"
+	}
+
+	s := strconv.FormatFloat(val, 'e', -1, 64)
+	mantissa, expPart, _ := strings.Cut(s, "e")
+	exp, _ := strconv.Atoi(expPart)
+	if exp < -4 || exp >= 16 {
+		sign := "+"
+		if exp < 0 {
+			sign, exp = "-", -exp
+		}
+		return fmt.Sprintf("%se%s%02d", mantissa, sign, exp)
+	}
+
+	s = strconv.FormatFloat(val, 'f', -1, 64)
+	if !strings.Contains(s, ".") {
+		s += ".0"
+	}
+	return s
+}
+
+// toNumber returns v as a Python number, with bools counting as ints.
+func toNumber(v Value) (i int64, f float64, isFloat, ok bool) {
+	switch x := v.(type) {
+	case bool:
+		if x {
+			return 1, 0, false, true
+		}
+		return 0, 0, false, true
+	case int64:
+		return x, 0, false, true
+	case float64:
+		return 0, x, true, true
+	}
+	return 0, 0, false, false
+}
+
+// equal implements Python's ==.
+func equal(lhs, rhs Value) bool {
+	if ai, af, aFloat, ok := toNumber(lhs); ok {
+		bi, bf, bFloat, ok := toNumber(rhs)
+		switch {
+		case !ok:
+			return false
+		case !aFloat && !bFloat:
+			return ai == bi
+		case !aFloat:
+			af = float64(ai)
+		case !bFloat:
+			bf = float64(bi)
+		}
+		return af == bf
+	}
+
+	switch x := lhs.(type) {
+	case nil:
+		return rhs == nil
+	case string:
+		y, ok := rhs.(string)
+		return ok && x == y
+	case []Value:
+		y, ok := rhs.([]Value)
+		return ok && equalSequences(x, y)
+	case Tuple:
+		y, ok := rhs.(Tuple)
+		return ok && equalSequences(x, y)
+	case *rangeObject:
+		y, ok := rhs.(*rangeObject)
+		return ok && equalSequences(x.items, y.items)
+	case *Dict:
+		y, ok := rhs.(*Dict)
+		if !ok || x.Len() != y.Len() {
+			return false
+		}
+		for i, key := range x.keys {
+			value, ok := y.get(key)
+			if !ok || !equal(x.values[i], value) {
+				return false
+			}
+		}
+		return true
+	case Undefined:
+		_, ok := rhs.(Undefined)
+		return ok
+	case builtin:
+		// Functions are not comparable in Go; Jinja compares them by
+		// identity, which no template relies on.
+		return false
+	}
+	// The remaining internal objects are pointers compared by identity.
+	return lhs == rhs
+}
+
+func equalSequences(a, b []Value) bool {
+	if len(a) != len(b) {
+		return false
+	}
+	for i := range a {
+		if !equal(a[i], b[i]) {
+			return false
+		}
+	}
+	return true
+}
+
+// compare implements Python's ordering of numbers, strings, lists and
+// tuples, returning -1, 0 or 1.
+func compare(lhs, rhs Value) (int, error) {
+	if ai, af, aFloat, ok := toNumber(lhs); ok {
+		if bi, bf, bFloat, ok := toNumber(rhs); ok {
+			if !aFloat && !bFloat {
+				return cmpOrdered(ai, bi), nil
+			}
+			if !aFloat {
+				af = float64(ai)
+			}
+			if !bFloat {
+				bf = float64(bi)
+			}
+			return cmpOrdered(af, bf), nil
+		}
+	}
+
+	switch x := lhs.(type) {
+	case string:
+		if y, ok := rhs.(string); ok {
+			return strings.Compare(x, y), nil
+		}
+	case []Value:
+		if y, ok := rhs.([]Value); ok {
+			return compareSequences(x, y)
+		}
+	case Tuple:
+		if y, ok := rhs.(Tuple); ok {
+			return compareSequences(x, y)
+		}
+	}
+	return 0, fmt.Errorf("'<' not supported between instances of '%s' and '%s'", typeName(lhs), typeName(rhs))
+}
+
+func cmpOrdered[T int64 | float64](a, b T) int {
+	switch {
+	case a < b:
+		return -1
+	case a > b:
+		return 1
+	}
+	return 0
+}
+
+func compareSequences(a, b []Value) (int, error) {
+	for i := 0; i < len(a) && i < len(b); i++ {
+		if equal(a[i], b[i]) {
+			continue
+		}
+		return compare(a[i], b[i])
+	}
+	return cmpOrdered(int64(len(a)), int64(len(b))), nil
+}
+
+// contains implements Python's `item in container`.
+func contains(container, item Value) (bool, error) {
+	switch c := container.(type) {
+	case string:
+		s, ok := item.(string)
+		if !ok {
+			return false, fmt.Errorf("'in <string>' requires string as left operand, not %s", typeName(item))
+		}
+		return strings.Contains(c, s), nil
+	case *Dict:
+		if _, err := hashKey(item); err != nil {
+			return false, err
+		}
+		_, ok := c.get(item)
+		return ok, nil
+	case Undefined:
+		return false, nil
+	}
+
+	items, err := iterate(container)
+	if err != nil {
+		return false, fmt.Errorf("argument of type '%s' is not iterable", typeName(container))
+	}
+	for _, candidate := range items {
+		if equal(candidate, item) {
+			return true, nil
+		}
+	}
+	return false, nil
+}
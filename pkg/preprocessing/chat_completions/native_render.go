@@ -0,0 +1,215 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package preprocessing
+
+import (
+	"context"
+	"encoding/json"
+	"fmt"
+	"unicode/utf8"
+
+	lru "github.com/hashicorp/golang-lru/v2"
+	"k8s.io/klog/v2"
+
+	"github.com/llm-d/llm-d-kv-cache-manager/pkg/kvcache/metrics"
+	"github.com/llm-d/llm-d-kv-cache-manager/pkg/preprocessing/chat_completions/jinja"
+	"github.com/llm-d/llm-d-kv-cache-manager/pkg/utils/logging"
+)
+
+// nativeTemplatesCacheSize is the number of compiled chat templates kept by
+// the native renderer.
+const nativeTemplatesCacheSize = 128
+
+// reservedTemplateKWArgs are the chat_template_kwargs that collide with the
+// named parameters of transformers' render_jinja_template. The Python
+// renderer handles them.
+var reservedTemplateKWArgs = []string{
+	"messages", "conversations", "tools", "documents", "chat_template",
+	"return_assistant_tokens_mask", "continue_final_message", "add_generation_prompt",
+}
+
+// compiledTemplate is a cached compilation of a chat template. Templates the
+// native renderer does not support are cached with their error so they are
+// not recompiled on every request.
+type compiledTemplate struct {
+	template *jinja.Template
+	err      error
+}
+
+// nativeRenderer renders chat templates with the Go Jinja engine, producing
+// the same output as the transformers renderer for the templates it
+// supports.
+type nativeRenderer struct {
+	templates *lru.Cache[string, *compiledTemplate]
+}
+
+func newNativeRenderer() (*nativeRenderer, error) {
+	templates, err := lru.New[string, *compiledTemplate](nativeTemplatesCacheSize)
+	if err != nil {
+		return nil, fmt.Errorf("failed to create native templates cache: %w", err)
+	}
+	return &nativeRenderer{templates: templates}, nil
+}
+
+// compile returns the compiled template for source, compiling it on first use.
+func (n *nativeRenderer) compile(source string) (*jinja.Template, error) {
+	compiled, ok := n.templates.Get(source)
+	if !ok {
+		template, err := jinja.Compile(source)
+		compiled = &compiledTemplate{template: template, err: err}
+		n.templates.Add(source, compiled)
+	}
+	return compiled.template, compiled.err
+}
+
+// render renders the request natively. It returns false for requests that
+// must go through the Python renderer: templates or features the native
+// engine does not support, and errors, which Python reports with its own
+// messages.
+func (n *nativeRenderer) render(ctx context.Context,
+	req *RenderJinjaTemplateRequest,
+) (*RenderJinjaTemplateResponse, bool) {
+	template, vars, ok := n.prepare(ctx, req)
+	if !ok {
+		return nil, false
+	}
+
+	rendered, err := template.Render(vars)
+	if err != nil {
+		klog.FromContext(ctx).V(logging.TRACE).WithName("nativeRender").Info("Native render failed", "reason", err)
+		return nil, false
+	}
+
+	return &RenderJinjaTemplateResponse{
+		RenderedChats:     []string{rendered},
+		GenerationIndices: [][][]int{{}},
+	}, true
+}
+
+// prepare returns the compiled template and the variables to render a
+// request with, or false if the request must go through the Python renderer.
+func (n *nativeRenderer) prepare(ctx context.Context,
+	req *RenderJinjaTemplateRequest,
+) (*jinja.Template, map[string]jinja.Value, bool) {
+	traceLogger := klog.FromContext(ctx).V(logging.TRACE).WithName("nativeRender")
+
+	// The assistant tokens mask needs the generation spans, and continuing
+	// the final message post-processes the output; both are left to Python.
+	if req.ChatTemplate == "" || req.ReturnAssistantTokensMask || req.ContinueFinalMessage {
+		return nil, nil, false
+	}
+
+	template, err := n.compile(req.ChatTemplate)
+	if err != nil {
+		traceLogger.Info("Chat template not supported natively", "reason", err)
+		return nil, nil, false
+	}
+
+	vars, err := templateVars(req)
+	if err != nil {
+		traceLogger.Info("Request not supported natively", "reason", err)
+		return nil, nil, false
+	}
+	return template, vars, true
+}
+
+// templateVars builds the variables transformers' render_jinja_template
+// renders a template with. Values go through JSON, as they do on the way to
+// Python, so that templates see the same types and key orders.
+func templateVars(req *RenderJinjaTemplateRequest) (map[string]jinja.Value, error) {
+	vars := make(map[string]jinja.Value, len(req.ChatTemplateKWArgs)+4)
+	for _, key := range reservedTemplateKWArgs {
+		if _, ok := req.ChatTemplateKWArgs[key]; ok {
+			return nil, fmt.Errorf("reserved chat_template_kwargs key %q", key)
+		}
+	}
+	for key, value := range req.ChatTemplateKWArgs {
+		decoded, err := toTemplateValue(value)
+		if err != nil {
+			return nil, err
+		}
+		vars[key] = decoded
+	}
+
+	messages := make([]jinja.Value, len(req.Conversations))
+	for i, message := range req.Conversations {
+		// JSON encoding would replace invalid UTF-8.
+		if !utf8.ValidString(message.Role) || !utf8.ValidString(message.Content) {
+			return nil, fmt.Errorf("message %d is not valid UTF-8", i)
+		}
+		dict := jinja.NewDict()
+		dict.Set("role", message.Role)
+		dict.Set("content", message.Content)
+		messages[i] = dict
+	}
+	vars["messages"] = messages
+
+	var err error
+	if vars["tools"], err = toTemplateDicts(req.Tools); err != nil {
+		return nil, fmt.Errorf("tools: %w", err)
+	}
+	if vars["documents"], err = toTemplateDicts(req.Documents); err != nil {
+		return nil, fmt.Errorf("documents: %w", err)
+	}
+	vars["add_generation_prompt"] = req.AddGenerationPrompt
+
+	return vars, nil
+}
+
+// toTemplateDicts converts tools or documents, which transformers requires to
+// be dicts. Empty lists are omitted from the request JSON and so are None.
+func toTemplateDicts(items []interface{}) (jinja.Value, error) {
+	if len(items) == 0 {
+		return nil, nil //nolint:nilnil // None is a valid value
+	}
+	decoded, err := toTemplateValue(items)
+	if err != nil {
+		return nil, err
+	}
+	list, ok := decoded.([]jinja.Value)
+	if !ok {
+		return nil, fmt.Errorf("expected a list, got %T", decoded)
+	}
+	for _, item := range list {
+		if _, ok := item.(*jinja.Dict); !ok {
+			return nil, fmt.Errorf("expected objects, got %T", item)
+		}
+	}
+	return list, nil
+}
+
+func toTemplateValue(value interface{}) (jinja.Value, error) {
+	data, err := json.Marshal(value)
+	if err != nil {
+		return nil, err
+	}
+	return jinja.DecodeJSON(data)
+}
+
+// renderNative tries the native renderer, when enabled.
+func (w *ChatTemplatingProcessor) renderNative(ctx context.Context,
+	req *RenderJinjaTemplateRequest,
+) (*RenderJinjaTemplateResponse, bool) {
+	if w.native == nil {
+		return nil, false
+	}
+	response, ok := w.native.render(ctx, req)
+	if ok {
+		metrics.RenderedChats.WithLabelValues("native").Inc()
+	}
+	return response, ok
+}
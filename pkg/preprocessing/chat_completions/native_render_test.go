@@ -0,0 +1,165 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package preprocessing //nolint:testpackage // tests the unexported native renderer
+
+import (
+	"context"
+	"os"
+	"path/filepath"
+	"strings"
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+	"github.com/stretchr/testify/require"
+)
+
+// TestNativeRenderConformance diffs the native renderer against the
+// transformers renderer on the chat templates in testdata/chat_templates,
+// which follow the templates published with Llama 3.1, Qwen 2.5, Mistral,
+// Gemma and Phi-3.
+func TestNativeRenderConformance(t *testing.T) {
+	python := NewChatTemplatingProcessor(&Config{InterpreterPoolSize: 1})
+	require.NoError(t, python.Initialize(), "Python renderer should initialize")
+	native, err := newNativeRenderer()
+	require.NoError(t, err)
+
+	paths, err := filepath.Glob(filepath.Join("testdata", "chat_templates", "*.jinja"))
+	require.NoError(t, err)
+	require.NotEmpty(t, paths, "Chat templates should be found")
+
+	conversation := []ChatMessage{
+		{Role: "system", Content: "You are a helpful assistant."},
+		{Role: "user", Content: "  Hi there! Größe, ☃ and 😀 \"quoted\"\n"},
+		{Role: "assistant", Content: "Hello! How can I help?"},
+		{Role: "user", Content: "What's the weather in Paris?"},
+	}
+	tools := []interface{}{map[string]interface{}{
+		"type": "function",
+		"function": map[string]interface{}{
+			"name":        "get_weather",
+			"description": "Get the current weather",
+			"parameters": map[string]interface{}{
+				"type": "object",
+				"properties": map[string]interface{}{
+					"location": map[string]interface{}{"type": "string", "description": "City, e.g. Paris"},
+					"unit":     map[string]interface{}{"type": "string", "enum": []string{"celsius", "fahrenheit"}},
+				},
+				"required": []string{"location"},
+			},
+		},
+	}}
+	kwargs := map[string]interface{}{"bos_token": "<s>", "eos_token": "</s>", "date_string": "26 Jul 2024"}
+
+	requests := map[string]RenderJinjaTemplateRequest{
+		"System prompt": {Conversations: conversation},
+		"No system prompt": {
+			Conversations:       conversation[1:],
+			AddGenerationPrompt: true,
+		},
+		"Tools": {
+			Conversations:       conversation,
+			Tools:               tools,
+			AddGenerationPrompt: true,
+		},
+		"Single message": {Conversations: conversation[3:]},
+	}
+
+	ctx := context.Background()
+	for _, path := range paths {
+		source, err := os.ReadFile(path)
+		require.NoError(t, err)
+		_, err = native.compile(string(source))
+		require.NoError(t, err, "Chat template %s should compile natively", path)
+
+		for name, request := range requests {
+			t.Run(strings.TrimSuffix(filepath.Base(path), ".jinja")+"/"+name, func(t *testing.T) {
+				request.ChatTemplate = string(source)
+				request.ChatTemplateKWArgs = kwargs
+
+				expected, pythonErr := python.RenderChatTemplate(ctx, &request)
+				response, ok := native.render(ctx, &request)
+				if pythonErr != nil {
+					// Templates raising exceptions are left to Python.
+					assert.False(t, ok, "Native renderer should fall back on errors: %v", pythonErr)
+					return
+				}
+
+				require.True(t, ok, "Native renderer should render the request")
+				assert.Equal(t, expected.RenderedChats, response.RenderedChats)
+				assert.Equal(t, expected.GenerationIndices, response.GenerationIndices)
+			})
+		}
+	}
+}
+
+// TestNativeRenderFallback tests that requests the native renderer does not
+// support are left to Python.
+func TestNativeRenderFallback(t *testing.T) {
+	native, err := newNativeRenderer()
+	require.NoError(t, err)
+
+	conversation := []ChatMessage{{Role: "user", Content: "Hi"}}
+	template := `{% for message in messages %}{{ message.content }}{% endfor %}`
+	tests := []struct {
+		name    string
+		request RenderJinjaTemplateRequest
+	}{
+		{
+			name:    "Unsupported filter",
+			request: RenderJinjaTemplateRequest{Conversations: conversation, ChatTemplate: "{{ messages | nonexistent }}"},
+		},
+		{
+			name: "Assistant tokens mask",
+			request: RenderJinjaTemplateRequest{Conversations: conversation, ChatTemplate: template,
+				ReturnAssistantTokensMask: true},
+		},
+		{
+			name: "Continue final message",
+			request: RenderJinjaTemplateRequest{Conversations: conversation, ChatTemplate: template,
+				ContinueFinalMessage: true},
+		},
+		{
+			name: "Reserved kwargs",
+			request: RenderJinjaTemplateRequest{Conversations: conversation, ChatTemplate: template,
+				ChatTemplateKWArgs: map[string]interface{}{"tools": []interface{}{}}},
+		},
+		{
+			name: "Tools that are not objects",
+			request: RenderJinjaTemplateRequest{Conversations: conversation, ChatTemplate: template,
+				Tools: []interface{}{"get_weather"}},
+		},
+		{
+			name: "Raised exception",
+			request: RenderJinjaTemplateRequest{Conversations: conversation,
+				ChatTemplate: "{{ raise_exception('Unsupported role') }}"},
+		},
+	}
+
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			_, ok := native.render(context.Background(), &tt.request)
+			assert.False(t, ok, "Request should fall back to Python")
+		})
+	}
+
+	response, ok := native.render(context.Background(), &RenderJinjaTemplateRequest{
+		Conversations: conversation,
+		ChatTemplate:  template,
+	})
+	require.True(t, ok, "Supported request should render natively")
+	assert.Equal(t, []string{"Hi"}, response.RenderedChats)
+}
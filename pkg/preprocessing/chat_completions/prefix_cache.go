@@ -0,0 +1,229 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package preprocessing
+
+import (
+	"context"
+	"crypto/sha256"
+	"encoding/binary"
+	"encoding/json"
+	"fmt"
+	"strings"
+	"sync/atomic"
+
+	lru "github.com/hashicorp/golang-lru/v2"
+	"k8s.io/klog/v2"
+
+	"github.com/llm-d/llm-d-kv-cache-manager/pkg/kvcache/metrics"
+	"github.com/llm-d/llm-d-kv-cache-manager/pkg/utils/logging"
+)
+
+// prefixVerifications is the number of prefix renders of a template context
+// checked against a full render before the context is trusted.
+const prefixVerifications = 4
+
+// prefixKey identifies a conversation prefix: a chain hash over the render
+// context (template, tools, documents and kwargs) and the prefix's messages.
+type prefixKey [sha256.Size]byte
+
+// renderedPrefix is a memoized render of a conversation prefix.
+type renderedPrefix struct {
+	rendered            string
+	addGenerationPrompt bool
+}
+
+// prefixStability tracks whether a template context is prefix-stable: whether
+// rendering a conversation extending a prefix appends to the prefix's render.
+type prefixStability struct {
+	verified atomic.Int32
+	unstable atomic.Bool
+}
+
+// prefixCache memoizes rendered conversations, so that a conversation
+// extending a previously rendered one, like the next turn of a chat, only
+// renders its new messages.
+//
+// The new messages are rendered after an anchor standing in for the cached
+// prefix: its first message, which templates test for system prompts, and its
+// last message, with one more if needed to keep the index parity templates
+// test for role alternation. The render of the anchor alone is then cut from
+// the front. Templates for which this does not hold are detected by checking
+// that the render of the anchor is a prefix of the render with the new
+// messages, and by comparing the first prefixVerifications prefix renders of
+// each template context with a full render. Template contexts failing either
+// check are always rendered in full.
+type prefixCache struct {
+	renders   *lru.Cache[prefixKey, renderedPrefix]
+	stability *lru.Cache[prefixKey, *prefixStability]
+}
+
+func newPrefixCache(size int) (*prefixCache, error) {
+	renders, err := lru.New[prefixKey, renderedPrefix](size)
+	if err != nil {
+		return nil, fmt.Errorf("failed to create rendered prefix cache: %w", err)
+	}
+	stability, err := lru.New[prefixKey, *prefixStability](size)
+	if err != nil {
+		return nil, fmt.Errorf("failed to create prefix stability cache: %w", err)
+	}
+	return &prefixCache{renders: renders, stability: stability}, nil
+}
+
+// prefixLookup is the result of looking up the prefixes of a request.
+type prefixLookup struct {
+	req *RenderJinjaTemplateRequest
+	// keys holds the key of each prefix, keys[k-1] being that of the first k
+	// messages.
+	keys      []prefixKey
+	stability *prefixStability
+	// length is the number of messages of the longest cached prefix, if any.
+	length int
+	prefix renderedPrefix
+}
+
+// lookup finds the longest cached prefix of a request. It returns nil for
+// requests whose render is not memoized: those without messages, and those
+// whose render depends on more than the rendered text.
+func (p *prefixCache) lookup(req *RenderJinjaTemplateRequest) *prefixLookup {
+	if len(req.Conversations) == 0 || req.ReturnAssistantTokensMask || req.ContinueFinalMessage {
+		return nil
+	}
+	// Hashed tools and documents are keyed by their hash, sparing their encoding.
+	tools, documents := interface{}(req.Tools), interface{}(req.Documents)
+	if req.ToolsHash != "" {
+		tools = req.ToolsHash
+	}
+	if req.DocumentsHash != "" {
+		documents = req.DocumentsHash
+	}
+	renderContext, err := json.Marshal([]interface{}{req.ChatTemplate, tools, documents, req.ChatTemplateKWArgs})
+	if err != nil {
+		return nil
+	}
+
+	found := &prefixLookup{req: req, keys: make([]prefixKey, len(req.Conversations))}
+	key := prefixKey(sha256.Sum256(renderContext))
+	found.stability = &prefixStability{}
+	if stability, ok, _ := p.stability.PeekOrAdd(key, found.stability); ok {
+		found.stability = stability
+	}
+
+	hash := sha256.New()
+	var lengths [8]byte
+	for i := range req.Conversations {
+		hash.Reset()
+		hash.Write(key[:])
+		binary.LittleEndian.PutUint32(lengths[:4], uint32(len(req.Conversations[i].Role)))    //nolint:gosec // sizes
+		binary.LittleEndian.PutUint32(lengths[4:], uint32(len(req.Conversations[i].Content))) //nolint:gosec // sizes
+		hash.Write(lengths[:])
+		hash.Write([]byte(req.Conversations[i].Role))
+		hash.Write([]byte(req.Conversations[i].Content))
+		hash.Sum(key[:0])
+		found.keys[i] = key
+	}
+
+	for length := len(found.keys); length > 0; length-- {
+		if prefix, ok := p.renders.Get(found.keys[length-1]); ok {
+			found.length, found.prefix = length, prefix
+			break
+		}
+	}
+	return found
+}
+
+// add memoizes the render of a looked up request.
+func (p *prefixCache) add(found *prefixLookup, response *RenderJinjaTemplateResponse) {
+	if found == nil || found.stability.unstable.Load() || len(response.RenderedChats) != 1 {
+		return
+	}
+	p.renders.Add(found.keys[len(found.keys)-1], renderedPrefix{
+		rendered:            response.RenderedChats[0],
+		addGenerationPrompt: found.req.AddGenerationPrompt,
+	})
+}
+
+// prefixAnchor returns the messages standing in for the first `length`
+// messages of a conversation.
+func prefixAnchor(messages []ChatMessage, length int) []ChatMessage {
+	if length <= 3 {
+		return messages[:length:length]
+	}
+	tail := 1 + length%2
+	anchor := make([]ChatMessage, 0, 1+tail)
+	anchor = append(anchor, messages[0])
+	return append(anchor, messages[length-tail:length]...)
+}
+
+// renderFromPrefix renders a request from its longest cached prefix, if any
+// and if its template context is prefix-stable.
+func (w *ChatTemplatingProcessor) renderFromPrefix(ctx context.Context,
+	found *prefixLookup,
+) (*RenderJinjaTemplateResponse, bool) {
+	traceLogger := klog.FromContext(ctx).V(logging.TRACE).WithName("renderFromPrefix")
+	req := found.req
+	if found.length == len(req.Conversations) && found.prefix.addGenerationPrompt == req.AddGenerationPrompt {
+		metrics.RenderPrefixCacheLookups.WithLabelValues("exact").Inc()
+		return &RenderJinjaTemplateResponse{
+			RenderedChats:     []string{found.prefix.rendered},
+			GenerationIndices: [][][]int{{}},
+		}, true
+	}
+	if found.length == 0 || found.length == len(req.Conversations) || found.stability.unstable.Load() {
+		metrics.RenderPrefixCacheLookups.WithLabelValues("miss").Inc()
+		return nil, false
+	}
+
+	anchor := prefixAnchor(req.Conversations, found.length)
+	anchorReq, extendedReq := *req, *req
+	anchorReq.Conversations = anchor
+	anchorReq.AddGenerationPrompt = found.prefix.addGenerationPrompt
+	extendedReq.Conversations = append(anchor, req.Conversations[found.length:]...)
+
+	responses, err := w.RenderChatTemplatesBatch(ctx, []*RenderJinjaTemplateRequest{&anchorReq, &extendedReq})
+	if err != nil || len(responses[0].RenderedChats) != 1 || len(responses[1].RenderedChats) != 1 {
+		// Left to the full render, to report its own error.
+		metrics.RenderPrefixCacheLookups.WithLabelValues("miss").Inc()
+		return nil, false
+	}
+	anchorRendered, extended := responses[0].RenderedChats[0], responses[1]
+	if !strings.HasPrefix(extended.RenderedChats[0], anchorRendered) {
+		traceLogger.Info("Template is not prefix-stable", "messages", len(req.Conversations))
+		found.stability.unstable.Store(true)
+		metrics.RenderPrefixCacheLookups.WithLabelValues("unstable").Inc()
+		return nil, false
+	}
+
+	response := *extended
+	response.RenderedChats = []string{found.prefix.rendered + extended.RenderedChats[0][len(anchorRendered):]}
+	if found.stability.verified.Load() < prefixVerifications {
+		full, err := w.renderFull(ctx, req)
+		if err != nil {
+			return nil, false
+		}
+		if len(full.RenderedChats) != 1 || full.RenderedChats[0] != response.RenderedChats[0] {
+			traceLogger.Info("Template failed prefix render verification", "messages", len(req.Conversations))
+			found.stability.unstable.Store(true)
+			metrics.RenderPrefixCacheLookups.WithLabelValues("unstable").Inc()
+			return full, true
+		}
+		found.stability.verified.Add(1)
+	}
+
+	metrics.RenderPrefixCacheLookups.WithLabelValues("prefix").Inc()
+	w.prefixes.add(found, &response)
+	return &response, true
+}
@@ -0,0 +1,71 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package preprocessing //nolint:testpackage // tests the unexported prefix cache
+
+import (
+	"fmt"
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+	"github.com/stretchr/testify/require"
+)
+
+func chatMessages(count int) []ChatMessage {
+	messages := make([]ChatMessage, count)
+	for i := range messages {
+		messages[i] = ChatMessage{Role: "user", Content: fmt.Sprintf("message %d", i)}
+	}
+	return messages
+}
+
+func TestPrefixAnchor(t *testing.T) {
+	messages := chatMessages(8)
+	for length := 1; length <= len(messages); length++ {
+		anchor := prefixAnchor(messages, length)
+		assert.Equal(t, messages[0], anchor[0], "Anchor should start with the first message")
+		assert.Equal(t, messages[length-1], anchor[len(anchor)-1], "Anchor should end with the last message")
+		assert.Equal(t, length%2, len(anchor)%2, "Anchor should keep the index parity")
+		assert.LessOrEqual(t, len(anchor), 3)
+	}
+}
+
+func TestPrefixCacheLookup(t *testing.T) {
+	prefixes, err := newPrefixCache(16)
+	require.NoError(t, err)
+
+	req := &RenderJinjaTemplateRequest{Conversations: chatMessages(3), ChatTemplate: "template"}
+	found := prefixes.lookup(req)
+	require.NotNil(t, found)
+	assert.Zero(t, found.length, "Nothing should be cached yet")
+	prefixes.add(found, &RenderJinjaTemplateResponse{RenderedChats: []string{"rendered"}})
+
+	extended := &RenderJinjaTemplateRequest{Conversations: chatMessages(5), ChatTemplate: "template"}
+	found = prefixes.lookup(extended)
+	require.NotNil(t, found)
+	assert.Equal(t, 3, found.length, "Should find the rendered prefix")
+	assert.Equal(t, "rendered", found.prefix.rendered)
+
+	other := &RenderJinjaTemplateRequest{Conversations: chatMessages(5), ChatTemplate: "other template"}
+	assert.Zero(t, prefixes.lookup(other).length, "Prefixes should not be shared across templates")
+
+	edited := &RenderJinjaTemplateRequest{Conversations: chatMessages(5), ChatTemplate: "template"}
+	edited.Conversations[1].Content = "edited"
+	assert.Zero(t, prefixes.lookup(edited).length, "Edited prefixes should not match")
+
+	masked := &RenderJinjaTemplateRequest{Conversations: chatMessages(5), ReturnAssistantTokensMask: true}
+	assert.Nil(t, prefixes.lookup(masked), "Assistant token masks should not be memoized")
+}
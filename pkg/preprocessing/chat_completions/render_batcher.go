@@ -0,0 +1,132 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package preprocessing
+
+import (
+	"context"
+	"sync"
+	"time"
+)
+
+// defaultMaxBatchSize is the default maximum number of renders coalesced into
+// one Python call.
+const defaultMaxBatchSize = 32
+
+// batchRenderFunc renders a batch of requests, returning the response or the
+// error of each.
+type batchRenderFunc func(ctx context.Context,
+	reqs []*RenderJinjaTemplateRequest) ([]*RenderJinjaTemplateResponse, []error)
+
+// batchedRender is a render waiting in a renderBatcher.
+type batchedRender struct {
+	req      *RenderJinjaTemplateRequest
+	response *RenderJinjaTemplateResponse
+	err      error
+	done     chan struct{}
+}
+
+// renderBatcher coalesces concurrent renders into batches. A batch is
+// rendered once `window` has passed since its first render joined, or as
+// soon as it holds maxSize renders, on the goroutine of the render that
+// filled it.
+type renderBatcher struct {
+	window      time.Duration
+	maxSize     int
+	renderBatch batchRenderFunc
+
+	mu         sync.Mutex
+	pending    []*batchedRender
+	pendingCtx context.Context // of the first pending render
+	generation uint64          // incremented when a batch is taken
+}
+
+func newRenderBatcher(window time.Duration, maxSize int, renderBatch batchRenderFunc) *renderBatcher {
+	return &renderBatcher{
+		window:      window,
+		maxSize:     maxSize,
+		renderBatch: renderBatch,
+	}
+}
+
+// render adds a request to the current batch and waits for its response.
+func (b *renderBatcher) render(ctx context.Context,
+	req *RenderJinjaTemplateRequest,
+) (*RenderJinjaTemplateResponse, error) {
+	call := &batchedRender{req: req, done: make(chan struct{})}
+
+	b.mu.Lock()
+	b.pending = append(b.pending, call)
+	if len(b.pending) == 1 {
+		// The batch outlives the caller that opened it.
+		b.pendingCtx = context.WithoutCancel(ctx)
+		generation := b.generation
+		time.AfterFunc(b.window, func() { b.flush(generation) })
+	}
+	var batch []*batchedRender
+	var batchCtx context.Context
+	if len(b.pending) >= b.maxSize {
+		batch, batchCtx = b.take()
+	}
+	b.mu.Unlock()
+
+	if batch != nil {
+		b.run(batchCtx, batch)
+	}
+
+	select {
+	case <-call.done:
+		return call.response, call.err
+	case <-ctx.Done():
+		// The response, if any, is dropped.
+		return nil, ctx.Err()
+	}
+}
+
+// flush renders the batch opened in `generation`, unless it was already
+// taken.
+func (b *renderBatcher) flush(generation uint64) {
+	b.mu.Lock()
+	if b.generation != generation || len(b.pending) == 0 {
+		b.mu.Unlock()
+		return
+	}
+	batch, ctx := b.take()
+	b.mu.Unlock()
+
+	b.run(ctx, batch)
+}
+
+// take removes the pending batch. The caller must hold mu.
+func (b *renderBatcher) take() ([]*batchedRender, context.Context) {
+	batch, ctx := b.pending, b.pendingCtx
+	b.pending, b.pendingCtx = nil, nil
+	b.generation++
+	return batch, ctx
+}
+
+func (b *renderBatcher) run(ctx context.Context, batch []*batchedRender) {
+	reqs := make([]*RenderJinjaTemplateRequest, len(batch))
+	for i, call := range batch {
+		reqs[i] = call.req
+	}
+
+	responses, errs := b.renderBatch(ctx, reqs)
+	for i, call := range batch {
+		call.response, call.err = responses[i], errs[i]
+		close(call.done)
+	}
+}
@@ -0,0 +1,121 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package preprocessing //nolint:testpackage // tests the unexported render batcher
+
+import (
+	"context"
+	"fmt"
+	"sync"
+	"testing"
+	"time"
+
+	"github.com/stretchr/testify/assert"
+	"github.com/stretchr/testify/require"
+)
+
+// echoBatches is a batchRenderFunc rendering each request as its first
+// message content, recording the size of each batch.
+type echoBatches struct {
+	mu    sync.Mutex
+	sizes []int
+}
+
+func (e *echoBatches) render(_ context.Context,
+	reqs []*RenderJinjaTemplateRequest,
+) ([]*RenderJinjaTemplateResponse, []error) {
+	e.mu.Lock()
+	e.sizes = append(e.sizes, len(reqs))
+	e.mu.Unlock()
+
+	responses := make([]*RenderJinjaTemplateResponse, len(reqs))
+	errs := make([]error, len(reqs))
+	for i, req := range reqs {
+		if req.Conversations[0].Content == "fail" {
+			errs[i] = fmt.Errorf("render failed")
+			continue
+		}
+		responses[i] = &RenderJinjaTemplateResponse{RenderedChats: []string{req.Conversations[0].Content}}
+	}
+	return responses, errs
+}
+
+func echoRequest(content string) *RenderJinjaTemplateRequest {
+	return &RenderJinjaTemplateRequest{Conversations: []ChatMessage{{Role: "user", Content: content}}}
+}
+
+// TestRenderBatcherCoalesces tests that concurrent renders are rendered in
+// batches of at most maxSize, each getting its own response.
+func TestRenderBatcherCoalesces(t *testing.T) {
+	const renders, maxSize = 16, 4
+	batches := &echoBatches{}
+	batcher := newRenderBatcher(time.Hour, maxSize, batches.render)
+
+	var wg sync.WaitGroup
+	for i := 0; i < renders; i++ {
+		wg.Add(1)
+		go func(i int) {
+			defer wg.Done()
+			content := fmt.Sprintf("request %d", i)
+			response, err := batcher.render(context.Background(), echoRequest(content))
+			if assert.NoError(t, err) {
+				assert.Equal(t, []string{content}, response.RenderedChats, "Should get its own response")
+			}
+		}(i)
+	}
+	wg.Wait()
+
+	// With an hour-long window, only full batches can have been rendered.
+	assert.Equal(t, []int{maxSize, maxSize, maxSize, maxSize}, batches.sizes)
+}
+
+// TestRenderBatcherWindow tests that a batch that is not full is rendered
+// once the window has passed, and that errors reach their render only.
+func TestRenderBatcherWindow(t *testing.T) {
+	batches := &echoBatches{}
+	batcher := newRenderBatcher(10*time.Millisecond, 8, batches.render)
+
+	var wg sync.WaitGroup
+	var failErr error
+	wg.Add(1)
+	go func() {
+		defer wg.Done()
+		_, failErr = batcher.render(context.Background(), echoRequest("fail"))
+	}()
+	response, err := batcher.render(context.Background(), echoRequest("ok"))
+	wg.Wait()
+
+	require.NoError(t, err)
+	assert.Equal(t, []string{"ok"}, response.RenderedChats)
+	assert.Error(t, failErr, "Failed render should get its error")
+
+	total := 0
+	for _, size := range batches.sizes {
+		total += size
+	}
+	assert.Equal(t, 2, total, "Both renders should have been batched")
+}
+
+// TestRenderBatcherCanceled tests that a caller stops waiting when its context
+// is canceled.
+func TestRenderBatcherCanceled(t *testing.T) {
+	batcher := newRenderBatcher(time.Hour, 8, (&echoBatches{}).render)
+
+	ctx, cancel := context.WithTimeout(context.Background(), 10*time.Millisecond)
+	defer cancel()
+	_, err := batcher.render(ctx, echoRequest("late"))
+	assert.ErrorIs(t, err, context.DeadlineExceeded)
+}
@@ -0,0 +1,234 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package preprocessing_test
+
+import (
+	"context"
+	"encoding/json"
+	"fmt"
+	"os"
+	"path/filepath"
+	"slices"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"testing"
+	"time"
+
+	preprocessing "github.com/llm-d/llm-d-kv-cache-manager/pkg/preprocessing/chat_completions"
+	"github.com/stretchr/testify/require"
+)
+
+// benchGoroutines are the numbers of goroutines rendering concurrently in
+// each render benchmark.
+var benchGoroutines = []int{1, 2, 4, 8, 16}
+
+// benchTemplateKWArgs are the template variables of the testdata templates.
+var benchTemplateKWArgs = map[string]interface{}{
+	"bos_token": "<s>", "eos_token": "</s>", "date_string": "26 Jul 2024",
+}
+
+// BenchmarkRenderConcurrent benchmarks Python renders on the interpreter pool
+// from 1 to 16 concurrent goroutines, varying one of the template, the prompt
+// size and the tool schemas size at a time, to quantify GIL contention. Each
+// benchmark reports its throughput, its p50 and p99 latencies and its
+// allocations per render.
+//
+// Run it with: go test -run '^$' -bench BenchmarkRenderConcurrent.
+func BenchmarkRenderConcurrent(b *testing.B) {
+	wrapper := getGlobalWrapper()
+	templates := loadBenchTemplates(b)
+
+	type benchCase struct {
+		name     string
+		template string
+		prompt   int
+		tools    int
+		hashed   bool
+	}
+	var cases []benchCase
+	names := make([]string, 0, len(templates))
+	for name := range templates {
+		names = append(names, name)
+	}
+	slices.Sort(names)
+	for _, name := range names {
+		cases = append(cases, benchCase{name: "template=" + name, template: name, prompt: 4 << 10})
+	}
+	for _, size := range []int{1 << 10, 16 << 10, 256 << 10, 1 << 20} {
+		cases = append(cases, benchCase{name: "prompt=" + formatBenchSize(size), template: "llama-3.1", prompt: size})
+	}
+	for _, size := range []int{4 << 10, 48 << 10} {
+		for _, hashed := range []bool{false, true} {
+			cases = append(cases, benchCase{
+				name:     fmt.Sprintf("tools=%s/hashed=%t", formatBenchSize(size), hashed),
+				template: "llama-3.1", prompt: 4 << 10, tools: size, hashed: hashed,
+			})
+		}
+	}
+
+	for _, bc := range cases {
+		request := &preprocessing.RenderJinjaTemplateRequest{
+			Conversations:       benchConversation(bc.prompt),
+			Tools:               benchTools(b, bc.tools),
+			ChatTemplate:        templates[bc.template],
+			AddGenerationPrompt: true,
+			ChatTemplateKWArgs:  benchTemplateKWArgs,
+		}
+		if bc.hashed {
+			hash, err := preprocessing.HashPayload(request.Tools)
+			require.NoError(b, err)
+			request.ToolsHash = hash
+		}
+		_, err := wrapper.RenderChatTemplate(context.Background(), request)
+		require.NoError(b, err, "Benchmark request %s should render", bc.name)
+
+		for _, goroutines := range benchGoroutines {
+			b.Run(fmt.Sprintf("%s/goroutines=%d", bc.name, goroutines), func(b *testing.B) {
+				runConcurrentRenders(b, goroutines, func() error {
+					_, err := wrapper.RenderChatTemplate(context.Background(), request)
+					return err
+				})
+			})
+		}
+	}
+}
+
+// runConcurrentRenders runs b.N renders from `goroutines` goroutines, and
+// reports their throughput and latency percentiles.
+func runConcurrentRenders(b *testing.B, goroutines int, render func() error) {
+	b.Helper()
+	b.ReportAllocs()
+
+	var remaining atomic.Int64
+	remaining.Store(int64(b.N))
+	latencies := make([][]time.Duration, goroutines)
+	errs := make([]error, goroutines)
+	var wg sync.WaitGroup
+
+	b.ResetTimer()
+	start := time.Now()
+	for g := 0; g < goroutines; g++ {
+		wg.Add(1)
+		go func(g int) {
+			defer wg.Done()
+			for remaining.Add(-1) >= 0 {
+				renderStart := time.Now()
+				if err := render(); err != nil {
+					errs[g] = err
+					return
+				}
+				latencies[g] = append(latencies[g], time.Since(renderStart))
+			}
+		}(g)
+	}
+	wg.Wait()
+	elapsed := time.Since(start)
+	b.StopTimer()
+
+	for _, err := range errs {
+		require.NoError(b, err, "Benchmark should not return errors")
+	}
+	var all []time.Duration
+	for _, goroutineLatencies := range latencies {
+		all = append(all, goroutineLatencies...)
+	}
+	slices.Sort(all)
+	b.ReportMetric(float64(len(all))/elapsed.Seconds(), "renders/s")
+	b.ReportMetric(float64(all[len(all)/2].Nanoseconds()), "p50-ns")
+	b.ReportMetric(float64(all[len(all)*99/100].Nanoseconds()), "p99-ns")
+}
+
+// loadBenchTemplates reads the chat templates in testdata/chat_templates, by
+// name.
+func loadBenchTemplates(b *testing.B) map[string]string {
+	b.Helper()
+	paths, err := filepath.Glob(filepath.Join("testdata", "chat_templates", "*.jinja"))
+	require.NoError(b, err)
+	require.NotEmpty(b, paths, "Chat templates should be found")
+
+	templates := make(map[string]string, len(paths))
+	for _, path := range paths {
+		source, err := os.ReadFile(path)
+		require.NoError(b, err)
+		templates[strings.TrimSuffix(filepath.Base(path), ".jinja")] = string(source)
+	}
+	return templates
+}
+
+// benchConversation returns a conversation alternating user and assistant
+// messages of 1 KiB at most, with `size` bytes of content in total.
+func benchConversation(size int) []preprocessing.ChatMessage {
+	const messageSize = 1 << 10
+	sentence := "The quick brown fox jumps over the lazy dog, Größe ☃. "
+
+	var messages []preprocessing.ChatMessage
+	for size > 0 {
+		length := min(size, messageSize)
+		role := "user"
+		if len(messages)%2 == 1 {
+			role = "assistant"
+		}
+		content := strings.Repeat(sentence, length/len(sentence)+1)
+		content = strings.ToValidUTF8(content[:length], "")
+		messages = append(messages, preprocessing.ChatMessage{Role: role, Content: content})
+		size -= length
+	}
+	if len(messages)%2 == 0 {
+		// Conversations end with a user message.
+		messages = append(messages, preprocessing.ChatMessage{Role: "user", Content: "Why?"})
+	}
+	return messages
+}
+
+// benchTools returns function tool schemas of about `size` bytes of JSON in
+// total, or nil for 0.
+func benchTools(b *testing.B, size int) []interface{} {
+	b.Helper()
+	var tools []interface{}
+	total := 0
+	for total < size {
+		tool := map[string]interface{}{
+			"type": "function",
+			"function": map[string]interface{}{
+				"name":        fmt.Sprintf("get_weather_%d", len(tools)),
+				"description": "Get the current weather in a given location, in the given unit",
+				"parameters": map[string]interface{}{
+					"type": "object",
+					"properties": map[string]interface{}{
+						"location": map[string]interface{}{"type": "string", "description": "City, e.g. Paris"},
+						"unit":     map[string]interface{}{"type": "string", "enum": []string{"celsius", "fahrenheit"}},
+					},
+					"required": []string{"location"},
+				},
+			},
+		}
+		data, err := json.Marshal(tool)
+		require.NoError(b, err)
+		tools = append(tools, tool)
+		total += len(data)
+	}
+	return tools
+}
+
+// formatBenchSize formats a size in bytes for benchmark names.
+func formatBenchSize(size int) string {
+	if size >= 1<<20 {
+		return fmt.Sprintf("%dMiB", size>>20)
+	}
+	return fmt.Sprintf("%dKiB", size>>10)
+}
@@ -0,0 +1,210 @@
+# Copyright 2025 The llm-d Authors.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+#!/usr/bin/env python3
+"""
+Out-of-process worker for render_jinja_template_wrapper, started by the Go
+ChatTemplatingProcessor in the "process" render mode.
+
+Requests and responses are exchanged as frames over two shared memory rings,
+one per direction. The layout is defined in shm_ring.go and mirrored here.
+After writing frames, each side writes a byte to a pipe (the doorbell) so the
+other side can block on it instead of polling.
+
+Usage: python -m render_jinja_template_worker <ring_size>
+The shared memory, the request doorbell and the response doorbell are
+inherited as file descriptors 3, 4 and 5.
+"""
+
+import mmap
+import os
+import struct
+import sys
+import time
+
+import render_jinja_template_wrapper as wrapper
+
+SHM_FD = 3
+REQUEST_DOORBELL_FD = 4
+RESPONSE_DOORBELL_FD = 5
+
+# Ring layout, see shm_ring.go.
+RING_HEAD_OFFSET = 0
+RING_TAIL_OFFSET = 64
+RING_HEADER_SIZE = 128
+FRAME_HEADER = struct.Struct("<IIQ")
+FRAME_ALIGNMENT = 16
+POSITION = struct.Struct("=Q")
+
+# Frame kinds, see shm_ring.go.
+FRAME_RENDER = 1
+FRAME_FETCH = 2
+FRAME_OK = 3
+FRAME_ERROR = 4
+FRAME_READY = 5
+FRAME_NOT_CACHED = 6
+FRAME_WRAP = 0xFFFFFFFF
+
+# Render result layout, see wire_format.go.
+RESULT_HEADER = struct.Struct("<II")
+CHAT_HEADER = struct.Struct("<II")
+SPAN = struct.Struct("<qq")
+
+# How long to wait for the Go side to drain a full response ring.
+FULL_RING_BACKOFF = 0.0001
+
+
+def _frame_size(payload_len):
+    return (FRAME_HEADER.size + payload_len + FRAME_ALIGNMENT - 1) & ~(FRAME_ALIGNMENT - 1)
+
+
+class Ring:
+    """Single-producer single-consumer frame queue over shared memory.
+
+    Frames are limited to half the capacity by the caller, see shm_ring.go.
+    Positions are published with plain stores after the frames they cover,
+    which the Go side only sees in that order on x86 (total store order), so
+    process render mode is limited to amd64.
+    """
+
+    def __init__(self, mem, offset, capacity):
+        self.mem = mem
+        self.base = offset
+        self.data = offset + RING_HEADER_SIZE
+        self.capacity = capacity
+
+    def _load(self, offset):
+        return POSITION.unpack_from(self.mem, self.base + offset)[0]
+
+    def _store(self, offset, value):
+        POSITION.pack_into(self.mem, self.base + offset, value)
+
+    def read(self):
+        """Pop the next frame as (kind, id, payload), or return None."""
+        head = self._load(RING_HEAD_OFFSET)
+        tail = self._load(RING_TAIL_OFFSET)
+        while head != tail:
+            offset = head % self.capacity
+            length, kind, frame_id = FRAME_HEADER.unpack_from(self.mem, self.data + offset)
+            if kind == FRAME_WRAP:
+                head += self.capacity - offset
+                continue
+
+            start = self.data + offset + FRAME_HEADER.size
+            payload = bytes(self.mem[start:start + length])
+            self._store(RING_HEAD_OFFSET, head + _frame_size(length))
+            return kind, frame_id, payload
+
+        self._store(RING_HEAD_OFFSET, head)
+        return None
+
+    def write(self, kind, frame_id, payload):
+        """Append a frame. Returns False if the ring has no room for it yet."""
+        size = _frame_size(len(payload))
+        head = self._load(RING_HEAD_OFFSET)
+        tail = self._load(RING_TAIL_OFFSET)
+
+        offset = tail % self.capacity
+        contiguous = self.capacity - offset
+        needed = size + contiguous if contiguous < size else size
+        if tail + needed - head > self.capacity:
+            return False
+
+        if contiguous < size:
+            FRAME_HEADER.pack_into(self.mem, self.data + offset, 0, FRAME_WRAP, 0)
+            tail += contiguous
+            offset = 0
+
+        FRAME_HEADER.pack_into(self.mem, self.data + offset, len(payload), kind, frame_id)
+        start = self.data + offset + FRAME_HEADER.size
+        self.mem[start:start + len(payload)] = payload
+        self._store(RING_TAIL_OFFSET, tail + size)
+        return True
+
+
+def _send(responses, kind, frame_id, payload, parent_pid):
+    """Write a response frame, waiting for the Go side to free ring space."""
+    max_payload = responses.capacity // 2 - FRAME_HEADER.size
+    if len(payload) > max_payload:
+        kind = FRAME_ERROR
+        payload = f"response of {len(payload)} bytes exceeds the ring frame limit of {max_payload} bytes".encode()
+
+    while not responses.write(kind, frame_id, payload):
+        if os.getppid() != parent_pid:
+            sys.exit(1)  # the Go process is gone and will never drain the ring
+        time.sleep(FULL_RING_BACKOFF)
+    os.write(RESPONSE_DOORBELL_FD, b"\x01")
+
+
+def _encode_render_result(rendered_chats, generation_indices):
+    """Encode a render result in the binary layout decoded by wire_format.go."""
+    spans = [generation_indices[i] if i < len(generation_indices) else []
+             for i in range(len(rendered_chats))]
+    parts = [RESULT_HEADER.pack(len(rendered_chats), sum(len(s) for s in spans))]
+    for chat, chat_spans in zip(rendered_chats, spans):
+        data = chat.encode()
+        parts.append(CHAT_HEADER.pack(len(data), len(chat_spans)))
+        parts.append(data)
+        parts.extend(SPAN.pack(start, end) for start, end in chat_spans)
+    return b"".join(parts)
+
+
+def _handle(kind, payload):
+    """Run a request frame and return the response (kind, payload)."""
+    try:
+        request_json = payload.decode()
+        if kind == FRAME_RENDER:
+            rendered = wrapper.render_jinja_template_raw(request_json)
+            if rendered is None:
+                return FRAME_NOT_CACHED, b""
+            return FRAME_OK, _encode_render_result(*rendered)
+        elif kind == FRAME_FETCH:
+            result = wrapper.get_model_chat_template(request_json)
+        else:
+            raise ValueError(f"unknown request kind {kind}")
+        return FRAME_OK, result.encode()
+    except Exception as e:
+        return FRAME_ERROR, f"{type(e).__name__}: {e}".encode()
+
+
+def main():
+    if len(sys.argv) != 2:
+        print("Usage: python -m render_jinja_template_worker <ring_size>")
+        return 2
+
+    ring_size = int(sys.argv[1])
+    region_size = RING_HEADER_SIZE + ring_size
+    mem = mmap.mmap(SHM_FD, 2 * region_size)
+    requests = Ring(mem, 0, ring_size)
+    responses = Ring(mem, region_size, ring_size)
+
+    parent_pid = os.getppid()
+    if not wrapper._ensure_transformers_available():
+        return 1
+    _send(responses, FRAME_READY, 0, b"", parent_pid)
+
+    # A closed request doorbell means the Go side is shutting the worker down.
+    while os.read(REQUEST_DOORBELL_FD, 4096):
+        frame = requests.read()
+        while frame is not None:
+            kind, frame_id, payload = frame
+            response_kind, response = _handle(kind, payload)
+            _send(responses, response_kind, frame_id, response, parent_pid)
+            frame = requests.read()
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -20,6 +20,7 @@ Standalone wrapper for render_jinja_template function from transformers.
 import json
 import logging
 import sys
+from collections import OrderedDict
 from typing import Optional, Union
 
 # Import core functions from transformers - moved to function level to avoid import errors
@@ -50,6 +51,24 @@ logger = logging.getLogger(__name__)
 _template_cache = {}
 _cache_lock = None
 
+# Chat templates of render requests, keyed by the hash the Go side sends in
+# place of the template once it has sent it. Rendering with the same str
+# object every time turns transformers' compiled-template cache lookup into an
+# identity check, instead of hashing and comparing the whole template.
+RENDER_TEMPLATE_CACHE_SIZE = 128
+_render_template_cache = OrderedDict()
+
+# Tools and documents of render requests, keyed by the content hash the Go side
+# sends in their place once it has sent them, so that repeat requests carrying
+# the same large tool schemas skip encoding and parsing them.
+INTERNED_PAYLOAD_CACHE_SIZE = 64
+_interned_payloads = OrderedDict()
+
+# Fast tokenizers of render_and_tokenize_raw requests, keyed by model, revision
+# and token. 1 tokenizer per base-model, like the Go tokenizer cache.
+TOKENIZER_CACHE_SIZE = 20
+_tokenizer_cache = OrderedDict()
+
 def _get_cache_lock():
     """Get or create a threading lock for cache access."""
     global _cache_lock
@@ -75,49 +94,225 @@ def clear_caches():
     with lock:
         global _template_cache
         _template_cache.clear()
+        _render_template_cache.clear()
+        _interned_payloads.clear()
+        _tokenizer_cache.clear()
     return "Caches cleared"
 
 
-def render_jinja_template(request_json):
+def _resolve_chat_template(request):
     """
-    Render a chat template using the transformers library.
-    This function is aligned with the Go cgo_functions.go structs.
+    Replace the chat_template_hash of a request with its chat template.
+    Requests carrying both register the template under the hash.
+
+    Returns:
+        bool: False if the request only has a hash that is not cached.
+    """
+    template_hash = request.pop('chat_template_hash', None)
+    if template_hash is None:
+        return True
+
+    lock = _get_cache_lock()
+    with lock:
+        chat_template = request.get('chat_template')
+        if chat_template is None:
+            chat_template = _render_template_cache.get(template_hash)
+            if chat_template is None:
+                return False
+            _render_template_cache.move_to_end(template_hash)
+            request['chat_template'] = chat_template
+        else:
+            _render_template_cache[template_hash] = chat_template
+            _render_template_cache.move_to_end(template_hash)
+            if len(_render_template_cache) > RENDER_TEMPLATE_CACHE_SIZE:
+                _render_template_cache.popitem(last=False)
+    return True
+
+
+def _resolve_payloads(request):
+    """
+    Replace the tools_hash and documents_hash of a request with the tools and
+    documents interned under them. Requests carrying both intern the payload.
+
+    Returns:
+        bool: False if the request only has a hash that is not interned.
+    """
+    resolved = True
+    lock = _get_cache_lock()
+    with lock:
+        for key in ('tools', 'documents'):
+            payload_hash = request.pop(key + '_hash', None)
+            if payload_hash is None:
+                continue
+            payload = request.get(key)
+            if payload is None:
+                payload = _interned_payloads.get(payload_hash)
+                if payload is None:
+                    resolved = False
+                    continue
+                _interned_payloads.move_to_end(payload_hash)
+                request[key] = payload
+            else:
+                _interned_payloads[payload_hash] = payload
+                _interned_payloads.move_to_end(payload_hash)
+                if len(_interned_payloads) > INTERNED_PAYLOAD_CACHE_SIZE:
+                    _interned_payloads.popitem(last=False)
+    return resolved
+
+
+def render_jinja_template_raw(request_json):
+    """
+    Render a chat template using the transformers library, without encoding the result.
+    This is the entrypoint used by the C bridge: it returns the Python objects as-is so
+    that the bridge can expose them to Go after releasing the GIL, instead of spending
+    GIL time on json.dumps.
 
     Args:
-        request_json (str): JSON string containing the request parameters:
-            - conversations (list): List of conversation lists
-            - chat_template (str, optional): The template to use
-            - tools (list, optional): Tool schemas
-            - documents (list, optional): Document schemas
-            - return_assistant_tokens_mask (bool, optional): Whether to return assistant tokens mask
-            - continue_final_message (bool, optional): Whether to continue final message
-            - add_generation_prompt (bool, optional): Whether to add generation prompt
-            - kwargs (dict, optional): Additional rendering variables
+        request_json (str or dict): JSON string with the same parameters as
+            render_jinja_template, plus an optional chat_template_hash (see
+            _resolve_chat_template) and tools_hash and documents_hash (see
+            _resolve_payloads), or the request already decoded by the C bridge from
+            its binary wire format.
     Returns:
-        str: JSON string containing 'rendered_chats' and 'generation_indices' keys.
+        tuple: (rendered_chats, generation_indices), where rendered_chats is a list of str
+        and generation_indices is a list (per chat) of (start, end) index pairs, or None
+        if the request refers to a chat template, tools or documents that are not cached.
+    """
+    if not _ensure_transformers_available():
+        raise ImportError("transformers library is required for render_jinja_template")
+
+    if isinstance(request_json, str):
+        request_json = json.loads(request_json)
+    return _render_request(request_json)
+
+
+def render_jinja_template_batch_raw(batch_json):
+    """
+    Render a batch of chat templates in one call, like render_jinja_template_raw does for
+    a single request. This is the entrypoint of the C bridge's batch call: the whole batch
+    is decoded and rendered under a single GIL acquisition.
+
+    Args:
+        batch_json (str or list): JSON array of render_jinja_template_raw requests, or
+            the requests already decoded by the C bridge.
+    Returns:
+        list: per request, in order, the (rendered_chats, generation_indices) tuple, None if
+        the request refers to a chat template that is not cached, or the error message (str)
+        if rendering failed. Requests fail independently of each other.
     """
     if not _ensure_transformers_available():
         raise ImportError("transformers library is required for render_jinja_template")
 
+    if isinstance(batch_json, str):
+        batch_json = json.loads(batch_json)
+    results = []
+    for request in batch_json:
+        try:
+            results.append(_render_request(request))
+        except Exception as e:
+            results.append(f"{type(e).__name__}: {e}")
+    return results
+
+
+def _render_request(request):
+    """Render a decoded render_jinja_template_raw request."""
     # Import the modules we need
     from transformers.utils.chat_template_utils import render_jinja_template as transformers_render_jinja_template
 
-    # Parse the JSON request
-    request = json.loads(request_json)
+    if not _resolve_chat_template(request) or not _resolve_payloads(request):
+        return None
 
     # Align Go's `messages` field with transformers' `conversations` parameter.
     if 'messages' in request:
         request['conversations'] = [request.pop('messages')] # wrap to match expected format
 
-    try:
-        # Get template_vars and spread them as individual arguments
-        template_vars = request.pop('chat_template_kwargs', {})
-        request.update(template_vars)
+    # Get template_vars and spread them as individual arguments
+    template_vars = request.pop('chat_template_kwargs', {})
+    request.update(template_vars)
 
-        rendered_chats, generation_indices = transformers_render_jinja_template(**request)
+    rendered_chats, generation_indices = transformers_render_jinja_template(**request)
+    return rendered_chats, generation_indices
 
-    except Exception as e:
-        raise
+
+def render_and_tokenize_raw(request_json):
+    """
+    Render a chat template and tokenize the rendered chat with the model's fast tokenizer,
+    in one call. This is the entrypoint of the C bridge's fused render and tokenize call:
+    the rendered chat is only handed to the bridge to map the token offsets to bytes.
+
+    Args:
+        request_json (str or dict): a render_jinja_template_raw request with a single
+            conversation and a 'tokenize' dict holding the tokenizer's 'model', and
+            optionally its 'revision', the Hugging Face 'token' and 'add_special_tokens'.
+    Returns:
+        tuple: (rendered_chat, token_ids, offsets), where offsets are the (start, end)
+        character offsets of the tokens in rendered_chat, or None if the request refers to
+        a chat template that is not cached.
+    """
+    if not _ensure_transformers_available():
+        raise ImportError("transformers library is required for render_and_tokenize")
+
+    if isinstance(request_json, str):
+        request_json = json.loads(request_json)
+    tokenize = request_json.pop('tokenize', None)
+    if not tokenize or not tokenize.get('model'):
+        raise ValueError("tokenize.model is required in request")
+
+    result = _render_request(request_json)
+    if result is None:
+        return None
+    rendered_chats, _ = result
+    if len(rendered_chats) != 1:
+        raise ValueError(f"expected a single rendered chat, got {len(rendered_chats)}")
+
+    tokenizer = _get_fast_tokenizer(tokenize.get('model'), tokenize.get('revision'), tokenize.get('token'))
+    encoding = tokenizer.backend_tokenizer.encode(
+        rendered_chats[0], add_special_tokens=bool(tokenize.get('add_special_tokens', False)))
+    return rendered_chats[0], encoding.ids, encoding.offsets
+
+
+def _get_fast_tokenizer(model_name, revision, token):
+    """Load the fast tokenizer of a model, caching the most recently used ones."""
+    cache_key = (model_name, revision or 'main', token)
+    lock = _get_cache_lock()
+    with lock:
+        tokenizer = _tokenizer_cache.get(cache_key)
+        if tokenizer is not None:
+            _tokenizer_cache.move_to_end(cache_key)
+            return tokenizer
+
+    from transformers import AutoTokenizer
+
+    # Loaded outside the lock: concurrent loads of the same tokenizer are redundant, not wrong.
+    tokenizer = AutoTokenizer.from_pretrained(model_name, revision=revision, token=token, trust_remote_code=True)
+    if not getattr(tokenizer, 'is_fast', False):
+        raise ValueError(f"model {model_name} has no fast tokenizer")
+    with lock:
+        _tokenizer_cache[cache_key] = tokenizer
+        if len(_tokenizer_cache) > TOKENIZER_CACHE_SIZE:
+            _tokenizer_cache.popitem(last=False)
+    return tokenizer
+
+
+def render_jinja_template(request_json):
+    """
+    Render a chat template using the transformers library.
+    This function is aligned with the Go cgo_functions.go structs.
+
+    Args:
+        request_json (str): JSON string containing the request parameters:
+            - conversations (list): List of conversation lists
+            - chat_template (str, optional): The template to use
+            - tools (list, optional): Tool schemas
+            - documents (list, optional): Document schemas
+            - return_assistant_tokens_mask (bool, optional): Whether to return assistant tokens mask
+            - continue_final_message (bool, optional): Whether to continue final message
+            - add_generation_prompt (bool, optional): Whether to add generation prompt
+            - kwargs (dict, optional): Additional rendering variables
+    Returns:
+        str: JSON string containing 'rendered_chats' and 'generation_indices' keys.
+    """
+    rendered_chats, generation_indices = render_jinja_template_raw(request_json)
 
     # Return as JSON string, aligning with the Go response struct.
     result = json.dumps({
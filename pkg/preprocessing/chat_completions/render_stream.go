@@ -0,0 +1,144 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package preprocessing
+
+import (
+	"context"
+	"fmt"
+	"unicode/utf8"
+
+	"k8s.io/klog/v2"
+
+	"github.com/llm-d/llm-d-kv-cache-manager/pkg/kvcache/metrics"
+	"github.com/llm-d/llm-d-kv-cache-manager/pkg/utils/logging"
+)
+
+// renderStreamChunkSize is the size from which streamed output is passed on
+// as a chunk.
+const renderStreamChunkSize = 16 << 10
+
+// RenderChunkFunc receives the chunks of a streamed render, in order. A
+// returned error stops the render.
+type RenderChunkFunc func(chunk string) error
+
+// chunkWriter buffers rendered output into chunks of at least
+// renderStreamChunkSize bytes, passed to emit. Chunks end at the boundary of
+// a write, so they are valid UTF-8 when the writes are.
+type chunkWriter struct {
+	emit    RenderChunkFunc
+	buf     []byte
+	emitted bool
+}
+
+func (c *chunkWriter) WriteString(s string) (int, error) {
+	c.buf = append(c.buf, s...)
+	if len(c.buf) >= renderStreamChunkSize {
+		return len(s), c.flush()
+	}
+	return len(s), nil
+}
+
+// flush passes the buffered output on as a chunk.
+func (c *chunkWriter) flush() error {
+	if len(c.buf) == 0 {
+		return nil
+	}
+	c.emitted = true
+	err := c.emit(string(c.buf))
+	c.buf = c.buf[:0]
+	return err
+}
+
+// RenderChatTemplateStream renders a request like RenderChatTemplate, passing
+// the rendered chat to emit in chunks as it is rendered, so that consumers of
+// long prompts can start on the output before the render completes. Chunks
+// are only streamed by the native renderer; requests rendered by Python are
+// passed on in chunks once rendered. The generation indices are not
+// returned.
+//
+// If the native render fails after chunks were passed on, the error is
+// returned and the chunks must be discarded: unlike RenderChatTemplate, the
+// request is not rendered again by Python.
+func (w *ChatTemplatingProcessor) RenderChatTemplateStream(ctx context.Context,
+	req *RenderJinjaTemplateRequest, emit RenderChunkFunc,
+) error {
+	if req == nil {
+		return fmt.Errorf("received nil request")
+	}
+	if len(w.queueDepths) == 0 {
+		return fmt.Errorf("chat templating processor is not initialized")
+	}
+
+	// Stop passing chunks on once the caller is gone.
+	emitChunk := func(chunk string) error {
+		if err := ctx.Err(); err != nil {
+			return err
+		}
+		return emit(chunk)
+	}
+	if ok, err := w.streamNative(ctx, req, &chunkWriter{emit: emitChunk}); ok || err != nil {
+		return err
+	}
+
+	response, err := w.RenderChatTemplate(ctx, req)
+	if err != nil {
+		return err
+	}
+	for _, rendered := range response.RenderedChats {
+		for len(rendered) > 0 {
+			size := min(len(rendered), renderStreamChunkSize)
+			for size < len(rendered) && !utf8.RuneStart(rendered[size]) {
+				size--
+			}
+			if err := emitChunk(rendered[:size]); err != nil {
+				return err
+			}
+			rendered = rendered[size:]
+		}
+	}
+	return nil
+}
+
+// streamNative streams the native render of a request, when enabled. It
+// returns false, with nothing passed on, if the request is left to Python.
+func (w *ChatTemplatingProcessor) streamNative(ctx context.Context,
+	req *RenderJinjaTemplateRequest, out *chunkWriter,
+) (bool, error) {
+	if w.native == nil {
+		return false, nil
+	}
+	template, vars, ok := w.native.prepare(ctx, req)
+	if !ok {
+		return false, nil
+	}
+
+	err := template.RenderTo(out, vars)
+	if err == nil {
+		err = out.flush()
+	}
+	if err != nil && !out.emitted && ctx.Err() == nil {
+		// Left to RenderChatTemplate, to report its own error.
+		klog.FromContext(ctx).V(logging.TRACE).WithName("nativeRender").Info("Native render failed", "reason", err)
+		out.buf = out.buf[:0]
+		return false, nil
+	}
+	if err != nil {
+		return true, fmt.Errorf("streamed native render failed: %w", err)
+	}
+	metrics.RenderedChats.WithLabelValues("native").Inc()
+	return true, nil
+}
@@ -0,0 +1,76 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package preprocessing //nolint:testpackage // tests the unexported chunk size
+
+import (
+	"context"
+	"errors"
+	"strings"
+	"testing"
+	"unicode/utf8"
+
+	"github.com/stretchr/testify/assert"
+	"github.com/stretchr/testify/require"
+)
+
+// TestRenderChatTemplateStream tests that streamed renders add up to the
+// render of RenderChatTemplate, in chunks, natively and with Python.
+func TestRenderChatTemplateStream(t *testing.T) {
+	// A long RAG-like prompt, with multi-byte characters to split.
+	conversation := make([]ChatMessage, 0, 64)
+	for i := 0; i < 64; i++ {
+		conversation = append(conversation, ChatMessage{Role: "user", Content: strings.Repeat("Größe ☃ ", 200)})
+	}
+	request := &RenderJinjaTemplateRequest{
+		Conversations: conversation,
+		ChatTemplate:  `{% for message in messages %}<|{{ message.role }}|>{{ message.content }}</s>{% endfor %}`,
+	}
+
+	for name, config := range map[string]*Config{
+		"Native": {InterpreterPoolSize: 1, NativeTemplates: true},
+		"Python": {InterpreterPoolSize: 1},
+	} {
+		t.Run(name, func(t *testing.T) {
+			processor := NewChatTemplatingProcessor(config)
+			require.NoError(t, processor.Initialize())
+
+			expected, err := processor.RenderChatTemplate(context.Background(), request)
+			require.NoError(t, err)
+
+			var chunks []string
+			err = processor.RenderChatTemplateStream(context.Background(), request, func(chunk string) error {
+				chunks = append(chunks, chunk)
+				return nil
+			})
+			require.NoError(t, err)
+			assert.Equal(t, expected.RenderedChats[0], strings.Join(chunks, ""), "Chunks should add up to the render")
+			assert.Greater(t, len(chunks), 1, "Render should be streamed in chunks")
+			for i, chunk := range chunks {
+				assert.True(t, utf8.ValidString(chunk), "Chunk %d should be valid UTF-8", i)
+			}
+
+			errStop := errors.New("stop")
+			calls := 0
+			err = processor.RenderChatTemplateStream(context.Background(), request, func(string) error {
+				calls++
+				return errStop
+			})
+			assert.ErrorIs(t, err, errStop)
+			assert.Equal(t, 1, calls, "Streaming should stop at the first error")
+		})
+	}
+}
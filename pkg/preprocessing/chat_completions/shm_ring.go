@@ -0,0 +1,194 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package preprocessing
+
+import (
+	"encoding/binary"
+	"fmt"
+	"sync/atomic"
+	"unsafe"
+)
+
+// Shared-memory ring layout, mirrored by render_jinja_template_worker.py.
+//
+// A ring is a header followed by `capacity` data bytes. The header holds the
+// consumer position (head) and the producer position (tail) on separate cache
+// lines. Both are native-endian 64-bit byte counters that only grow and are
+// updated atomically; a position maps to the data offset
+// `position % capacity`. The Python side has no atomics: it relies on x86's
+// total store order to publish positions after the frames they cover, so the
+// rings are only used on amd64.
+//
+// Each frame is a 16-byte little-endian header (payload length uint32, kind
+// uint32, id uint64) followed by the payload, padded to 16 bytes. A frame never wraps
+// around the end of the data area: when it does not fit in the remaining
+// contiguous bytes, the producer writes a frameWrap header there and continues
+// at offset 0. Since capacity and frames are 16-byte aligned, a wrap header
+// always fits. Frames are limited to half the capacity, so that a frame that
+// wraps still fits once the ring is drained.
+const (
+	ringHeadOffset  = 0
+	ringTailOffset  = 64
+	ringHeaderSize  = 128
+	frameHeaderSize = 16
+	frameAlignment  = 16
+	minRingCapacity = 4 * 1024
+)
+
+// Frame kinds, mirrored by render_jinja_template_worker.py.
+const (
+	frameRender uint32 = 1
+	frameFetch  uint32 = 2
+	frameOK     uint32 = 3
+	frameError  uint32 = 4
+	frameReady  uint32 = 5
+	// frameNotCached answers a render request referring to a chat template
+	// the worker does not hold.
+	frameNotCached uint32 = 6
+	frameWrap      uint32 = 0xFFFFFFFF
+)
+
+// shmFrame is a frame read from a ring. Its payload is a copy owned by the
+// caller.
+type shmFrame struct {
+	kind    uint32
+	id      uint64
+	payload []byte
+}
+
+// shmRing is a single-producer single-consumer frame queue over shared
+// memory. Each side of a ring must be used by a single goroutine at a time.
+type shmRing struct {
+	mem      []byte // header followed by the data area
+	capacity uint64
+}
+
+// ringRegionSize returns the number of bytes a ring of the given capacity
+// occupies in shared memory.
+func ringRegionSize(capacity int) int {
+	return ringHeaderSize + capacity
+}
+
+// newShmRing maps a ring over mem, which must be 8-byte aligned and hold
+// ringRegionSize(capacity) bytes. The memory must be zeroed on first use.
+func newShmRing(mem []byte, capacity int) (*shmRing, error) {
+	if capacity < minRingCapacity || capacity%frameAlignment != 0 {
+		return nil, fmt.Errorf("ring capacity must be a multiple of %d of at least %d bytes, got %d",
+			frameAlignment, minRingCapacity, capacity)
+	}
+	if len(mem) < ringRegionSize(capacity) {
+		return nil, fmt.Errorf("ring memory of %d bytes is smaller than %d", len(mem), ringRegionSize(capacity))
+	}
+
+	return &shmRing{
+		mem:      mem[:ringRegionSize(capacity)],
+		capacity: uint64(capacity),
+	}, nil
+}
+
+func (r *shmRing) position(offset int) *uint64 {
+	return (*uint64)(unsafe.Pointer(&r.mem[offset]))
+}
+
+// frameSize returns the ring bytes taken by a frame with the given payload.
+func frameSize(payloadLen int) uint64 {
+	return uint64(frameHeaderSize+payloadLen+frameAlignment-1) &^ (frameAlignment - 1)
+}
+
+// maxPayload returns the largest payload a single frame can carry.
+func (r *shmRing) maxPayload() int {
+	return int(r.capacity)/2 - frameHeaderSize
+}
+
+// write appends a frame to the ring. It returns false, without writing, when
+// the ring does not have room for the frame yet.
+func (r *shmRing) write(kind uint32, id uint64, payload []byte) (bool, error) {
+	if len(payload) > r.maxPayload() {
+		return false, fmt.Errorf("payload of %d bytes exceeds the ring frame limit of %d bytes",
+			len(payload), r.maxPayload())
+	}
+
+	size := frameSize(len(payload))
+	head := atomic.LoadUint64(r.position(ringHeadOffset))
+	tail := atomic.LoadUint64(r.position(ringTailOffset))
+
+	offset := tail % r.capacity
+	contiguous := r.capacity - offset
+	needed := size
+	if contiguous < size {
+		needed += contiguous
+	}
+	if tail+needed-head > r.capacity {
+		return false, nil
+	}
+
+	data := r.mem[ringHeaderSize:]
+	if contiguous < size {
+		putFrameHeader(data[offset:], 0, frameWrap, 0)
+		tail += contiguous
+		offset = 0
+	}
+
+	putFrameHeader(data[offset:], uint32(len(payload)), kind, id)
+	copy(data[offset+frameHeaderSize:], payload)
+	// Publish the frame only after its bytes are in place.
+	atomic.StoreUint64(r.position(ringTailOffset), tail+size)
+	return true, nil
+}
+
+// read pops the next frame off the ring, if any. It fails, without
+// consuming the frame, when the frame header is corrupt.
+func (r *shmRing) read() (shmFrame, bool, error) {
+	head := atomic.LoadUint64(r.position(ringHeadOffset))
+	tail := atomic.LoadUint64(r.position(ringTailOffset))
+	data := r.mem[ringHeaderSize:]
+
+	for head != tail {
+		offset := head % r.capacity
+		length := binary.LittleEndian.Uint32(data[offset:])
+		kind := binary.LittleEndian.Uint32(data[offset+4:])
+		if kind == frameWrap {
+			head += r.capacity - offset
+			continue
+		}
+
+		if uint64(length) > uint64(r.maxPayload()) || offset+frameSize(int(length)) > r.capacity {
+			atomic.StoreUint64(r.position(ringHeadOffset), head)
+			return shmFrame{}, false, fmt.Errorf("corrupt ring frame at offset %d: payload length %d exceeds the frame limit",
+				offset, length)
+		}
+
+		start := offset + frameHeaderSize
+		frame := shmFrame{
+			kind:    kind,
+			id:      binary.LittleEndian.Uint64(data[offset+8:]),
+			payload: append([]byte(nil), data[start:start+uint64(length)]...),
+		}
+		// Hand the frame's bytes back to the producer only after copying them.
+		atomic.StoreUint64(r.position(ringHeadOffset), head+frameSize(int(length)))
+		return frame, true, nil
+	}
+
+	atomic.StoreUint64(r.position(ringHeadOffset), head)
+	return shmFrame{}, false, nil
+}
+
+func putFrameHeader(b []byte, length, kind uint32, id uint64) {
+	binary.LittleEndian.PutUint32(b, length)
+	binary.LittleEndian.PutUint32(b[4:], kind)
+	binary.LittleEndian.PutUint64(b[8:], id)
+}
@@ -0,0 +1,123 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package preprocessing //nolint:testpackage // tests the unexported ring
+
+import (
+	"bytes"
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+	"github.com/stretchr/testify/require"
+)
+
+func newTestRing(t *testing.T) *shmRing {
+	t.Helper()
+	ring, err := newShmRing(make([]byte, ringRegionSize(minRingCapacity)), minRingCapacity)
+	require.NoError(t, err)
+	return ring
+}
+
+// TestShmRingRoundTrip tests that frames come out in order and intact,
+// including frames that wrap around the end of the data area.
+func TestShmRingRoundTrip(t *testing.T) {
+	ring := newTestRing(t)
+
+	var queued [][]byte
+	nextID := uint64(0)
+	for i := 0; i < 2000; i++ {
+		payload := bytes.Repeat([]byte{byte(i)}, (i*397)%ring.maxPayload())
+		written, err := ring.write(frameRender, nextID, payload)
+		require.NoError(t, err)
+		if written {
+			queued = append(queued, payload)
+			nextID++
+		}
+
+		// Drain every other iteration so the ring regularly fills up.
+		if i%2 == 1 {
+			for len(queued) > 0 {
+				frame, ok, err := ring.read()
+				require.NoError(t, err)
+				require.True(t, ok, "Queued frame should be readable")
+				assert.Equal(t, frameRender, frame.kind)
+				assert.Equal(t, nextID-uint64(len(queued)), frame.id)
+				assert.Equal(t, queued[0], frame.payload)
+				queued = queued[1:]
+			}
+		}
+	}
+
+	_, ok, err := ring.read()
+	require.NoError(t, err)
+	assert.False(t, ok, "Drained ring should be empty")
+}
+
+// TestShmRingFull tests that writes are refused while the ring is full and
+// accepted again once the consumer frees space.
+func TestShmRingFull(t *testing.T) {
+	ring := newTestRing(t)
+	payload := make([]byte, ring.maxPayload())
+
+	written, err := ring.write(frameRender, 1, payload)
+	require.NoError(t, err)
+	require.True(t, written)
+
+	written, err = ring.write(frameRender, 2, payload)
+	require.NoError(t, err)
+	require.True(t, written)
+
+	written, err = ring.write(frameRender, 3, payload)
+	require.NoError(t, err)
+	assert.False(t, written, "Write should be refused while the ring is full")
+
+	_, ok, err := ring.read()
+	require.NoError(t, err)
+	require.True(t, ok)
+	written, err = ring.write(frameRender, 3, payload)
+	require.NoError(t, err)
+	assert.True(t, written, "Write should succeed once space is freed")
+
+	_, err = ring.write(frameRender, 4, make([]byte, ring.maxPayload()+1))
+	assert.Error(t, err, "Oversized payload should be rejected")
+}
+
+// TestShmRingCorruptFrame tests that a frame whose header claims more bytes
+// than a frame can hold is rejected instead of read past the data area.
+func TestShmRingCorruptFrame(t *testing.T) {
+	testCases := []struct {
+		name   string
+		offset uint64
+		length uint32
+	}{
+		{name: "length above the frame limit", offset: 0, length: 0xFFFFFFFF},
+		{name: "frame past the end of the data area", offset: minRingCapacity - 2*frameHeaderSize, length: 64},
+	}
+
+	for _, tc := range testCases {
+		t.Run(tc.name, func(t *testing.T) {
+			ring := newTestRing(t)
+			data := ring.mem[ringHeaderSize:]
+			putFrameHeader(data[tc.offset:], tc.length, frameOK, 1)
+			*ring.position(ringHeadOffset) = tc.offset
+			*ring.position(ringTailOffset) = tc.offset + frameHeaderSize
+
+			_, ok, err := ring.read()
+			assert.Error(t, err, "Corrupt frame should be rejected")
+			assert.False(t, ok)
+		})
+	}
+}
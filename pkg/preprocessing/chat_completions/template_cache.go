@@ -0,0 +1,132 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package preprocessing
+
+import (
+	"crypto/sha256"
+	"encoding/hex"
+	"encoding/json"
+	"errors"
+	"fmt"
+
+	lru "github.com/hashicorp/golang-lru/v2"
+)
+
+// templateHashesCacheSize is the number of chat templates whose hash is
+// remembered, matching the size of the Python side's template cache.
+const templateHashesCacheSize = 128
+
+// payloadHashesCacheSize is the number of tools and documents payloads whose
+// hash is remembered, matching the size of the Python side's interned store.
+const payloadHashesCacheSize = 64
+
+// errTemplateNotCached is returned by a Python interpreter or worker process
+// that does not hold the chat template, tools or documents of a hash-only
+// render request.
+var errTemplateNotCached = errors.New("chat template or payload not cached")
+
+// renderRequest is a render request as sent to Python. The chat template is
+// only sent the first time; afterwards the Python renderer looks it up by
+// ChatTemplateHash in its compiled-template cache, and answers with
+// errTemplateNotCached if it does not have it. Tools and documents with a
+// hash are interned by Python the same way.
+type renderRequest struct {
+	*RenderJinjaTemplateRequest
+	// ChatTemplate, Tools and Documents shadow the embedded fields so that
+	// they can be left out.
+	ChatTemplate     string        `json:"chat_template,omitempty"`
+	ChatTemplateHash string        `json:"chat_template_hash,omitempty"`
+	Tools            []interface{} `json:"tools,omitempty"`
+	ToolsHash        string        `json:"tools_hash,omitempty"`
+	Documents        []interface{} `json:"documents,omitempty"`
+	DocumentsHash    string        `json:"documents_hash,omitempty"`
+	// Tokenize selects the tokenizer of render and tokenize requests.
+	Tokenize *TokenizeOptions `json:"tokenize,omitempty"`
+}
+
+// templateHashes remembers the hashes of the chat templates sent to Python.
+type templateHashes struct {
+	cache *lru.Cache[string, string]
+}
+
+func newTemplateHashes() (*templateHashes, error) {
+	cache, err := lru.New[string, string](templateHashesCacheSize)
+	if err != nil {
+		return nil, fmt.Errorf("failed to create template hashes cache: %w", err)
+	}
+	return &templateHashes{cache: cache}, nil
+}
+
+// get returns the hash of a chat template, and whether the template was seen
+// before. Interpreters that did not render it yet get it on their first
+// errTemplateNotCached.
+func (t *templateHashes) get(template string) (string, bool) {
+	if hash, ok := t.cache.Get(template); ok {
+		return hash, true
+	}
+
+	sum := sha256.Sum256([]byte(template))
+	hash := hex.EncodeToString(sum[:])
+	t.cache.Add(template, hash)
+	return hash, false
+}
+
+// restorePayloads puts back the chat template, tools and documents left out of
+// a request, to resend it to a Python renderer that does not hold them.
+func (r *renderRequest) restorePayloads() {
+	r.ChatTemplate = r.RenderJinjaTemplateRequest.ChatTemplate
+	r.Tools = r.RenderJinjaTemplateRequest.Tools
+	r.Documents = r.RenderJinjaTemplateRequest.Documents
+}
+
+// HashPayload returns a content hash of tools or documents, to set as the
+// ToolsHash or DocumentsHash of the requests sending them. Callers sending the
+// same payload repeatedly should hash it once and reuse the hash.
+func HashPayload(payload []interface{}) (string, error) {
+	data, err := json.Marshal(payload)
+	if err != nil {
+		return "", fmt.Errorf("failed to marshal payload: %w", err)
+	}
+	sum := sha256.Sum256(data)
+	return hex.EncodeToString(sum[:]), nil
+}
+
+// payloadHashes remembers the hashes of the tools and documents sent to Python.
+type payloadHashes struct {
+	cache *lru.Cache[string, struct{}]
+}
+
+func newPayloadHashes() (*payloadHashes, error) {
+	cache, err := lru.New[string, struct{}](payloadHashesCacheSize)
+	if err != nil {
+		return nil, fmt.Errorf("failed to create payload hashes cache: %w", err)
+	}
+	return &payloadHashes{cache: cache}, nil
+}
+
+// intern returns the payload and hash to send for a hashed payload: the hash
+// alone once the payload was sent. Interpreters that did not intern it yet get
+// it on their first errTemplateNotCached.
+func (p *payloadHashes) intern(payload []interface{}, hash string) ([]interface{}, string) {
+	if hash == "" || len(payload) == 0 {
+		return payload, ""
+	}
+	if sent, _ := p.cache.ContainsOrAdd(hash, struct{}{}); sent {
+		return nil, hash
+	}
+	return payload, hash
+}
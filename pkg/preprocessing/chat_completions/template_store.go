@@ -0,0 +1,191 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package preprocessing
+
+import (
+	"context"
+	"crypto/sha256"
+	"encoding/hex"
+	"encoding/json"
+	"fmt"
+	"maps"
+	"os"
+	"path/filepath"
+	"strings"
+	"sync"
+
+	"k8s.io/klog/v2"
+
+	"github.com/llm-d/llm-d-kv-cache-manager/pkg/utils/logging"
+)
+
+// defaultTemplateRevision is the revision fetched when none is requested.
+const defaultTemplateRevision = "main"
+
+// templateStoreKey identifies the chat template of a model revision.
+type templateStoreKey struct {
+	model    string
+	revision string
+}
+
+func newTemplateStoreKey(model, revision string) templateStoreKey {
+	if revision == "" {
+		revision = defaultTemplateRevision
+	}
+	return templateStoreKey{model: model, revision: revision}
+}
+
+// fileName returns the name of the file persisting the key's template.
+func (k templateStoreKey) fileName() string {
+	sum := sha256.Sum256([]byte(k.model + "\x00" + k.revision))
+	return hex.EncodeToString(sum[:]) + ".json"
+}
+
+// storedTemplate is a templateStore entry as persisted to disk.
+type storedTemplate struct {
+	Model    string `json:"model"`
+	Revision string `json:"revision"`
+	FetchChatTemplateResponse
+}
+
+// templateStore caches the chat templates fetched per model revision, so that
+// they are fetched from Python once. With a directory, each template is also
+// persisted to a file in it, and the files are loaded when the store is
+// created, so that a restarted process serves them without Python.
+//
+// Entries are never invalidated: a revision that moves, like a branch, keeps
+// the template it had when first fetched until its file is removed.
+type templateStore struct {
+	dir string
+
+	mu        sync.RWMutex
+	templates map[templateStoreKey]*FetchChatTemplateResponse
+}
+
+// newTemplateStore creates a template store persisted to dir, or kept in
+// memory only if dir is empty, loading the templates already in dir.
+func newTemplateStore(dir string) (*templateStore, error) {
+	store := &templateStore{
+		dir:       dir,
+		templates: make(map[templateStoreKey]*FetchChatTemplateResponse),
+	}
+	if dir == "" {
+		return store, nil
+	}
+
+	if err := os.MkdirAll(dir, 0o755); err != nil {
+		return nil, fmt.Errorf("failed to create template cache directory: %w", err)
+	}
+	entries, err := os.ReadDir(dir)
+	if err != nil {
+		return nil, fmt.Errorf("failed to read template cache directory: %w", err)
+	}
+
+	logger := klog.Background().WithName("templateStore")
+	for _, entry := range entries {
+		if entry.IsDir() || !strings.HasSuffix(entry.Name(), ".json") {
+			continue
+		}
+		path := filepath.Join(dir, entry.Name())
+		data, err := os.ReadFile(path)
+		if err != nil {
+			logger.Error(err, "Failed to read cached chat template", "path", path)
+			continue
+		}
+		var stored storedTemplate
+		if err := json.Unmarshal(data, &stored); err != nil || stored.Model == "" {
+			logger.Error(err, "Skipping invalid cached chat template", "path", path)
+			continue
+		}
+		key := newTemplateStoreKey(stored.Model, stored.Revision)
+		store.templates[key] = &stored.FetchChatTemplateResponse
+	}
+	logger.V(logging.DEBUG).Info("Loaded cached chat templates", "dir", dir, "count", len(store.templates))
+	return store, nil
+}
+
+// get returns the cached chat template of a fetch request's model revision.
+// A template given by the request replaces the cached one, as it does in
+// get_model_chat_template.
+func (s *templateStore) get(req *FetchChatTemplateRequest) (string, map[string]interface{}, bool) {
+	s.mu.RLock()
+	response, ok := s.templates[newTemplateStoreKey(req.Model, req.Revision)]
+	s.mu.RUnlock()
+	if !ok {
+		return "", nil, false
+	}
+
+	template := response.ChatTemplate
+	if req.ChatTemplate != "" {
+		template = req.ChatTemplate
+	}
+	return template, maps.Clone(response.ChatTemplateKWArgs), true
+}
+
+// put caches the chat template fetched for a request, persisting it if the
+// store has a directory. Persistence failures are logged: the template stays
+// cached in memory.
+func (s *templateStore) put(ctx context.Context, req *FetchChatTemplateRequest,
+	response *FetchChatTemplateResponse,
+) {
+	if req.ChatTemplate != "" {
+		// The response holds the requested template, not the model's.
+		return
+	}
+	key := newTemplateStoreKey(req.Model, req.Revision)
+	s.mu.Lock()
+	s.templates[key] = response
+	s.mu.Unlock()
+
+	if s.dir == "" {
+		return
+	}
+	if err := s.persist(key, response); err != nil {
+		klog.FromContext(ctx).Error(err, "Failed to persist chat template", "model", key.model, "revision", key.revision)
+	}
+}
+
+// persist writes a template to its file, atomically replacing it.
+func (s *templateStore) persist(key templateStoreKey, response *FetchChatTemplateResponse) error {
+	data, err := json.Marshal(&storedTemplate{
+		Model:                     key.model,
+		Revision:                  key.revision,
+		FetchChatTemplateResponse: *response,
+	})
+	if err != nil {
+		return fmt.Errorf("failed to marshal chat template: %w", err)
+	}
+
+	file, err := os.CreateTemp(s.dir, ".template-*")
+	if err != nil {
+		return fmt.Errorf("failed to create chat template file: %w", err)
+	}
+	// Fails once the file is renamed.
+	defer func() { _ = os.Remove(file.Name()) }()
+
+	if _, err := file.Write(data); err != nil {
+		_ = file.Close()
+		return fmt.Errorf("failed to write chat template file: %w", err)
+	}
+	if err := file.Close(); err != nil {
+		return fmt.Errorf("failed to write chat template file: %w", err)
+	}
+	if err := os.Rename(file.Name(), filepath.Join(s.dir, key.fileName())); err != nil {
+		return fmt.Errorf("failed to rename chat template file: %w", err)
+	}
+	return nil
+}
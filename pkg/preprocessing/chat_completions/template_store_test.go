@@ -0,0 +1,61 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package preprocessing //nolint:testpackage // tests the unexported template store
+
+import (
+	"context"
+	"os"
+	"path/filepath"
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+	"github.com/stretchr/testify/require"
+)
+
+// TestTemplateStorePersistence tests that a template store loads the
+// templates persisted by a previous one.
+func TestTemplateStorePersistence(t *testing.T) {
+	dir := filepath.Join(t.TempDir(), "templates")
+	store, err := newTemplateStore(dir)
+	require.NoError(t, err)
+
+	req := &FetchChatTemplateRequest{Model: "org/model"}
+	store.put(context.Background(), req, &FetchChatTemplateResponse{
+		ChatTemplate:       "{{ messages }}",
+		ChatTemplateKWArgs: map[string]interface{}{"bos_token": "<s>"},
+	})
+	// Only the model's own template is cached.
+	store.put(context.Background(), &FetchChatTemplateRequest{Model: "org/other", ChatTemplate: "custom"},
+		&FetchChatTemplateResponse{ChatTemplate: "custom"})
+	require.NoError(t, os.WriteFile(filepath.Join(dir, "corrupt.json"), []byte("{"), 0o600))
+
+	restarted, err := newTemplateStore(dir)
+	require.NoError(t, err)
+	template, kwargs, ok := restarted.get(&FetchChatTemplateRequest{Model: "org/model", Revision: "main"})
+	require.True(t, ok, "Persisted template should be loaded")
+	assert.Equal(t, "{{ messages }}", template)
+	assert.Equal(t, map[string]interface{}{"bos_token": "<s>"}, kwargs)
+
+	template, _, ok = restarted.get(&FetchChatTemplateRequest{Model: "org/model", ChatTemplate: "override"})
+	require.True(t, ok)
+	assert.Equal(t, "override", template, "Requested template should replace the cached one")
+
+	_, _, ok = restarted.get(&FetchChatTemplateRequest{Model: "org/model", Revision: "v2"})
+	assert.False(t, ok, "Templates should be cached per revision")
+	_, _, ok = restarted.get(&FetchChatTemplateRequest{Model: "org/other"})
+	assert.False(t, ok, "Requested templates should not be cached")
+}
@@ -0,0 +1,76 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package preprocessing
+
+import (
+	"context"
+	"fmt"
+	"time"
+
+	"k8s.io/klog/v2"
+)
+
+// warmUpTemplate is the chat template rendered by every interpreter or worker
+// process when warming up, importing transformers and creating its Jinja
+// environment.
+const warmUpTemplate = `{% for message in messages %}{{ message.role }}: {{ message.content }}{% endfor %}`
+
+// warmUp renders a dummy chat on every Python interpreter or worker process,
+// with warmUpTemplate and with the chat template of each of the WarmUpModels,
+// so that transformers is imported and the templates are compiled before the
+// first requests. The templates are also compiled natively if enabled.
+//
+// It fails if a model's template cannot be fetched or if warmUpTemplate does
+// not render. A model's template may reject the dummy chat: it is compiled all
+// the same, so that failure is only logged.
+func (w *ChatTemplatingProcessor) warmUp(ctx context.Context) error {
+	logger := klog.FromContext(ctx).WithName("warmUp")
+	start := time.Now()
+
+	reqs := []*RenderJinjaTemplateRequest{{ChatTemplate: warmUpTemplate}}
+	for i := range w.config.WarmUpModels {
+		model := w.config.WarmUpModels[i]
+		template, kwargs, err := w.FetchChatTemplate(ctx, model)
+		if err != nil {
+			return fmt.Errorf("failed to fetch chat template of %s for warm-up: %w", model.Model, err)
+		}
+		reqs = append(reqs, &RenderJinjaTemplateRequest{ChatTemplate: template, ChatTemplateKWArgs: kwargs})
+	}
+
+	for i, req := range reqs {
+		req.Conversations = []ChatMessage{{Role: "user", Content: "Hello"}}
+		req.AddGenerationPrompt = true
+		if w.native != nil {
+			// Templates the native engine does not support fall back to Python.
+			_, _ = w.native.compile(req.ChatTemplate)
+		}
+		for interp := range w.queueDepths {
+			_, err := w.renderOnInterpreter(ctx, interp, req)
+			switch {
+			case err == nil:
+			case i == 0:
+				return fmt.Errorf("failed to warm up interpreter %d: %w", interp, err)
+			default:
+				logger.Info("Model chat template rejected the warm-up chat", "model", w.config.WarmUpModels[i-1].Model,
+					"interpreter", interp, "reason", err)
+			}
+		}
+	}
+
+	logger.Info("Warmed up", "duration", time.Since(start), "templates", len(reqs), "interpreters", len(w.queueDepths))
+	return nil
+}
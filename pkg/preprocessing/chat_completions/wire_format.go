@@ -0,0 +1,450 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package preprocessing
+
+import (
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"math"
+	"sort"
+	"unicode/utf8"
+)
+
+// WireFormat selects how render requests are passed to the embedded Python
+// interpreters.
+type WireFormat string
+
+const (
+	// BinaryWireFormat encodes render requests in a compact tagged binary
+	// format, which the C bridge decodes straight into Python objects.
+	// Requests holding values the format cannot represent the way JSON
+	// does fall back to JSON.
+	BinaryWireFormat WireFormat = "binary"
+	// JSONWireFormat encodes render requests as JSON, parsed by json.loads.
+	JSONWireFormat WireFormat = "json"
+)
+
+// Binary wire format, mirrored by cgo_functions.c.
+//
+// A request is wireMagic followed by one value. A value is a tag byte
+// followed by its payload, in native byte order: nothing for None, False and
+// True, an int64 or a float64, a uint32 byte length and UTF-8 bytes for str,
+// a uint32 item count and the items for list, and a uint32 entry count and
+// the entries for dict, each a str value and a value.
+// Nesting is limited to wireMaxDepth.
+//
+// JSON requests start with '{' or '[', never with wireMagic.
+const (
+	wireMagic    byte = 0xB1
+	wireMaxDepth      = 64
+
+	wireNone  byte = 0
+	wireFalse byte = 1
+	wireTrue  byte = 2
+	wireInt   byte = 3
+	wireFloat byte = 4
+	wireStr   byte = 5
+	wireList  byte = 6
+	wireDict  byte = 7
+)
+
+// errWireUnsupported is returned for values the binary wire format does not
+// represent like encoding/json does, which are sent as JSON instead.
+var errWireUnsupported = errors.New("value not supported by the binary wire format")
+
+// wireEncoder appends values to a binary wire format request. Values decode
+// to the same Python objects as their JSON encoding does with json.loads:
+// maps are written with sorted keys, and integral floats as ints.
+type wireEncoder struct {
+	buf []byte
+}
+
+// encodeWireRequest encodes a render request in the binary wire format.
+func encodeWireRequest(req *renderRequest) ([]byte, error) {
+	enc := &wireEncoder{buf: make([]byte, 0, wireRequestSize(req)+1)}
+	enc.buf = append(enc.buf, wireMagic)
+	if err := enc.request(req); err != nil {
+		return nil, err
+	}
+	return enc.buf, nil
+}
+
+// encodeWireBatch encodes render requests as a list in the binary wire
+// format.
+func encodeWireBatch(reqs []*renderRequest) ([]byte, error) {
+	size := 1 + 5 // magic and list header
+	for _, req := range reqs {
+		size += wireRequestSize(req)
+	}
+
+	enc := &wireEncoder{buf: make([]byte, 0, size)}
+	enc.buf = append(enc.buf, wireMagic)
+	enc.header(wireList, len(reqs))
+	for _, req := range reqs {
+		if err := enc.request(req); err != nil {
+			return nil, err
+		}
+	}
+	return enc.buf, nil
+}
+
+// wireRequestSize estimates the encoded size of a request, for preallocation.
+func wireRequestSize(req *renderRequest) int {
+	size := 256 + len(req.ChatTemplate)
+	for i := range req.Conversations {
+		size += 64 + len(req.Conversations[i].Role) + len(req.Conversations[i].Content)
+	}
+	return size
+}
+
+// request writes a render request as a dict with the keys and values of its
+// JSON encoding.
+func (e *wireEncoder) request(req *renderRequest) error {
+	entries := 1 // messages is never omitted
+	for _, present := range []bool{
+		len(req.Tools) > 0, len(req.Documents) > 0, req.ReturnAssistantTokensMask, req.ContinueFinalMessage,
+		req.AddGenerationPrompt, len(req.ChatTemplateKWArgs) > 0, req.ChatTemplate != "", req.ChatTemplateHash != "",
+		req.ToolsHash != "", req.DocumentsHash != "", req.Tokenize != nil,
+	} {
+		if present {
+			entries++
+		}
+	}
+	e.header(wireDict, entries)
+
+	e.key("messages")
+	if err := e.messages(req.Conversations); err != nil {
+		return err
+	}
+	if len(req.Tools) > 0 {
+		e.key("tools")
+		if err := e.value(req.Tools, 1); err != nil {
+			return err
+		}
+	}
+	if len(req.Documents) > 0 {
+		e.key("documents")
+		if err := e.value(req.Documents, 1); err != nil {
+			return err
+		}
+	}
+	for _, flag := range []struct {
+		key string
+		set bool
+	}{
+		{"return_assistant_tokens_mask", req.ReturnAssistantTokensMask},
+		{"continue_final_message", req.ContinueFinalMessage},
+		{"add_generation_prompt", req.AddGenerationPrompt},
+	} {
+		if flag.set {
+			e.key(flag.key)
+			e.buf = append(e.buf, wireTrue)
+		}
+	}
+	if len(req.ChatTemplateKWArgs) > 0 {
+		e.key("chat_template_kwargs")
+		if err := e.value(req.ChatTemplateKWArgs, 1); err != nil {
+			return err
+		}
+	}
+	for _, field := range []struct {
+		key   string
+		value string
+	}{
+		{"chat_template", req.ChatTemplate},
+		{"chat_template_hash", req.ChatTemplateHash},
+		{"tools_hash", req.ToolsHash},
+		{"documents_hash", req.DocumentsHash},
+	} {
+		if field.value != "" {
+			e.key(field.key)
+			if err := e.str(field.value); err != nil {
+				return err
+			}
+		}
+	}
+	if req.Tokenize != nil {
+		e.key("tokenize")
+		return e.tokenizeOptions(req.Tokenize)
+	}
+	return nil
+}
+
+// tokenizeOptions writes tokenize options as a dict with the keys and values
+// of their JSON encoding.
+func (e *wireEncoder) tokenizeOptions(opts *TokenizeOptions) error {
+	fields := []struct {
+		key   string
+		value string
+	}{
+		{"model", opts.Model},
+		{"revision", opts.Revision},
+		{"token", opts.Token},
+	}
+	entries := 1 // model is never omitted
+	for _, present := range []bool{opts.Revision != "", opts.Token != "", opts.AddSpecialTokens} {
+		if present {
+			entries++
+		}
+	}
+	e.header(wireDict, entries)
+
+	for i, field := range fields {
+		if i == 0 || field.value != "" {
+			e.key(field.key)
+			if err := e.str(field.value); err != nil {
+				return err
+			}
+		}
+	}
+	if opts.AddSpecialTokens {
+		e.key("add_special_tokens")
+		e.buf = append(e.buf, wireTrue)
+	}
+	return nil
+}
+
+func (e *wireEncoder) messages(messages []ChatMessage) error {
+	if messages == nil {
+		e.buf = append(e.buf, wireNone)
+		return nil
+	}
+
+	e.header(wireList, len(messages))
+	for i := range messages {
+		e.header(wireDict, 2)
+		e.key("role")
+		if err := e.str(messages[i].Role); err != nil {
+			return err
+		}
+		e.key("content")
+		if err := e.str(messages[i].Content); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// value writes the values encoding/json encodes from the types produced by
+// decoding JSON into interface{}, and their common Go equivalents.
+func (e *wireEncoder) value(value interface{}, depth int) error {
+	if depth >= wireMaxDepth {
+		return fmt.Errorf("%w: nesting %d levels deep", errWireUnsupported, wireMaxDepth)
+	}
+
+	switch value := value.(type) {
+	case nil:
+		e.buf = append(e.buf, wireNone)
+	case bool:
+		if value {
+			e.buf = append(e.buf, wireTrue)
+		} else {
+			e.buf = append(e.buf, wireFalse)
+		}
+	case int:
+		e.integer(int64(value))
+	case int32:
+		e.integer(int64(value))
+	case int64:
+		e.integer(value)
+	case uint32:
+		e.integer(int64(value))
+	case float64:
+		return e.float(value)
+	case string:
+		return e.str(value)
+	case []interface{}:
+		e.header(wireList, len(value))
+		for _, item := range value {
+			if err := e.value(item, depth+1); err != nil {
+				return err
+			}
+		}
+	case []string:
+		e.header(wireList, len(value))
+		for _, item := range value {
+			if err := e.str(item); err != nil {
+				return err
+			}
+		}
+	case map[string]interface{}:
+		keys := make([]string, 0, len(value))
+		for key := range value {
+			keys = append(keys, key)
+		}
+		// encoding/json sorts map keys, and Python dicts keep their order.
+		sort.Strings(keys)
+
+		e.header(wireDict, len(keys))
+		for _, key := range keys {
+			if err := e.str(key); err != nil {
+				return err
+			}
+			if err := e.value(value[key], depth+1); err != nil {
+				return err
+			}
+		}
+	default:
+		return fmt.Errorf("%w: %T", errWireUnsupported, value)
+	}
+	return nil
+}
+
+func (e *wireEncoder) header(tag byte, count int) {
+	e.buf = append(e.buf, tag)
+	e.buf = binary.NativeEndian.AppendUint32(e.buf, uint32(count)) //nolint:gosec // counts are bounded by memory
+}
+
+func (e *wireEncoder) integer(value int64) {
+	e.buf = append(e.buf, wireInt)
+	e.buf = binary.NativeEndian.AppendUint64(e.buf, uint64(value)) //nolint:gosec // reinterpreted by the decoder
+}
+
+// float writes a float64 the way json.loads parses its encoding/json form:
+// integral values below 1e21 have no fraction or exponent, and are ints.
+func (e *wireEncoder) float(value float64) error {
+	switch {
+	case math.IsNaN(value) || math.IsInf(value, 0):
+		return fmt.Errorf("%w: %v", errWireUnsupported, value)
+	case value == math.Trunc(value) && math.Abs(value) < 1e21:
+		if value < math.MinInt64 || value >= math.MaxInt64 {
+			return fmt.Errorf("%w: %v overflows int64", errWireUnsupported, value)
+		}
+		e.integer(int64(value))
+	default:
+		e.buf = append(e.buf, wireFloat)
+		e.buf = binary.NativeEndian.AppendUint64(e.buf, math.Float64bits(value))
+	}
+	return nil
+}
+
+// key writes a constant dict key.
+func (e *wireEncoder) key(key string) {
+	e.buf = append(e.buf, wireStr)
+	e.buf = binary.NativeEndian.AppendUint32(e.buf, uint32(len(key))) //nolint:gosec // short constant keys
+	e.buf = append(e.buf, key...)
+}
+
+// str writes a str value.
+func (e *wireEncoder) str(value string) error {
+	// encoding/json replaces invalid UTF-8 byte by byte, unlike Python.
+	if !utf8.ValidString(value) {
+		return fmt.Errorf("%w: invalid UTF-8", errWireUnsupported)
+	}
+	if len(value) > math.MaxUint32 {
+		return fmt.Errorf("%w: string of %d bytes", errWireUnsupported, len(value))
+	}
+	e.buf = append(e.buf, wireStr)
+	e.buf = binary.NativeEndian.AppendUint32(e.buf, uint32(len(value)))
+	e.buf = append(e.buf, value...)
+	return nil
+}
+
+// Render results of the worker processes, mirrored by
+// render_jinja_template_worker.py: a little-endian uint32 chat count and
+// uint32 total span count, then per chat a uint32 byte length and uint32 span
+// count, the UTF-8 bytes of the chat and its int64 (start, end) pairs.
+const (
+	wireResultHeaderSize = 8
+	wireChatHeaderSize   = 8
+	wireSpanSize         = 16
+)
+
+// wireReader reads little-endian values, failing once it runs out of bytes.
+type wireReader struct {
+	buf []byte
+	err error
+}
+
+func (r *wireReader) next(size int) []byte {
+	if r.err != nil || len(r.buf) < size {
+		r.err = fmt.Errorf("truncated render result")
+		return nil
+	}
+	data := r.buf[:size]
+	r.buf = r.buf[size:]
+	return data
+}
+
+func (r *wireReader) uint32() int {
+	if data := r.next(4); data != nil {
+		return int(binary.LittleEndian.Uint32(data))
+	}
+	return 0
+}
+
+func (r *wireReader) int64() int {
+	if data := r.next(8); data != nil {
+		return int(int64(binary.LittleEndian.Uint64(data))) //nolint:gosec // reinterpreted as written
+	}
+	return 0
+}
+
+// decodeWireRenderResult decodes the render result of a worker process.
+func decodeWireRenderResult(payload []byte) (*RenderJinjaTemplateResponse, error) {
+	rdr := &wireReader{buf: payload}
+	numChats, totalSpans := rdr.uint32(), rdr.uint32()
+	// Bound the allocations by what the payload can hold.
+	if rdr.err != nil || numChats*wireChatHeaderSize+totalSpans*wireSpanSize > len(payload)-wireResultHeaderSize {
+		return nil, fmt.Errorf("malformed render result")
+	}
+
+	chats := make([]string, numChats)
+	spanCounts := make([]int, numChats)
+	flat := make([]int, 0, 2*totalSpans)
+	for i := range chats {
+		size, count := rdr.uint32(), rdr.uint32()
+		chats[i] = string(rdr.next(size))
+		if len(flat)/2+count > totalSpans {
+			return nil, fmt.Errorf("malformed render result: more than %d spans", totalSpans)
+		}
+		for j := 0; j < count; j++ {
+			flat = append(flat, rdr.int64(), rdr.int64())
+		}
+		spanCounts[i] = count
+	}
+	if rdr.err != nil {
+		return nil, fmt.Errorf("malformed render result: %w", rdr.err)
+	}
+	if len(rdr.buf) != 0 || len(flat) != 2*totalSpans {
+		return nil, fmt.Errorf("malformed render result: %d trailing bytes", len(rdr.buf))
+	}
+
+	return &RenderJinjaTemplateResponse{
+		RenderedChats:     chats,
+		GenerationIndices: generationIndices(spanCounts, flat),
+	}, nil
+}
+
+// generationIndices slices flat (start, end) pairs into the generation
+// indices of each chat. All pairs share flat, and all chats share one slice
+// of pairs.
+func generationIndices(spanCounts, flat []int) [][][]int {
+	pairs := make([][]int, len(flat)/2)
+	for j := range pairs {
+		pairs[j] = flat[2*j : 2*j+2 : 2*j+2]
+	}
+
+	indices := make([][][]int, len(spanCounts))
+	offset := 0
+	for i, count := range spanCounts {
+		indices[i] = pairs[offset : offset+count : offset+count]
+		offset += count
+	}
+	return indices
+}
@@ -0,0 +1,204 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package preprocessing //nolint:testpackage // tests the unexported wire format
+
+import (
+	"bytes"
+	"encoding/binary"
+	"encoding/json"
+	"math"
+	"strings"
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+	"github.com/stretchr/testify/require"
+)
+
+// decodeWireValue decodes a binary wire format value like the C bridge does,
+// with int64 for Python ints and float64 for Python floats.
+func decodeWireValue(t *testing.T, buf *bytes.Reader) interface{} {
+	t.Helper()
+	tag, err := buf.ReadByte()
+	require.NoError(t, err)
+
+	read := func(value interface{}) {
+		require.NoError(t, binary.Read(buf, binary.NativeEndian, value))
+	}
+	switch tag {
+	case wireNone:
+		return nil
+	case wireFalse, wireTrue:
+		return tag == wireTrue
+	case wireInt:
+		var value int64
+		read(&value)
+		return value
+	case wireFloat:
+		var value float64
+		read(&value)
+		return value
+	case wireStr:
+		var size uint32
+		read(&size)
+		value := make([]byte, size)
+		read(value)
+		return string(value)
+	case wireList:
+		var count uint32
+		read(&count)
+		list := make([]interface{}, count)
+		for i := range list {
+			list[i] = decodeWireValue(t, buf)
+		}
+		return list
+	case wireDict:
+		var count uint32
+		read(&count)
+		dict := make(map[string]interface{}, count)
+		for i := uint32(0); i < count; i++ {
+			key, ok := decodeWireValue(t, buf).(string)
+			require.True(t, ok, "Dict keys should be str")
+			dict[key] = decodeWireValue(t, buf)
+		}
+		return dict
+	}
+	t.Fatalf("unknown tag %d", tag)
+	return nil
+}
+
+// decodeJSONValue decodes JSON like json.loads does, with int64 for numbers
+// without fraction or exponent.
+func decodeJSONValue(t *testing.T, data []byte) interface{} {
+	t.Helper()
+	decoder := json.NewDecoder(bytes.NewReader(data))
+	decoder.UseNumber()
+	var value interface{}
+	require.NoError(t, decoder.Decode(&value))
+
+	var convert func(value interface{}) interface{}
+	convert = func(value interface{}) interface{} {
+		switch value := value.(type) {
+		case json.Number:
+			if !strings.ContainsAny(value.String(), ".eE") {
+				integer, err := value.Int64()
+				require.NoError(t, err)
+				return integer
+			}
+			float, err := value.Float64()
+			require.NoError(t, err)
+			return float
+		case []interface{}:
+			for i := range value {
+				value[i] = convert(value[i])
+			}
+		case map[string]interface{}:
+			for key := range value {
+				value[key] = convert(value[key])
+			}
+		}
+		return value
+	}
+	return convert(value)
+}
+
+func TestEncodeWireRequest(t *testing.T) {
+	requests := []*renderRequest{
+		{RenderJinjaTemplateRequest: &RenderJinjaTemplateRequest{}},
+		{
+			RenderJinjaTemplateRequest: &RenderJinjaTemplateRequest{
+				Conversations:       []ChatMessage{{Role: "user", Content: "héllo ☃"}, {Role: "assistant"}},
+				AddGenerationPrompt: true,
+				ChatTemplateKWArgs:  map[string]interface{}{"z": 1, "a": map[string]interface{}{}, "big": 1e15},
+			},
+			ChatTemplateHash: "abc",
+			Tools: []interface{}{map[string]interface{}{
+				"name": "get_weather", "strict": true, "parameters": nil,
+				"enum": []string{"a", "b"}, "limits": []interface{}{1.0, -2.5, 1e300, int32(7), int64(-8)},
+			}},
+			ToolsHash: "def",
+			Documents: []interface{}{"doc", 3},
+		},
+		{
+			RenderJinjaTemplateRequest: &RenderJinjaTemplateRequest{Conversations: []ChatMessage{{Role: "user"}}},
+			ToolsHash:                  "def",
+			DocumentsHash:              "ghi",
+		},
+		{
+			RenderJinjaTemplateRequest: &RenderJinjaTemplateRequest{Conversations: []ChatMessage{{Role: "user"}}},
+			Tokenize:                   &TokenizeOptions{Model: "org/model", Token: "hf_x", AddSpecialTokens: true},
+		},
+	}
+
+	for _, req := range requests {
+		data, err := encodeWireRequest(req)
+		require.NoError(t, err)
+		require.Equal(t, wireMagic, data[0])
+		buf := bytes.NewReader(data[1:])
+		decoded := decodeWireValue(t, buf)
+		assert.Zero(t, buf.Len(), "The whole request should be decoded")
+
+		jsonData, err := json.Marshal(req)
+		require.NoError(t, err)
+		assert.Equal(t, decodeJSONValue(t, jsonData), decoded, "Should decode like its JSON encoding")
+	}
+}
+
+func TestEncodeWireRequestUnsupported(t *testing.T) {
+	nested := interface{}("leaf")
+	for i := 0; i < wireMaxDepth; i++ {
+		nested = []interface{}{nested}
+	}
+
+	for name, value := range map[string]interface{}{
+		"NaN":          math.NaN(),
+		"invalid utf8": "\xff",
+		"struct":       struct{ A int }{1},
+		"deep":         nested,
+	} {
+		req := &renderRequest{RenderJinjaTemplateRequest: &RenderJinjaTemplateRequest{
+			ChatTemplateKWArgs: map[string]interface{}{"value": value},
+		}}
+		_, err := encodeWireRequest(req)
+		assert.ErrorIs(t, err, errWireUnsupported, name)
+	}
+}
+
+func TestDecodeWireRenderResult(t *testing.T) {
+	le := binary.LittleEndian
+	payload := le.AppendUint32(nil, 2) // chats
+	payload = le.AppendUint32(payload, 2)
+	payload = le.AppendUint32(payload, uint32(len("héllo")))
+	payload = le.AppendUint32(payload, 2)
+	payload = append(payload, "héllo"...)
+	for _, index := range []int64{0, 2, 3, 6} {
+		payload = le.AppendUint64(payload, uint64(index))
+	}
+	payload = le.AppendUint32(payload, 0)
+	payload = le.AppendUint32(payload, 0)
+
+	response, err := decodeWireRenderResult(payload)
+	require.NoError(t, err)
+	assert.Equal(t, []string{"héllo", ""}, response.RenderedChats)
+	assert.Equal(t, [][][]int{{{0, 2}, {3, 6}}, {}}, response.GenerationIndices)
+
+	for size := 0; size < len(payload); size++ {
+		_, err := decodeWireRenderResult(payload[:size])
+		assert.Error(t, err, "Truncated result of %d bytes should fail", size)
+	}
+	_, err = decodeWireRenderResult(append(payload, 0))
+	assert.Error(t, err, "Trailing bytes should fail")
+}
@@ -0,0 +1,479 @@
+/*
+Copyright 2025 The llm-d Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+package preprocessing
+
+import (
+	"context"
+	"errors"
+	"fmt"
+	"os"
+	"os/exec"
+	"strconv"
+	"sync"
+	"sync/atomic"
+	"syscall"
+	"time"
+
+	"k8s.io/klog/v2"
+)
+
+const (
+	defaultWorkersCount     = 4
+	defaultPythonExecutable = "python3"
+	defaultRingSize         = 8 * 1024 * 1024
+	// defaultWorkerStartTimeout leaves time for importing transformers on a
+	// loaded host.
+	defaultWorkerStartTimeout = 2 * time.Minute
+
+	// workerModule is the Python module run by each worker process. It must be
+	// importable by the worker's interpreter, like render_jinja_template_wrapper
+	// is for the embedded interpreter.
+	workerModule = "render_jinja_template_worker"
+	// sharedMemoryDir holds the (immediately unlinked) shared memory files.
+	sharedMemoryDir  = "/dev/shm"
+	doorbellReadSize = 4096
+	workerStopGrace  = 5 * time.Second
+	// workerRestartDelay spaces the attempts to restart an exited worker.
+	workerRestartDelay = time.Second
+)
+
+var errWorkerStopped = errors.New("render worker stopped")
+
+// WorkerPoolConfig holds the configuration for rendering chat templates in
+// Python worker processes, see ProcessRenderMode.
+type WorkerPoolConfig struct {
+	// WorkersCount is the number of Python worker processes.
+	WorkersCount int `json:"workersCount"`
+	// PythonExecutable is the Python interpreter running the workers.
+	PythonExecutable string `json:"pythonExecutable"`
+	// RingSize is the capacity in bytes of each of a worker's request and
+	// response rings. A single request or response is limited to half of it.
+	RingSize int `json:"ringSize"`
+	// StartTimeout is how long a starting worker may take to become ready
+	// before it is killed. Zero uses the default.
+	StartTimeout time.Duration `json:"startTimeout"`
+}
+
+// DefaultWorkerPoolConfig returns a default configuration for the render
+// worker pool.
+func DefaultWorkerPoolConfig() *WorkerPoolConfig {
+	return &WorkerPoolConfig{
+		WorkersCount:     defaultWorkersCount,
+		PythonExecutable: defaultPythonExecutable,
+		RingSize:         defaultRingSize,
+		StartTimeout:     defaultWorkerStartTimeout,
+	}
+}
+
+// workerResult is the outcome of a call to a render worker.
+type workerResult struct {
+	payload []byte
+	err     error
+}
+
+// renderWorker is a Python process running workerModule. Requests and
+// responses are exchanged as frames over two shared memory rings (see
+// shmRing), and each side rings a pipe doorbell after writing frames so that
+// the other side can block instead of polling.
+//
+// Any number of goroutines may call a worker concurrently: requests are
+// written under writeMu and tagged with an id, and a single goroutine reads
+// the responses and hands each one to its caller.
+type renderWorker struct {
+	cmd       *exec.Cmd
+	mem       []byte
+	requests  *shmRing
+	responses *shmRing
+	doorbell  *os.File // written after request frames
+	events    *os.File // read until the worker writes response frames
+
+	writeMu sync.Mutex
+	stopped bool // guarded by writeMu
+	space   chan struct{}
+	ready   chan struct{}
+	done    chan struct{}
+	err     error // set before done is closed
+
+	pendingMu sync.Mutex
+	pending   map[uint64]chan workerResult
+	nextID    uint64
+}
+
+// startRenderWorker starts a worker process and waits until it is ready to
+// render, killing it if it is not within the StartTimeout.
+func startRenderWorker(config *WorkerPoolConfig) (*renderWorker, error) {
+	regionSize := ringRegionSize(config.RingSize)
+	shmFile, mem, err := createSharedMemory(2 * regionSize)
+	if err != nil {
+		return nil, err
+	}
+	defer shmFile.Close()
+
+	requests, err := newShmRing(mem[:regionSize], config.RingSize)
+	if err != nil {
+		_ = syscall.Munmap(mem)
+		return nil, err
+	}
+	responses, err := newShmRing(mem[regionSize:], config.RingSize)
+	if err != nil {
+		_ = syscall.Munmap(mem)
+		return nil, err
+	}
+
+	requestsReader, doorbell, err := os.Pipe()
+	if err != nil {
+		_ = syscall.Munmap(mem)
+		return nil, fmt.Errorf("failed to create request pipe: %w", err)
+	}
+	events, responsesWriter, err := os.Pipe()
+	if err != nil {
+		_ = syscall.Munmap(mem)
+		requestsReader.Close()
+		doorbell.Close()
+		return nil, fmt.Errorf("failed to create response pipe: %w", err)
+	}
+
+	// The worker finds the shared memory and the pipes at fds 3, 4 and 5.
+	//nolint:gosec // the executable is operator configuration
+	cmd := exec.Command(config.PythonExecutable, "-m", workerModule, strconv.Itoa(config.RingSize))
+	cmd.ExtraFiles = []*os.File{shmFile, requestsReader, responsesWriter}
+	cmd.Stdout = os.Stdout
+	cmd.Stderr = os.Stderr
+
+	err = cmd.Start()
+	// The child holds its own copies of these.
+	requestsReader.Close()
+	responsesWriter.Close()
+	if err != nil {
+		_ = syscall.Munmap(mem)
+		doorbell.Close()
+		events.Close()
+		return nil, fmt.Errorf("failed to start render worker: %w", err)
+	}
+
+	w := &renderWorker{
+		cmd:       cmd,
+		mem:       mem,
+		requests:  requests,
+		responses: responses,
+		doorbell:  doorbell,
+		events:    events,
+		space:     make(chan struct{}, 1),
+		ready:     make(chan struct{}),
+		done:      make(chan struct{}),
+		pending:   make(map[uint64]chan workerResult),
+	}
+	go w.readResponses()
+
+	startTimeout := config.StartTimeout
+	if startTimeout <= 0 {
+		startTimeout = defaultWorkerStartTimeout
+	}
+	timer := time.NewTimer(startTimeout)
+	defer timer.Stop()
+
+	select {
+	case <-w.ready:
+		return w, nil
+	case <-w.done:
+		w.stop()
+		return nil, fmt.Errorf("render worker failed to start: %w", w.err)
+	case <-timer.C:
+		_ = cmd.Process.Kill()
+		w.stop()
+		return nil, fmt.Errorf("render worker not ready within %s", startTimeout)
+	}
+}
+
+// workerSlot holds one of the pool's render workers, and restarts it when
+// its process exits, for example when it is OOM-killed.
+type workerSlot struct {
+	config *WorkerPoolConfig
+	worker atomic.Pointer[renderWorker]
+	stopCh chan struct{} // closed by close
+	doneCh chan struct{} // closed when supervise returns
+}
+
+func newWorkerSlot(config *WorkerPoolConfig, worker *renderWorker) *workerSlot {
+	slot := &workerSlot{
+		config: config,
+		stopCh: make(chan struct{}),
+		doneCh: make(chan struct{}),
+	}
+	slot.worker.Store(worker)
+	go slot.supervise()
+	return slot
+}
+
+// get returns the current worker, which may have exited since.
+func (s *workerSlot) get() *renderWorker {
+	return s.worker.Load()
+}
+
+// alive returns whether the current worker is running.
+func (s *workerSlot) alive() bool {
+	select {
+	case <-s.get().done:
+		return false
+	default:
+		return true
+	}
+}
+
+// supervise replaces the worker with a new one every time it exits, until
+// the slot is closed. Calls in flight on an exiting worker fail.
+func (s *workerSlot) supervise() {
+	defer close(s.doneCh)
+	logger := klog.Background().WithName("renderWorker")
+
+	for {
+		exited := s.get()
+		select {
+		case <-exited.done:
+		case <-s.stopCh:
+			return
+		}
+		logger.Error(exited.err, "Render worker exited, restarting it", "pid", exited.cmd.Process.Pid)
+
+		for {
+			worker, err := startRenderWorker(s.config)
+			if err == nil {
+				s.worker.Store(worker)
+				break
+			}
+			logger.Error(err, "Failed to restart render worker")
+
+			select {
+			case <-time.After(workerRestartDelay):
+			case <-s.stopCh:
+				return // close stops the exited worker
+			}
+		}
+		exited.stop()
+	}
+}
+
+// close stops supervising the worker, and stops it.
+func (s *workerSlot) close() {
+	close(s.stopCh)
+	<-s.doneCh
+	s.get().stop()
+}
+
+// createSharedMemory maps a zeroed shared memory file of the given size. The
+// file is unlinked right away, so it only lives as long as the mapping and
+// the open descriptors.
+func createSharedMemory(size int) (*os.File, []byte, error) {
+	dir := sharedMemoryDir
+	if _, err := os.Stat(dir); err != nil {
+		dir = os.TempDir()
+	}
+
+	file, err := os.CreateTemp(dir, "kvcache-render-*")
+	if err != nil {
+		return nil, nil, fmt.Errorf("failed to create shared memory file: %w", err)
+	}
+	_ = os.Remove(file.Name())
+
+	if err := file.Truncate(int64(size)); err != nil {
+		file.Close()
+		return nil, nil, fmt.Errorf("failed to size shared memory file: %w", err)
+	}
+
+	mem, err := syscall.Mmap(int(file.Fd()), 0, size, syscall.PROT_READ|syscall.PROT_WRITE, syscall.MAP_SHARED)
+	if err != nil {
+		file.Close()
+		return nil, nil, fmt.Errorf("failed to map shared memory: %w", err)
+	}
+
+	return file, mem, nil
+}
+
+// call sends a frame of the given kind to the worker and waits for its
+// response payload.
+func (w *renderWorker) call(ctx context.Context, kind uint32, payload []byte) ([]byte, error) {
+	id, resultCh, err := w.register()
+	if err != nil {
+		return nil, err
+	}
+
+	if err := w.send(ctx, kind, id, payload); err != nil {
+		w.unregister(id)
+		return nil, err
+	}
+
+	select {
+	case result := <-resultCh:
+		return result.payload, result.err
+	case <-ctx.Done():
+		// The response, if any, is dropped by dispatch.
+		w.unregister(id)
+		return nil, ctx.Err()
+	}
+}
+
+func (w *renderWorker) register() (uint64, chan workerResult, error) {
+	w.pendingMu.Lock()
+	defer w.pendingMu.Unlock()
+
+	if w.pending == nil {
+		return 0, nil, w.err
+	}
+
+	w.nextID++
+	resultCh := make(chan workerResult, 1)
+	w.pending[w.nextID] = resultCh
+	return w.nextID, resultCh, nil
+}
+
+func (w *renderWorker) unregister(id uint64) {
+	w.pendingMu.Lock()
+	defer w.pendingMu.Unlock()
+
+	delete(w.pending, id)
+}
+
+// send writes a request frame, waiting for the worker to free ring space if
+// needed.
+func (w *renderWorker) send(ctx context.Context, kind uint32, id uint64, payload []byte) error {
+	for {
+		written, err := w.tryWrite(kind, id, payload)
+		if err != nil || written {
+			return err
+		}
+
+		select {
+		case <-w.space:
+		case <-w.done:
+			return w.err
+		case <-ctx.Done():
+			return ctx.Err()
+		}
+	}
+}
+
+func (w *renderWorker) tryWrite(kind uint32, id uint64, payload []byte) (bool, error) {
+	w.writeMu.Lock()
+	defer w.writeMu.Unlock()
+
+	if w.stopped {
+		return false, errWorkerStopped
+	}
+
+	written, err := w.requests.write(kind, id, payload)
+	if err != nil || !written {
+		return false, err
+	}
+
+	if _, err := w.doorbell.Write([]byte{1}); err != nil {
+		return false, fmt.Errorf("failed to notify render worker: %w", err)
+	}
+	return true, nil
+}
+
+// readResponses drains the response ring every time the worker rings the
+// doorbell, until the worker exits or writes a corrupt frame.
+func (w *renderWorker) readResponses() {
+	buf := make([]byte, doorbellReadSize)
+	for {
+		_, err := w.events.Read(buf)
+
+		for {
+			frame, ok, readErr := w.responses.read()
+			if readErr != nil {
+				// The worker cannot be trusted with the ring anymore: kill it,
+				// so that stop can reap it.
+				_ = w.cmd.Process.Kill()
+				w.fail(fmt.Errorf("render worker sent a bad response: %w", readErr))
+				return
+			}
+			if !ok {
+				break
+			}
+			w.dispatch(&frame)
+		}
+
+		// Every response frees the ring space of its request.
+		select {
+		case w.space <- struct{}{}:
+		default:
+		}
+
+		if err != nil {
+			w.fail(fmt.Errorf("render worker exited: %w", err))
+			return
+		}
+	}
+}
+
+func (w *renderWorker) dispatch(frame *shmFrame) {
+	if frame.kind == frameReady {
+		close(w.ready)
+		return
+	}
+
+	w.pendingMu.Lock()
+	resultCh := w.pending[frame.id]
+	delete(w.pending, frame.id)
+	w.pendingMu.Unlock()
+
+	if resultCh == nil {
+		return // the caller gave up
+	}
+
+	switch frame.kind {
+	case frameError:
+		resultCh <- workerResult{err: fmt.Errorf("render worker error: %s", frame.payload)}
+	case frameNotCached:
+		resultCh <- workerResult{err: errTemplateNotCached}
+	default:
+		resultCh <- workerResult{payload: frame.payload}
+	}
+}
+
+// fail fails all pending and future calls with err.
+func (w *renderWorker) fail(err error) {
+	w.pendingMu.Lock()
+	defer w.pendingMu.Unlock()
+
+	w.err = err
+	for _, resultCh := range w.pending {
+		resultCh <- workerResult{err: err}
+	}
+	w.pending = nil
+	close(w.done)
+}
+
+// stop asks the worker to exit by closing its doorbell, kills it if it does
+// not do so in time, and releases the shared memory.
+func (w *renderWorker) stop() {
+	w.writeMu.Lock()
+	w.stopped = true
+	w.doorbell.Close()
+	w.writeMu.Unlock()
+
+	select {
+	case <-w.done:
+	case <-time.After(workerStopGrace):
+		_ = w.cmd.Process.Kill()
+		<-w.done
+	}
+	_ = w.cmd.Wait()
+
+	w.events.Close()
+	_ = syscall.Munmap(w.mem)
+}
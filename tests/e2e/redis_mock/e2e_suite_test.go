@@ -65,7 +65,8 @@ func (s *KVCacheSuite) SetupTest() {
 	s.tokenizer, err = tokenization.NewCachedHFTokenizer(s.config.TokenizersPoolConfig.HFTokenizerConfig)
 	s.Require().NoError(err)
 
-	s.tokensProcessor = kvblock.NewChunkedTokenDatabase(s.config.TokenProcessorConfig)
+	s.tokensProcessor, err = kvblock.NewChunkedTokenDatabase(s.config.TokenProcessorConfig)
+	s.Require().NoError(err)
 
 	s.Pod1IP = "10.0.0.1"
 